@@ -28,6 +28,21 @@ export interface NativeClient {
      */
     callAsyncRaw<T = unknown>(...args: Array<string | ArrayBuffer>): T;
 
+    /**
+     * Run multiple commands on Redis one after the other. Each command is given as an array
+     * of the command name and its arguments. Returns an array with the result of each command,
+     * a failed command does not stop the following commands and its error is returned as a
+     * String object with `__reply_type` set to `error`.
+     * @param commands - The commands to execute.
+     */
+    callBatch<T = unknown>(commands: Array<Array<string | ArrayBuffer>>): Array<T>;
+
+    /**
+     * Same as callBatch but does not perform UTF8 decoding on the results.
+     * @param commands - The commands to execute.
+     */
+    callBatchRaw<T = unknown>(commands: Array<Array<string | ArrayBuffer>>): Array<T>;
+
     /**
      * Return true if it is allow to return promise from the function callback.
      * In case it is allowed and a promise is return, Redis will wait for the promise
@@ -73,6 +88,22 @@ export interface NativeAsyncClient {
      */
     runOnKey(key: string, remoteFunction: string, ...args: Array<string | object>): Promise<any>
 
+    /**
+     * Runs a remote function once for each of the given keys, on the shard
+     * responsible for the key. The key is given to the remote function as its
+     * first argument. The keys are grouped by the shard that holds them, and
+     * each of those shards gets a single remote task carrying its own keys.
+     * Returns a promise which will be fulfilled with the results in the order
+     * of the keys, or rejected with the first error.
+     * 
+     * Notice that remote function can only perform read operations, not writes are allowed.
+     * 
+     * @param keys - The keys on which to run the remote function on.
+     * @param remoteFunction - The remote function name to run
+     * @param args - Extra arguments to give to the remote function (must be json serializabale).
+     */
+    runOnKeys(keys: Array<string | ArrayBuffer>, remoteFunction: string, ...args: Array<string | object>): Promise<Array<any>>
+
     /**
      * Runs a remote function on all the shards. Returns a promise
      * which will be fulfilled when the invocation finishes on all the shards.
@@ -88,6 +119,20 @@ export interface NativeAsyncClient {
      * @param args - Extra arguments to give to the remote function (must be json serializabale).
      */
     runOnShards(remoteFunction: string, ...args: Array<string | object>): Promise<any>
+
+    /**
+     * Runs a remote function on all the shards and reduces each result with
+     * the given reducer as soon as its shard replies. Returns a promise which will be fulfilled
+     * with an array of 2 elements, the first is the reduced value and the second
+     * is an array of all the errors happened durring the invocation.
+     * 
+     * Notice that remote function can only perform read operations, not writes are allowed.
+     * 
+     * @param remoteFunction - The remote function name to run
+     * @param options - The reducer and its options.
+     * @param args - Extra arguments to give to the remote function (must be json serializabale).
+     */
+    runOnShardsReduce(remoteFunction: string, options: ShardsReduceOptions, ...args: Array<string | object>): Promise<any>
 }
 
 /**
@@ -119,20 +164,40 @@ export interface FunctionOptions {
  * {
  *      window: 1,
  *      description: "short description",
- *      isStreamTrimmed: true
+ *      isStreamTrimmed: true,
+ *      batchSize: 100,
+ *      maxBatchDelay: 10,
+ *      maxWindow: 10,
+ *      targetLatency: 1000,
+ *      lazyRecords: false
  * }
  * ```
  * 
- * `window`: How many elements to process in parallel.
+ * `window`: How many elements (or batches, if `batchSize` is set) to process in parallel.
  * 
  * `description`: short description of what the function is doing.
  * 
  * `isStreamTrimmed`: whether or not to trim the stream.
+ * 
+ * `batchSize`: if set, the trigger callback gets an array of up to `batchSize` records which are acknowledged together.
+ * 
+ * `maxBatchDelay`: max time in ms to wait for a batch to fill up before delivering a partial batch (requires `batchSize`).
+ * 
+ * `maxWindow`: if set, the window is adapted between `window` and `maxWindow` according to the records processing time and lag.
+ * 
+ * `targetLatency`: max processing time in ms of a record (or batch) before the adaptive window is decreased, 1000 by default (requires `maxWindow`).
+ * 
+ * `lazyRecords`: if set, the `record` and `record_raw` fields are not provided and the record data can only be read using `get` and `getRaw`.
  */
 export interface StreamTriggerOptions {
     description: string;
     window: number;
     isStreamTrimmed: boolean;
+    batchSize: number;
+    maxBatchDelay: number;
+    maxWindow: number;
+    targetLatency: number;
+    lazyRecords: boolean;
 }
 
 /**
@@ -155,6 +220,51 @@ export interface StreamTriggerOptions {
 export interface KeySpaceTriggerOptions {
     description: string;
     onTriggerFired: (client: NativeClient, data: NotificationsConsumerData) => void;
+    /** Only fire the trigger on those events, for example `["hset", "hdel"]`. */
+    events?: string[];
+    /** Only fire the trigger on keys that end with this suffix. */
+    keySuffix?: string;
+    /** Only fire the trigger on keys of at least this length, in bytes. */
+    minKeyLength?: number;
+    /** Only fire the trigger on keys of at most this length, in bytes. */
+    maxKeyLength?: number;
+    /**
+     * Coalesce the notifications of each key for this amount of milliseconds,
+     * the trigger is fired once per key with its last event.
+     */
+    debounceWindow?: number;
+    /** Fire the trigger before the debounce window expires once a key got this amount of notifications. */
+    debounceMaxEvents?: number;
+}
+
+/**
+ * The reducer of `NativeAsyncClient::runOnShardsReduce`.
+ * 
+ * `reducer`: a synchronous function which gets the accumulated value and the result
+ * of a shard, and returns the new accumulated value.
+ * 
+ * `initialValue`: the initial accumulated value, if not given the first result is used.
+ * 
+ * `deadline`: the time (in milliseconds) to wait for the shards, the promise is then resolved
+ * with the results reduced so far and the shards that did not reply are reported as errors.
+ */
+export interface ShardsReduceOptions {
+    reducer: (accumulator: any, result: any) => any;
+    initialValue?: any;
+    deadline?: number;
+}
+
+/**
+ * Optional arguments that can be given when registering a cluster function.
+ * 
+ * `serialization`: how the cluster function arguments and results are serialized,
+ * `json` (the default) or `binary`. The `binary` serialization is faster than JSON
+ * and keeps `ArrayBuffer`, typed arrays, `DataView`, `Set` and `Map` values at any
+ * nesting level, as well as `BigInt` values in the 64 bit integer range. `WeakMap`
+ * and `WeakSet` values can not be serialized.
+ */
+export interface ClusterFunctionOptions {
+    serialization: "json" | "binary";
 }
 
 /**
@@ -169,13 +279,19 @@ export interface KeySpaceTriggerOptions {
  * `record`: Array of tuples, each tuple is a key-value entery of the record data decoded to utf8 or null if failed to decode.
  * 
  * `record_raw`: Array of tuples, each tuple is a key-value entery of the record data as ArrayBuffer
+ * 
+ * `get`: Return the value of the given field decoded to utf8 (or null if failed to decode), null if the field does not exist.
+ * 
+ * `getRaw`: Return the value of the given field as ArrayBuffer, null if the field does not exist.
  */
 export interface StreamConsumerData {
     id: [ms: `${number}`, seq: `${number}`];
     stream_name: string;
     stream_name_raw: ArrayBuffer;
-    record: Array<[string, string]>;
-    record_raw: Array<[ArrayBuffer, ArrayBuffer]>;
+    record?: Array<[string, string]>;
+    record_raw?: Array<[ArrayBuffer, ArrayBuffer]>;
+    get(field: string | ArrayBuffer): string | null;
+    getRaw(field: string | ArrayBuffer): ArrayBuffer | null;
 }
 
 /**
@@ -228,7 +344,7 @@ export const redis: {
      * @param fn - the stream trigger callback.
      * @param options - extra options to control stream processing.
      */
-    registerStreamTrigger(name: string, prefix: string, fn: (client: NativeClient, data: StreamConsumerData) => any, options: StreamTriggerOptions): void;
+    registerStreamTrigger(name: string, prefix: string, fn: (client: NativeClient, data: StreamConsumerData | Array<StreamConsumerData>) => any, options: StreamTriggerOptions): void;
 
     /**
      * Can only be called on library load time.
@@ -249,8 +365,9 @@ export const redis: {
      * 
      * @param name - the name of the cluster function.
      * @param fn - the cluster function callback.
+     * @param options - extra options to control the cluster function.
      */
-    registerClusterFunction(name: string, fn: (client: NativeClient, data: NotificationsConsumerData) => any): any;
+    registerClusterFunction(name: string, fn: (client: NativeClient, data: NotificationsConsumerData) => any, options?: ClusterFunctionOptions): any;
 
     /**
      * The V8 version.
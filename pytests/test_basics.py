@@ -3,6 +3,7 @@ from common import toDictionary
 from common import runUntil
 from redis import Redis
 import time
+import hashlib
 
 MODULE_NAME = "redisgears_2"
 
@@ -533,6 +534,20 @@ redis.registerFunction("test1", function(){
     env.expect('debug', 'reload').equal("OK")
     env.expectTfcall('lib', 'test1').equal(['foo', 'bar'])
 
+@gearsTest()
+def testManyLibrariesPersistAfterLoading(env):
+    code = """#!js api_version=1.0 name=lib%d
+redis.registerFunction("test1", function(){
+    return [%d, redis.config.foo];
+});
+    """
+    for i in range(20):
+        env.expect('TFUNCTION', 'LOAD', 'CONFIG', '{"foo":"bar%d"}' % i, code % (i, i)).equal("OK")
+    env.expect('debug', 'reload').equal("OK")
+    env.assertEqual(len(env.cmd('TFUNCTION', 'LIST')), 20)
+    for i in range(20):
+        env.expectTfcall('lib%d' % i, 'test1').equal([i, 'bar%d' % i])
+
 @gearsTest()
 def testLibraryLoadingTimesout(env):
     code = """#!js api_version=1.0 name=lib
@@ -879,6 +894,36 @@ redis.registerFunction("test",
     env.expect('hset', 'k', 'f', 'v').equal(True)
     env.expectTfcall('lib', 'test', ['k']).equal(['f', 'v'])
 
+@gearsTest()
+def testCallBatch(env):
+    """#!js api_version=1.0 name=lib
+redis.registerFunction("test", (c) => {
+    var res = c.callBatch([
+        ['set', 'x', '1'],
+        ['incr', 'x'],
+        ['hget', 'x', 'foo'],
+        ['get', 'x'],
+    ]);
+    return res.map((v) => (v.__reply_type === 'error') ? 'error: ' + v : v);
+});
+
+redis.registerFunction("test_raw", (c) => {
+    return c.callBatchRaw([['get', 'x']])[0];
+});
+
+redis.registerFunction("test_invalid", (c, command) => {
+    return c.callBatch([JSON.parse(command)]);
+});
+    """
+    res = env.tfcall('lib', 'test')
+    env.assertEqual(res[0], 'OK')
+    env.assertEqual(res[1], 2)
+    env.assertContains('error: WRONGTYPE', res[2])
+    env.assertEqual(res[3], '2')
+    env.expectTfcall('lib', 'test_raw').equal('2')
+    env.expectTfcall('lib', 'test_invalid', args=['[]']).error().contains('A command can not be empty')
+    env.expectTfcall('lib', 'test_invalid', args=['"get"']).error().contains('Each command must be given as an array')
+
 
 @gearsTest(decodeResponses=False)
 def testBinaryFieldsNamesOnHashRaiseError(env):
@@ -1057,6 +1102,48 @@ redis.registerStreamTrigger("test", "",
     res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vv'), 6)
     env.assertContains('Some function', res[0]['stream_triggers'][0]['description'])
 
+@gearsTest()
+def testFunctionStats(env):
+    """#!js api_version=1.0 name=lib
+redis.registerFunction("test", () => {
+    return "OK";
+});
+redis.registerFunction("fail", () => {
+    throw "Some Error";
+});
+redis.registerAsyncFunction("test_async", (c) => {
+    return c.executeAsync(async () => {
+        return "OK";
+    });
+});
+redis.registerKeySpaceTrigger("trigger", "", () => {});
+    """
+    for _ in range(10):
+        env.expectTfcall('lib', 'test').equal('OK')
+    env.expectTfcall('lib', 'fail').error().contains('Some Error')
+    env.expectTfcallAsync('lib', 'test_async').equal('OK')
+    env.cmd('set', 'x', '1')
+
+    res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'v'), 6)
+    functions = {f['name']: f for f in res[0]['functions']}
+    env.assertEqual(functions['test']['num_calls'], 10)
+    env.assertEqual(functions['test']['num_errors'], 0)
+    env.assertEqual(functions['test']['latency']['count'], 10)
+    env.assertLessEqual(functions['test']['latency']['p50_us'], functions['test']['latency']['p99_us'])
+    env.assertLessEqual(functions['test']['latency']['p999_us'], functions['test']['latency']['max_us'])
+    env.assertEqual(functions['test']['async_wait_latency'], None)
+    env.assertEqual(functions['fail']['num_calls'], 1)
+    env.assertEqual(functions['fail']['num_errors'], 1)
+    env.assertEqual(functions['test_async']['num_calls'], 1)
+    env.assertEqual(functions['test_async']['async_wait_latency']['count'], 1)
+    env.assertEqual(res[0]['keyspace_triggers'][0]['latency']['count'], 1)
+
+    info = env.cmd('info', 'redisgears_2_perlibraryinformation')
+    lib_info = info['redisgears_2_' + hashlib.sha256(b'lib').hexdigest()]
+    env.assertEqual(lib_info['functions_calls'], 12)
+    env.assertEqual(lib_info['functions_errors'], 1)
+    env.assertEqual(lib_info['triggers_calls'], 1)
+
 @gearsTest()
 def testNoNotificationsOnSlave(env):
     """#!js api_version=1.0 name=lib
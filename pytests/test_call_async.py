@@ -91,3 +91,58 @@ redis.registerAsyncFunction('test', (c) => {
     future.expectError('instance state changed')
     # make sure the weak refernce are cleaned.
     runUntil(env, [], lambda: env.cmd('TFUNCTION', 'DEBUG', 'dump_pending_async_calls'))
+
+@gearsTest()
+def testAsyncFunctionsOnMultipleIsolates(env):
+    """#!js api_version=1.0 name=lib isolates=3
+var isolate_id = Math.random().toString();
+var counter = 0;
+redis.registerAsyncFunction('async_isolate_id', async () => {
+    counter += 1;
+    return isolate_id;
+});
+redis.registerFunction('sync_isolate_id', () => {
+    return isolate_id;
+});
+redis.registerAsyncFunction('counter', async () => {
+    return counter;
+});
+    """
+    async_ids = set([env.tfcallAsync('lib', 'async_isolate_id') for _ in range(6)])
+    env.assertEqual(len(async_ids), 3)
+    sync_id = env.tfcall('lib', 'sync_isolate_id')
+    env.assertContains(sync_id, async_ids)
+    env.expectTfcall('lib', 'sync_isolate_id').equal(sync_id)
+    # each isolate has its own global state
+    env.assertEqual(set([env.tfcallAsync('lib', 'counter') for _ in range(3)]), set([2]))
+
+@gearsTest()
+def testExecutorInfo(env):
+    """#!js api_version=1.0 name=lib
+redis.registerAsyncFunction('test', async () => {
+    return "OK";
+});
+    """
+    for _ in range(10):
+        env.expectTfcallAsync('lib', 'test').equal('OK')
+    info = env.cmd('info', 'redisgears_2_executor')
+    env.assertEqual(info['redisgears_2_high_priority_executed_jobs'], 10)
+    env.assertEqual(info['redisgears_2_high_priority_pending_jobs'], 0)
+    env.assertEqual(info['redisgears_2_low_priority_executed_jobs'], 0)
+    env.assertGreaterEqual(info['redisgears_2_threads'], 1)
+
+@gearsTest()
+def testBackgroundLockInfo(env):
+    """#!js api_version=1.0 name=lib isolates=4
+redis.registerAsyncFunction('test', async (c) => {
+    return c.block((c) => {
+        return c.call('incr', 'x');
+    });
+});
+    """
+    futures = [env.noBlockingTfcallAsync('lib', 'test') for _ in range(20)]
+    runUntil(env, '20', lambda: env.cmd('get', 'x'))
+    info = env.cmd('info', 'redisgears_2_backgroundlock')
+    env.assertEqual(info['redisgears_2_locks'], 20)
+    env.assertLessEqual(info['redisgears_2_batches'], 20)
+    env.assertGreaterEqual(info['redisgears_2_max_batch_size'], 1)
@@ -49,6 +49,104 @@ redis.registerAsyncFunction("test",
         res = env.tfcallAsync('foo', 'test', ['x'], c=conn)
         env.assertEqual(res, '1')
 
+@gearsTest(cluster=True)
+def testClusterFunctionBinarySerialization(env, cluster_conn):
+    """#!js api_version=1.0 name=foo
+const remote_echo = "remote_echo";
+
+redis.registerClusterFunction(remote_echo, async(client, key, data) => {
+    return {key: key, data: data};
+}, {serialization: 'binary'});
+
+redis.registerAsyncFunction("test", async (async_client, key) => {
+    let res = await async_client.runOnKey(key, remote_echo, key, {
+        int: 1,
+        bigint: 10n,
+        double: 1.5,
+        str: 'foo',
+        nested: [null, true, [1, 2]],
+        buff: new Uint8Array([1, 2, 3]).buffer,
+        set: new Set([1, 'a']),
+    });
+    return [
+        res.key,
+        res.data.int,
+        res.data.double.toString(),
+        res.data.str,
+        JSON.stringify(res.data.nested),
+        new Uint8Array(res.data.buff).length,
+        res.data.set.size,
+        res.data.set.has('a') ? 'yes' : 'no',
+        typeof res.data.int,
+        typeof res.data.bigint,
+        res.data.bigint.toString(),
+        typeof res.data.double,
+    ];
+});
+    """
+    for conn in shardsConnections(env):
+        res = env.tfcallAsync('foo', 'test', ['x'], c=conn)
+        env.assertEqual(res, ['x', 1, '1.5', 'foo', '[null,true,[1,2]]', 3, 2, 'yes', 'number', 'bigint', '10', 'number'])
+
+@gearsTest(cluster=True)
+def testClusterFunctionBinarySerializationMapsAndTypedArrays(env, cluster_conn):
+    """#!js api_version=1.0 name=foo
+const remote_echo = "remote_echo";
+
+redis.registerClusterFunction(remote_echo, async(client, key, data) => {
+    return {key: key, data: data};
+}, {serialization: 'binary'});
+
+redis.registerAsyncFunction("test", async (async_client, key) => {
+    let bytes = new Uint8Array([0, 1, 2, 3, 4, 5, 6, 7]);
+    let res = await async_client.runOnKey(key, remote_echo, key, {
+        map: new Map([['a', 1], [2, 'b'], [3n, [1, 2]]]),
+        nested: new Map([['m', new Map([['x', new Set([1, 2])]])]]),
+        empty: new Map(),
+        set: new Set([new Map([['a', 1]]), {b: 2}]),
+        u8: bytes.subarray(2, 5),
+        f64: new Float64Array([1.5, -2.5]),
+        i64: new BigInt64Array([-1n, 2n ** 62n]),
+        view: new DataView(bytes.buffer, 4, 2),
+        arr: [new Int16Array([-1, 300])],
+    });
+    let d = res.data;
+    return [
+        res.key,
+        d.map instanceof Map ? 'map' : 'not map',
+        d.map.size,
+        d.map.get('a'),
+        d.map.get(2),
+        JSON.stringify(d.map.get(3n)),
+        d.nested.get('m').get('x').has(2) ? 'yes' : 'no',
+        d.empty instanceof Map ? d.empty.size : -1,
+        JSON.stringify([...d.set].map((v) => v instanceof Map ? v.get('a') : v.b)),
+        d.u8.constructor.name,
+        JSON.stringify(Array.from(d.u8)),
+        d.u8.buffer.byteLength,
+        d.f64.constructor.name,
+        JSON.stringify(Array.from(d.f64)),
+        d.i64.constructor.name,
+        Array.from(d.i64).map((v) => v.toString()).join(','),
+        d.view.constructor.name,
+        d.view.byteLength,
+        d.view.getUint8(0),
+        d.arr[0].constructor.name,
+        JSON.stringify(Array.from(d.arr[0])),
+    ];
+});
+    """
+    for conn in shardsConnections(env):
+        res = env.tfcallAsync('foo', 'test', ['x'], c=conn)
+        env.assertEqual(res, [
+            'x', 'map', 3, 1, 'b', '[1,2]', 'yes', 0, '[1,2]',
+            'Uint8Array', '[2,3,4]', 3,
+            'Float64Array', '[1.5,-2.5]',
+            'BigInt64Array', '-1,4611686018427387904',
+            'DataView', 2, 4,
+            'Int16Array', '[-1,300]',
+        ])
+
 @gearsTest(cluster=True)
 def testRemoteFunctionRaiseError(env, cluster_conn):
     """#!js api_version=1.0 name=foo
@@ -123,6 +221,94 @@ redis.registerAsyncFunction("test", async (async_client, key) => {
     cluster_conn.execute_command('set', 'x', '1')
     env.expectTfcallAsync('foo', 'test', ['x']).error().contains('Remote task timeout')
 
+@gearsTest(cluster=True)
+def testRunOnKeys(env, cluster_conn):
+    """#!js api_version=1.0 name=foo
+const remote_get = "remote_get";
+
+redis.registerClusterFunction(remote_get, async(client, key, suffix) => {
+    let res = client.block((client) => {
+        return client.call("get", key);
+    });
+    return res + suffix;
+});
+
+redis.registerAsyncFunction("test", async (async_client, ...keys) => {
+    return await async_client.runOnKeys(keys, remote_get, '_suffix');
+});
+    """
+    keys = ['key%d' % i for i in range(100)] + ['{a}1', '{a}2']
+    for key in keys:
+        cluster_conn.execute_command('set', key, key)
+    for conn in shardsConnections(env):
+        res = env.tfcallAsync('foo', 'test', args=keys, c=conn)
+        env.assertEqual(res, [key + '_suffix' for key in keys])
+
+    for conn in shardsConnections(env):
+        res = env.tfcallAsync('foo', 'test', c=conn)
+        env.assertEqual(res, [])
+
+@gearsTest(cluster=True)
+def testRunOnKeysRemoteTasks(env, cluster_conn):
+    """#!js api_version=1.0 name=foo
+const remote_get = "remote_get";
+
+redis.registerClusterFunction(remote_get, async(client, key) => {
+    return key;
+});
+
+redis.registerAsyncFunction("test", async (async_client, ...keys) => {
+    return await async_client.runOnKeys(keys, remote_get);
+});
+    """
+    def remote_tasks_info():
+        res = []
+        for conn in shardsConnections(env):
+            info = conn.execute_command('info', 'redisgears_2_remotetasks')
+            res.append((info.get('redisgears_2_executed_tasks', 0), info.get('redisgears_2_executed_keys', 0)))
+        return res
+
+    keys = ['key%d' % i for i in range(500)]
+    res = env.tfcallAsync('foo', 'test', args=keys, c=env.getConnection(shardId=1))
+    env.assertEqual(res, keys)
+
+    # the first call is sent to all the shards, which run the function on their own keys only.
+    info = remote_tasks_info()
+    env.assertEqual([tasks for tasks, _ in info], [1] * env.shardsCount)
+    env.assertEqual(sum([num_keys for _, num_keys in info]), len(keys))
+
+    # the next calls are only sent to the shards that hold the keys.
+    res = env.tfcallAsync('foo', 'test', args=keys, c=env.getConnection(shardId=1))
+    env.assertEqual(res, keys)
+    info = remote_tasks_info()
+    env.assertEqual([tasks for tasks, _ in info], [2] * env.shardsCount)
+    env.assertEqual(sum([num_keys for _, num_keys in info]), 2 * len(keys))
+
+    same_slot_keys = ['{key}%d' % i for i in range(100)]
+    res = env.tfcallAsync('foo', 'test', args=same_slot_keys, c=env.getConnection(shardId=1))
+    env.assertEqual(res, same_slot_keys)
+    info = remote_tasks_info()
+    env.assertEqual(sorted([tasks for tasks, _ in info]), [2] * (env.shardsCount - 1) + [3])
+    env.assertEqual(sum([num_keys for _, num_keys in info]), 2 * len(keys) + len(same_slot_keys))
+
+@gearsTest(cluster=True)
+def testRunOnKeysRaiseError(env, cluster_conn):
+    """#!js api_version=1.0 name=foo
+const remote_get = "remote_get";
+
+redis.registerClusterFunction(remote_get, async(client, key) => {
+    if (key == 'y') {
+        throw 'Remote function failed on ' + key;
+    }
+    return key;
+});
+
+redis.registerAsyncFunction("test", async (async_client, ...keys) => {
+    return await async_client.runOnKeys(keys, remote_get);
+});
+    """
+    env.expectTfcallAsync('foo', 'test', args=['x', 'y', 'z']).error().contains('Remote function failed on y')
+
 @gearsTest(cluster=True)
 def testRunOnAllShards(env, cluster_conn):
     """#!js api_version=1.0 name=foo
@@ -152,6 +338,75 @@ redis.registerAsyncFunction("test", async(async_client) => {
         res = env.tfcallAsync('foo', 'test', c=conn)
         env.assertEqual(res, 1000)
 
+@gearsTest(cluster=True)
+def testRunOnShardsReduce(env, cluster_conn):
+    """#!js api_version=1.0 name=foo
+const dbside_remote_func = "dbsize";
+
+redis.registerClusterFunction(dbside_remote_func, async(client) => {
+    return await client.block((client) => {
+        return client.call("dbsize");
+    });
+});
+
+redis.registerAsyncFunction("test", async(async_client) => {
+    let res = await async_client.runOnShardsReduce(dbside_remote_func, {
+        reducer: (sum, dbsize) => sum + dbsize,
+        initialValue: 0,
+    });
+    if (res[1].length > 0) {
+        throw res[1][0];
+    }
+    return res[0];
+});
+
+redis.registerAsyncFunction("test_reducer_error", async(async_client) => {
+    return await async_client.runOnShardsReduce(dbside_remote_func, {
+        reducer: (sum, dbsize) => {throw 'reducer failed';},
+        initialValue: 0,
+    });
+});
+    """
+    for i in range(1000):
+        cluster_conn.execute_command('set', 'key%d' % i, '1')
+    for conn in shardsConnections(env):
+        res = env.tfcallAsync('foo', 'test', c=conn)
+        env.assertEqual(res, 1000)
+    env.expectTfcallAsync('foo', 'test_reducer_error').error().contains('reducer failed')
+
+@gearsTest(cluster=True)
+def testRunOnShardsReduceDeadline(env, cluster_conn):
+    """#!js api_version=1.0 name=foo
+const remote_function = "remote_function";
+
+redis.registerClusterFunction(remote_function, async(client) => {
+    let val = client.block((client) => {
+        try {
+            return client.call("get", "z");
+        } catch(e) {
+            return 0;
+        }
+    });
+    if (val != "1") {
+        while(true); // block forever so we will only get a partial result
+    }
+    return val;
+});
+
+redis.registerAsyncFunction("test", async (async_client) => {
+    let res = await async_client.runOnShardsReduce(remote_function, {
+        reducer: (acc, val) => acc + val,
+        initialValue: '',
+        deadline: 1000,
+    });
+    return [res[0], res[1].length > 0 ? res[1][0] : 'no errors'];
+});
+    """
+    cluster_conn.execute_command('set', 'z', '1')
+    res = env.tfcallAsync('foo', 'test')
+    env.assertEqual(res[0], '1')
+    env.assertContains('Timeout', res[1])
+
 @gearsTest(cluster=True, gearsConfig={'remote-task-default-timeout': '1'})
 def testRunOnAllShardsTimeout(env, cluster_conn):
     """#!js api_version=1.0 name=foo
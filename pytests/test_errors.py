@@ -222,6 +222,60 @@ redis.registerAsyncFunction("test", async (async_client, key) => {
     """
     env.expectTfcallAsync('foo', 'test', ['1']).error().contains('Failed deserializing remote function result')
 
+@gearsTest()
+def testRemoteFunctionNotSerializableBinaryInput(env):
+    """#!js api_version=1.0 name=foo
+const remote_get = "remote_get";
+
+redis.registerClusterFunction(remote_get, async(client, key) => {
+    return key;
+}, {serialization: 'binary'});
+
+redis.registerAsyncFunction("test", async (async_client, key) => {
+    return await async_client.runOnKey(key, remote_get, {f: ()=>{return 1;}});
+});
+    """
+    env.expectTfcallAsync('foo', 'test', ['1']).error().contains('Failed serializing arguments, Functions can not be serialized')
+
+@gearsTest()
+def testRemoteFunctionNotSerializableBinaryWeakMap(env):
+    """#!js api_version=1.0 name=foo
+const remote_get = "remote_get";
+
+redis.registerClusterFunction(remote_get, async(client, key) => {
+    return key;
+}, {serialization: 'binary'});
+
+redis.registerAsyncFunction("test", async (async_client, key) => {
+    return await async_client.runOnKey(key, remote_get, {m: new WeakMap()});
+});
+    """
+    env.expectTfcallAsync('foo', 'test', ['1']).error().contains('Failed serializing arguments, WeakMap values can not be serialized')
+
+@gearsTest()
+def testRemoteFunctionNotSerializableBinaryBigInt(env):
+    """#!js api_version=1.0 name=foo
+const remote_get = "remote_get";
+
+redis.registerClusterFunction(remote_get, async(client, key) => {
+    return key;
+}, {serialization: 'binary'});
+
+redis.registerAsyncFunction("test", async (async_client, key) => {
+    return await async_client.runOnKey(key, remote_get, [2n ** 64n]);
+});
+    """
+    env.expectTfcallAsync('foo', 'test', ['1']).error().contains('BigInt values outside of the 64 bit integer range can not be serialized')
+
+@gearsTest()
+def testRegisterRemoteFunctionUnknownSerialization(env):
+    script = """#!js api_version=1.0 name=foo
+redis.registerClusterFunction("remote", async (async_client, key) => {
+    return key;
+}, {serialization: 'foo'});
+    """
+    env.expect('TFUNCTION', 'LOAD', script).error().contains("Unknown serialization 'foo'")
+
 @gearsTest()
 def testRegisterRemoteFunctionWorngNumberOfArgs(env):
     script = """#!js api_version=1.0 name=foo
@@ -362,6 +416,13 @@ def testMalformedLibraryMetaData7(env):
     code = '#!js name=foo' # no API version
     env.expect('TFUNCTION', 'LOAD', code).error().contains('The api version is missing from the prologue.')
 
+@gearsTest()
+def testMalformedLibraryMetaData8(env):
+    code = '#!js api_version=1.0 name=foo isolates=0' # invalid number of isolates
+    env.expect('TFUNCTION', 'LOAD', code).error().contains('Invalid number of isolates: "0"')
+    code = '#!js api_version=1.0 name=foo isolates=100' # too many isolates
+    env.expect('TFUNCTION', 'LOAD', code).error().contains('Invalid number of isolates: "100"')
+
 
 @gearsTest()
 def testNoLibraryCode(env):
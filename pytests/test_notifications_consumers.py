@@ -325,3 +325,213 @@ redis.registerKeySpaceTrigger("consumer", "", (client, data) => {
 });
     """
     env.expect('TFUNCTION', 'LOAD', script).error().contains("'onTriggerFired' argument to 'registerKeySpaceTrigger' must be a function")
+
+@gearsTest()
+def testNotificationsRoutingOnUpgrade(env):
+    """#!js api_version=1.0 name=lib
+var n_notifications = 0;
+redis.registerKeySpaceTrigger("consumer", "x", function(client, data) {
+    n_notifications += 1;
+});
+
+redis.registerFunction("n_notifications", function(){
+    return n_notifications
+})
+    """
+    env.expect('SET', 'x1', '1').equal(True)
+    env.expect('SET', 'y1', '1').equal(True)
+    env.expectTfcall('lib', 'n_notifications').equal(1)
+
+    script = '''#!js api_version=1.0 name=lib
+var n_notifications = 0;
+redis.registerKeySpaceTrigger("consumer", "%s", function(client, data) {
+    n_notifications += 1;
+});
+
+redis.registerFunction("n_notifications", function(){
+    return n_notifications
+})
+%s
+    '''
+    env.expect('TFUNCTION', 'LOAD', 'REPLACE', script % ('y', '')).equal('OK')
+    env.expect('SET', 'x1', '1').equal(True)
+    env.expect('SET', 'y1', '1').equal(True)
+    env.expectTfcall('lib', 'n_notifications').equal(1)
+
+    # failed upgrade must keep the trigger on the old prefix
+    env.expect('TFUNCTION', 'LOAD', 'REPLACE', script % ('z', 'redis.registerFunction("n_notifications", "bar");')).error().contains('must be a function')
+    env.expect('SET', 'z1', '1').equal(True)
+    env.expect('SET', 'y1', '1').equal(True)
+    env.expectTfcall('lib', 'n_notifications').equal(2)
+
+@gearsTest()
+def testNotificationsRoutingMultipleLibraries(env):
+    script = '''#!js api_version=1.0 name=%s
+var n_notifications = 0;
+redis.registerKeySpaceTrigger("consumer", "%s", function(client, data) {
+    n_notifications += 1;
+});
+
+redis.registerFunction("n_notifications", function(){
+    return n_notifications
+})
+    '''
+    env.expect('TFUNCTION', 'LOAD', script % ('lib1', 'a')).equal('OK')
+    env.expect('TFUNCTION', 'LOAD', script % ('lib2', 'ab')).equal('OK')
+    env.expect('TFUNCTION', 'LOAD', script % ('lib3', 'b')).equal('OK')
+    env.expect('SET', 'abc', '1').equal(True)
+    env.expectTfcall('lib1', 'n_notifications').equal(1)
+    env.expectTfcall('lib2', 'n_notifications').equal(1)
+    env.expectTfcall('lib3', 'n_notifications').equal(0)
+
+    env.expect('TFUNCTION', 'DELETE', 'lib1').equal('OK')
+    env.expect('SET', 'abc', '1').equal(True)
+    env.expectTfcall('lib2', 'n_notifications').equal(2)
+    env.expectTfcall('lib3', 'n_notifications').equal(0)
+
+@gearsTest()
+def testNotificationsReusesClient(env):
+    """#!js api_version=1.0 name=lib
+var clients = [];
+redis.registerFunction("same_client", function(){
+    return clients.every((c) => c === clients[0]) ? clients.length : 0;
+})
+redis.registerFunction("use_old_client", function(){
+    return clients[0].call('ping');
+})
+redis.registerKeySpaceTrigger("consumer", "", function(client){
+    client.call('ping');
+    clients.push(client);
+}, {
+    onTriggerFired: (client) => {
+        client.call('ping');
+        clients.push(client);
+    }
+})
+    """
+    env.expect('SET', 'x', '1').equal(True)
+    env.expect('SET', 'y', '1').equal(True)
+    env.expectTfcall('lib', 'same_client').equal(4)
+    env.expectTfcall('lib', 'use_old_client').error().contains('Used on invalid client')
+
+@gearsTest()
+def testNotificationsFilter(env):
+    """#!js api_version=1.0 name=lib
+var notifications = [];
+redis.registerKeySpaceTrigger("consumer", "user:", function(client, data) {
+    notifications.push(data.event + ' ' + data.key);
+}, {
+    events: ['hset', 'hdel'],
+    keySuffix: ':profile',
+    maxKeyLength: 14
+});
+
+redis.registerFunction("notifications", function(){
+    return notifications;
+})
+    """
+    env.expect('HSET', 'user:1:profile', 'name', 'foo').equal(1)
+    env.expect('HDEL', 'user:1:profile', 'name').equal(1)
+    env.expect('SET', 'user:2:profile', 'foo').equal(True)
+    env.expect('HSET', 'user:3:settings', 'name', 'foo').equal(1)
+    env.expect('HSET', 'user:123:profile', 'name', 'foo').equal(1)
+    env.expect('DEL', 'user:2:profile').equal(1)
+    env.expectTfcall('lib', 'notifications').equal(['hset user:1:profile', 'hdel user:1:profile'])
+    res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)
+    env.assertEqual(res[0]['keyspace_triggers'][0]['num_trigger'], 2)
+
+@gearsTest()
+def testNotificationsFilterUpgrade(env):
+    script = '''#!js api_version=1.0 name=lib
+var n_notifications = 0;
+redis.registerKeySpaceTrigger("consumer", "", function(client, data) {
+    n_notifications += 1;
+}%s);
+
+redis.registerFunction("n_notifications", function(){
+    return n_notifications
+})
+    '''
+    env.expect('TFUNCTION', 'LOAD', script % ", {events: ['set']}").equal('OK')
+    env.expect('SET', 'x', '1').equal(True)
+    env.expect('DEL', 'x').equal(1)
+    env.expectTfcall('lib', 'n_notifications').equal(1)
+
+    # failed upgrade must keep the old filter
+    env.expect('TFUNCTION', 'LOAD', 'REPLACE', script % ", {events: ['del']}); redis.registerFunction('n_notifications', 'bar'").error().contains('must be a function')
+    env.expect('SET', 'x', '1').equal(True)
+    env.expect('DEL', 'x').equal(1)
+    env.expectTfcall('lib', 'n_notifications').equal(2)
+
+    env.expect('TFUNCTION', 'LOAD', 'REPLACE', script % '').equal('OK')
+    env.expect('SET', 'x', '1').equal(True)
+    env.expect('DEL', 'x').equal(1)
+    env.expectTfcall('lib', 'n_notifications').equal(2)
+
+@gearsTest()
+def testNotificationsFilterBadArguments(env):
+    script = '''#!js api_version=1.0 name=lib
+redis.registerKeySpaceTrigger("consumer", "", function(client, data) {}, %s);
+    '''
+    env.expect('TFUNCTION', 'LOAD', script % "{events: []}").error().contains('events argument must not be empty')
+    env.expect('TFUNCTION', 'LOAD', script % "{events: ['set', 1]}").error().contains('events argument must be an array of strings')
+    env.expect('TFUNCTION', 'LOAD', script % "{minKeyLength: -1}").error().contains('minKeyLength argument must be a non negative number')
+    env.expect('TFUNCTION', 'LOAD', script % "{minKeyLength: 5, maxKeyLength: 4}").error().contains('maxKeyLength argument must be greater or equal to minKeyLength')
+
+@gearsTest()
+def testNotificationsDebounce(env):
+    """#!js api_version=1.0 name=lib
+var notifications = [];
+redis.registerKeySpaceTrigger("consumer", "x", function(client, data) {
+    notifications.push(data.event + ' ' + data.key + ' ' + client.call('get', data.key));
+}, {
+    debounceWindow: 200
+});
+
+redis.registerFunction("notifications", function(){
+    return notifications;
+})
+    """
+    for i in range(100):
+        env.cmd('SET', 'x1', str(i))
+    env.cmd('SET', 'x2', '1')
+    env.cmd('DEL', 'x2')
+    env.expectTfcall('lib', 'notifications').equal([])
+    runUntil(env, ['set x1 99', 'del x2 null'], lambda: env.tfcall('lib', 'notifications'))
+    res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['keyspace_triggers'][0]
+    env.assertEqual(res['debounce_window'], 200)
+    env.assertEqual(res['num_events'], 102)
+    env.assertEqual(res['num_trigger'], 2)
+
+@gearsTest()
+def testNotificationsDebounceMaxEvents(env):
+    """#!js api_version=1.0 name=lib
+var notifications = [];
+redis.registerKeySpaceTrigger("consumer", "x", function(client, data) {
+    notifications.push(data.event + ' ' + data.key + ' ' + client.call('get', data.key));
+}, {
+    debounceWindow: 100000,
+    debounceMaxEvents: 10
+});
+
+redis.registerFunction("notifications", function(){
+    return notifications;
+})
+    """
+    for i in range(25):
+        env.cmd('SET', 'x1', str(i))
+    env.expectTfcall('lib', 'notifications').equal(['set x1 9', 'set x1 19'])
+    res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['keyspace_triggers'][0]
+    env.assertEqual(res['debounce_max_events'], 10)
+    env.assertEqual(res['num_events'], 25)
+    env.assertEqual(res['num_trigger'], 2)
+
+@gearsTest()
+def testNotificationsDebounceBadArguments(env):
+    script = '''#!js api_version=1.0 name=lib
+redis.registerKeySpaceTrigger("consumer", "", function(client, data) {}, %s);
+    '''
+    env.expect('TFUNCTION', 'LOAD', script % "{debounceMaxEvents: 10}").error().contains('debounceMaxEvents argument can only be used together with debounceWindow')
+    env.expect('TFUNCTION', 'LOAD', script % "{debounceWindow: 0}").error().contains('debounceWindow argument must be a positive number')
+    env.expect('TFUNCTION', 'LOAD', script % "{debounceWindow: 10, debounceMaxEvents: 0}").error().contains('debounceMaxEvents argument must be a positive number')
+    env.expect('TFUNCTION', 'LOAD', script % "{debounceWindow: 10, onTriggerFired: () => {}}").error().contains('onTriggerFired argument can not be used together with debounceWindow')
@@ -88,11 +88,41 @@ redis.registerStreamTrigger("consumer", "stream",
     """
     env.expectTfcall('lib', 'num_events').equal(0)
     env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
-    env.expect('xlen', 'stream:1').equal(0)
     env.expectTfcall('lib', 'num_events').equal(1)
+    # trimming is deferred to the next cron tick
+    runUntil(env, 0, lambda: env.cmd('xlen', 'stream:1'))
     env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
-    env.expect('xlen', 'stream:1').equal(0)
     env.expectTfcall('lib', 'num_events').equal(2)
+    runUntil(env, 0, lambda: env.cmd('xlen', 'stream:1'))
+
+@gearsTest(withReplicas=True)
+def testStreamTrimIsCoalesced(env):
+    """#!js api_version=1.0 name=lib
+redis.registerStreamTrigger("consumer", "stream",
+    function(){
+        return;
+    },
+    {
+        isStreamTrimmed: true
+    }
+);
+
+redis.registerFunction("add_records",
+    function(client) {
+        for (var i = 0; i < 100; i++) {
+            client.call('xadd', 'stream:1', '*', 'foo', 'bar');
+        }
+        return 'OK';
+    }
+)
+    """
+    slave_conn = env.getSlaveConnection()
+    env.expectTfcall('lib', 'add_records').equal('OK')
+    runUntil(env, 0, lambda: env.cmd('xlen', 'stream:1'))
+    env.expect('WAIT', '1', '1000').equal(1)
+    env.assertEqual(slave_conn.execute_command('xlen', 'stream:1'), 0)
+    # the acknowledged records are trimmed together and not one by one
+    env.assertLess(slave_conn.execute_command('info', 'commandstats')['cmdstat_xtrim']['calls'], 10)
 
 @gearsTest(withReplicas=True)
 def testSyncStreamTrimWithReplica(env):
@@ -108,11 +138,11 @@ redis.registerStreamTrigger("consumer", "stream",
     """
     slave_conn = env.getSlaveConnection()
     env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
-    env.expect('xlen', 'stream:1').equal(0)
+    runUntil(env, 0, lambda: env.cmd('xlen', 'stream:1'))
     env.expect('WAIT', '1', '1000').equal(1)
     env.assertEqual(slave_conn.execute_command('xlen', 'stream:1'), 0)
     env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
-    env.expect('xlen', 'stream:1').equal(0)
+    runUntil(env, 0, lambda: env.cmd('xlen', 'stream:1'))
     env.expect('WAIT', '1', '1000').equal(1)
     env.assertEqual(slave_conn.execute_command('xlen', 'stream:1'), 0)
 
@@ -254,6 +284,42 @@ redis.registerStreamTrigger("consumer", "stream",
     runUntil(env, id2, continue_function)
 
 
+@gearsTest(withReplicas=True)
+def testStreamCheckpointReplicationIsCoalesced(env):
+    """#!js api_version=1.0 name=lib
+redis.registerStreamTrigger("consumer", "stream",
+    function(){
+        return;
+    }
+);
+
+redis.registerFunction("add_records",
+    function(client) {
+        for (var i = 0; i < 100; i++) {
+            client.call('xadd', 'stream:1', '*', 'foo', 'bar');
+        }
+        return 'OK';
+    }
+)
+    """
+    slave_conn = env.getSlaveConnection()
+    def replicated_checkpoints():
+        res = slave_conn.execute_command('info', 'commandstats')
+        return res.get('cmdstat__rg_internals.update_stream_last_read_id', {'calls': 0})['calls']
+
+    env.expectTfcall('lib', 'add_records').equal('OK')
+    id_to_read_from = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams'][0]['id_to_read_from']
+    runUntil(env, id_to_read_from, lambda: toDictionary(slave_conn.execute_command('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams'][0]['id_to_read_from'])
+    # only the latest progress is replicated
+    env.assertLess(replicated_checkpoints(), 10)
+
+    # replicate the progress on every acknowledgement
+    env.expect('CONFIG', 'SET', 'redisgears_2.stream-checkpoint-max-acks', '1').equal('OK')
+    calls = replicated_checkpoints()
+    env.expectTfcall('lib', 'add_records').equal('OK')
+    env.expect('WAIT', '1', '1000').equal(1)
+    env.assertEqual(replicated_checkpoints(), calls + 100)
+
 @gearsTest()
 def testStreamDeletoin(env):
     """#!js api_version=1.0 name=lib
@@ -309,6 +375,26 @@ redis.registerStreamTrigger("consumer", "stream",
     res = env.cmd('TFUNCTION', 'LIST', 'vvv')
     env.assertEqual(0, len(toDictionary(res, 6)[0]['stream_triggers'][0]['streams']))
 
+@gearsTest()
+def testStreamRenamedOrOverwritten(env):
+    """#!js api_version=1.0 name=lib
+redis.registerStreamTrigger("consumer", "stream",
+    function(){
+        return;
+    }
+);
+    """
+    env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
+    runUntil(env, 1, lambda: len(toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams']))
+    env.expect('rename', 'stream:1', 'renamed').equal(True)
+    runUntil(env, 0, lambda: len(toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams']))
+
+    # overwriting a stream does not notify about its deletion, it is reclaimed once idle.
+    env.cmd('xadd', 'stream:2', '*', 'foo', 'bar')
+    runUntil(env, 1, lambda: len(toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams']))
+    env.expect('set', 'stream:2', 'foo').equal(True)
+    runUntil(env, 0, lambda: len(toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams']), timeout=30)
+
 @gearsTest()
 def testFlushall(env):
     """#!js api_version=1.0 name=lib
@@ -670,10 +756,57 @@ redis.registerFunction("test2",
 )
     """
     env.expectTfcall('lib', 'test1').equal('OK')
-    env.expect('xlen', 'stream:1').equal(0)
+    runUntil(env, 0, lambda: env.cmd('xlen', 'stream:1'))
     env.expectTfcall('lib', 'test2').equal('OK')
     env.expect('exists', 'stream:1').equal(False)
 
+@gearsTest()
+def testStreamReaderCoalescedNotifications(env):
+    """#!js api_version=1.0 name=lib
+var records = {};
+redis.registerFunction("records", function(client, stream){
+    return records[stream];
+})
+redis.registerStreamTrigger("consumer", "stream", function(c, data){
+    if (!records[data.stream_name]) {
+        records[data.stream_name] = [];
+    }
+    records[data.stream_name].push(data.record[0][1]);
+})
+    """
+    conn = env.getConnection()
+    pipe = conn.pipeline(transaction=True)
+    for i in range(100):
+        pipe.execute_command('xadd', 'stream:1', '*', 'foo', str(i))
+        pipe.execute_command('xadd', 'stream:2', '*', 'foo', str(i))
+    pipe.execute()
+    # the notifications of the transaction are processed together, without losing records.
+    env.expectTfcall('lib', 'records', ['stream:1']).equal([str(i) for i in range(100)])
+    env.expectTfcall('lib', 'records', ['stream:2']).equal([str(i) for i in range(100)])
+    env.cmd('xadd', 'stream:1', '*', 'foo', '100')
+    env.expectTfcall('lib', 'records', ['stream:1']).equal([str(i) for i in range(101)])
+
+@gearsTest()
+def testStreamReaderCoalescedTransactionNotifications(env):
+    """#!js api_version=1.0 name=lib
+var lengths = [];
+redis.registerFunction("lengths", function(){
+    return lengths;
+})
+redis.registerStreamTrigger("consumer", "stream", function(c, data){
+    lengths.push(c.call('xlen', data.stream_name));
+})
+    """
+    conn = env.getConnection()
+    pipe = conn.pipeline(transaction=True)
+    for i in range(100):
+        pipe.execute_command('xadd', 'stream:1', '*', 'foo', str(i))
+    pipe.execute()
+    # the stream is processed once, after all the writes of the transaction.
+    env.expectTfcall('lib', 'lengths').equal([100] * 100)
+    env.cmd('xadd', 'stream:1', '*', 'foo', '100')
+    env.expectTfcall('lib', 'lengths').equal([100] * 100 + [101])
+
 @gearsTest()
 def testupdateStreamLastReadIdInternalCommand(env):
     # make sure we get a legacy key spec (first_key, last_key, steps)
@@ -682,3 +815,238 @@ def testupdateStreamLastReadIdInternalCommand(env):
     env.assertEqual(res['first_key_pos'], 3)
     env.assertEqual(res['last_key_pos'], 3)
     env.assertEqual(res['step_count'], 1)
+
+@gearsTest()
+def testStreamReaderBatch(env):
+    """#!js api_version=1.0 name=lib
+var batches = [];
+redis.registerFunction("batches", function(){
+    return batches;
+})
+redis.registerStreamTrigger("consumer", "stream", function(c, records){
+    batches.push(records.map((r) => r.record[0][1]));
+},
+{
+    batchSize: 3,
+    maxBatchDelay: 100000
+})
+    """
+    env.cmd('xadd', 'stream:1', '*', 'foo', '1')
+    env.cmd('xadd', 'stream:1', '*', 'foo', '2')
+    env.expectTfcall('lib', 'batches').equal([])
+    env.cmd('xadd', 'stream:1', '*', 'foo', '3')
+    env.expectTfcall('lib', 'batches').equal([['1', '2', '3']])
+    res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)
+    env.assertEqual(3, res[0]['stream_triggers'][0]['batch_size'])
+    env.assertEqual(3, res[0]['stream_triggers'][0]['streams'][0]['total_record_processed'])
+
+@gearsTest()
+def testAsyncStreamReaderBatchMaxDelay(env):
+    """#!js api_version=1.0 name=lib
+var batches = [];
+redis.registerFunction("batches", function(){
+    return batches;
+})
+redis.registerStreamTrigger("consumer", "stream", async function(c, records){
+    batches.push(records.map((r) => r.record[0][1]));
+},
+{
+    batchSize: 10,
+    maxBatchDelay: 100
+})
+    """
+    env.cmd('xadd', 'stream:1', '*', 'foo', '1')
+    env.cmd('xadd', 'stream:1', '*', 'foo', '2')
+    runUntil(env, [['1', '2']], lambda: env.tfcall('lib', 'batches'))
+
+@gearsTest()
+def testAsyncStreamReaderBatchWindow(env):
+    """#!js api_version=1.0 name=lib
+var batches = [];
+var promises = [];
+redis.registerFunction("batches", function(){
+    return batches;
+})
+redis.registerFunction("continue_all", function(){
+    promises.forEach((resolve) => resolve('continue'));
+    promises = [];
+    return "OK"
+})
+redis.registerStreamTrigger("consumer", "stream", async function(c, records){
+    batches.push(records.map((r) => r.record[0][1]));
+    return await new Promise((resolve, reject) => {
+        promises.push(resolve);
+    });
+},
+{
+    batchSize: 10,
+    maxBatchDelay: 100,
+    window: 1
+})
+    """
+    env.cmd('xadd', 'stream:1', '*', 'foo', '1')
+    runUntil(env, [['1']], lambda: env.tfcall('lib', 'batches'))
+    env.cmd('xadd', 'stream:1', '*', 'foo', '2')
+    # the partial batch in flight fills the window.
+    time.sleep(0.5)
+    env.expectTfcall('lib', 'batches').equal([['1']])
+    env.tfcall('lib', 'continue_all')
+    runUntil(env, [['1'], ['2']], lambda: env.tfcall('lib', 'batches'))
+
+@gearsTest()
+def testStreamReaderBatchBadArguments(env):
+    script = '''#!js api_version=1.0 name=foo
+redis.registerStreamTrigger("consumer", "stream", function(c, records){}, {maxBatchDelay: 10})
+    '''
+    env.expect('TFUNCTION', 'LOAD', script).error().contains('maxBatchDelay argument can only be used together with batchSize')
+    script = '''#!js api_version=1.0 name=foo
+redis.registerStreamTrigger("consumer", "stream", function(c, records){}, {batchSize: 0})
+    '''
+    env.expect('TFUNCTION', 'LOAD', script).error().contains('batchSize argument must be a positive number')
+
+@gearsTest()
+def testStreamReaderAdaptiveWindow(env):
+    """#!js api_version=1.0 name=lib
+var promises = [];
+redis.registerFunction("continue_all", function(){
+    promises.forEach((resolve) => resolve('continue'));
+    promises = [];
+    return "OK"
+})
+redis.registerStreamTrigger("consumer", "stream",
+    async function(){
+        return await new Promise((resolve, reject) => {
+            promises.push(resolve);
+        });
+    },
+    {
+        window: 1,
+        maxWindow: 4
+    }
+);
+    """
+    for i in range(30):
+        env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
+
+    def continue_all():
+        env.tfcall('lib', 'continue_all')
+        return toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams'][0]['total_record_processed']
+
+    # records wait on the stream and are processed fast, the window grows up to maxWindow.
+    runUntil(env, 30, continue_all, timeout=10)
+    res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]
+    env.assertEqual(1, res['window'])
+    env.assertEqual(4, res['max_window'])
+    env.assertEqual(1000, res['target_latency'])
+    env.assertEqual(4, res['streams'][0]['window'])
+
+@gearsTest()
+def testStreamReaderAdaptiveWindowBadArguments(env):
+    script = '''#!js api_version=1.0 name=foo
+redis.registerStreamTrigger("consumer", "stream", function(c){}, {targetLatency: 10})
+    '''
+    env.expect('TFUNCTION', 'LOAD', script).error().contains('targetLatency argument can only be used together with maxWindow')
+    script = '''#!js api_version=1.0 name=foo
+redis.registerStreamTrigger("consumer", "stream", function(c){}, {window: 3, maxWindow: 2})
+    '''
+    env.expect('TFUNCTION', 'LOAD', script).error().contains('maxWindow argument must be greater or equal to window')
+    script = '''#!js api_version=1.0 name=foo
+redis.registerStreamTrigger("consumer", "stream", function(c){}, {maxWindow: 2, targetLatency: 0})
+    '''
+    env.expect('TFUNCTION', 'LOAD', script).error().contains('targetLatency argument must be a positive number')
+
+@gearsTest()
+def testStreamReaderOnlyTracksConsumedStreams(env):
+    """#!js api_version=1.0 name=lib
+var num_events = 0;
+redis.registerFunction("num_events", function(){
+    return num_events;
+})
+redis.registerStreamTrigger("consumer", "stream", function(){
+    num_events++;
+})
+    """
+    for i in range(100):
+        env.cmd('xadd', 'other:%d' % i, '*', 'foo', 'bar')
+    env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
+    env.expectTfcall('lib', 'num_events').equal(1)
+    res = toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)
+    env.assertEqual(['stream:1'], [s['name'] for s in res[0]['stream_triggers'][0]['streams']])
+
+@gearsTest()
+def testStreamReaderOnExpiredStream(env):
+    """#!js api_version=1.0 name=lib
+var num_events = 0;
+redis.registerFunction("num_events", function(){
+    return num_events;
+})
+redis.registerStreamTrigger("consumer", "stream", function(){
+    num_events++;
+})
+    """
+    env.cmd('xadd', 'stream:1', '2-1', 'foo', 'bar')
+    env.expectTfcall('lib', 'num_events').equal(1)
+    env.cmd('pexpire', 'stream:1', '1')
+    runUntil(env, 0, lambda: env.cmd('exists', 'stream:1'))
+    runUntil(env, 0, lambda: len(toDictionary(env.cmd('TFUNCTION', 'LIST', 'vvv'), 6)[0]['stream_triggers'][0]['streams']))
+
+    # a new stream with the same name is read from the start
+    env.cmd('xadd', 'stream:1', '1-1', 'foo', 'bar')
+    env.expectTfcall('lib', 'num_events').equal(2)
+
+@gearsTest()
+def testStreamReaderReusesClient(env):
+    """#!js api_version=1.0 name=lib
+var clients = [];
+redis.registerFunction("same_client", function(){
+    return clients.every((c) => c === clients[0]) ? clients.length : 0;
+})
+redis.registerFunction("use_old_client", function(){
+    return clients[0].call('ping');
+})
+redis.registerStreamTrigger("consumer", "stream", function(client){
+    client.call('ping');
+    clients.push(client);
+})
+    """
+    env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
+    env.cmd('xadd', 'stream:2', '*', 'foo', 'bar')
+    env.expectTfcall('lib', 'same_client').equal(2)
+    env.expectTfcall('lib', 'use_old_client').error().contains('Used on invalid client')
+
+@gearsTest(decodeResponses=False)
+def testStreamReaderLazyRecords(env):
+    """#!js api_version=1.0 name=lib
+var last_data = null;
+redis.registerFunction("stats", function(){
+    return last_data;
+})
+redis.registerStreamTrigger("consumer", "stream", function(c, data){
+    last_data = [
+        data.record === undefined ? 1 : 0,
+        data.get('foo'),
+        data.getRaw('foo'),
+        data.get(new Uint8Array([255]).buffer),
+        data.getRaw(new Uint8Array([255]).buffer),
+        data.get('bar'),
+    ];
+}, {
+    lazyRecords: true
+})
+    """
+    env.cmd('xadd', 'stream:1', '*', 'foo', 'bar', 'foo', 'baz', b'\xff', b'\xff')
+    env.expectTfcall('lib', 'stats').equal([1, b'bar', b'bar', None, b'\xff', None])
+
+@gearsTest()
+def testStreamReaderRecordGet(env):
+    """#!js api_version=1.0 name=lib
+var last_data = null;
+redis.registerFunction("stats", function(){
+    return last_data;
+})
+redis.registerStreamTrigger("consumer", "stream", function(c, data){
+    last_data = [data.record[0][1], data.get('foo'), data.get('bar')];
+})
+    """
+    env.cmd('xadd', 'stream:1', '*', 'foo', 'bar')
+    env.expectTfcall('lib', 'stats').equal(['bar', 'bar', None])
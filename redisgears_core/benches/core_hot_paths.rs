@@ -0,0 +1,70 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Micro benchmarks of the stream reader and the key space notifications
+//! dispatch, run with `cargo bench -p redisgears_core --features bench`.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use redisgears::bench::{
+    KeysNotificationsBench, LinkedListAckBench, PendingAckBench, StreamReaderBench,
+};
+
+const STREAM_LEN: u64 = 1000;
+
+fn stream_reader(c: &mut Criterion) {
+    let mut group = c.benchmark_group("stream_reader_on_stream_touched");
+    for batch_size in [None, Some(100)] {
+        for consumers in [1, 10, 100] {
+            let mut bench = StreamReaderBench::new(consumers, STREAM_LEN, batch_size);
+            let name = match batch_size {
+                Some(batch_size) => format!("batch_{batch_size}"),
+                None => "no_batch".to_string(),
+            };
+            group.throughput(Throughput::Elements(consumers as u64 * STREAM_LEN));
+            group.bench_function(BenchmarkId::new(name, consumers), |b| {
+                b.iter(|| bench.touch())
+            });
+        }
+    }
+    group.finish();
+}
+
+fn keys_notifications(c: &mut Criterion) {
+    let mut group = c.benchmark_group("keys_notifications_on_key_touched");
+    for consumers in [10, 1000, 10000] {
+        for matched in [1, 10] {
+            let bench = KeysNotificationsBench::new(consumers, matched);
+            group.bench_function(
+                BenchmarkId::new(format!("matched_{matched}"), consumers),
+                |b| b.iter(|| bench.touch()),
+            );
+        }
+    }
+    group.finish();
+}
+
+fn ack_id(c: &mut Criterion) {
+    let mut group = c.benchmark_group("consumer_info_ack_id");
+    for window in [1, 100, 10000] {
+        group.throughput(Throughput::Elements(window));
+        for reverse in [false, true] {
+            let mut bench = PendingAckBench::new(window);
+            let name = if reverse { "reverse_order" } else { "in_order" };
+            group.bench_function(BenchmarkId::new(name, window), |b| {
+                b.iter(|| bench.run(reverse))
+            });
+            let mut bench = LinkedListAckBench::new(window);
+            group.bench_function(
+                BenchmarkId::new(format!("linked_list_{name}"), window),
+                |b| b.iter(|| bench.run(reverse)),
+            );
+        }
+    }
+    group.finish();
+}
+
+criterion_group!(benches, stream_reader, keys_notifications, ack_id);
+criterion_main!(benches);
@@ -0,0 +1,150 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Additive increase, multiplicative decrease tuning of the window of a
+//! stream consumer.
+//!
+//! The window is halved when the processing time of a delivery exceeds
+//! the target latency, the deliveries are queuing up on the consumer side.
+//! It grows by one after a full window of deliveries was acknowledged, if
+//! the window was full and the records waited longer on the stream than
+//! they took to process, the consumer could keep up with more deliveries.
+//! The time a record waited on the stream is its lag (the time since it was
+//! added) minus its processing time.
+
+use redisgears_plugin_api::redisgears_plugin_api::stream_ctx::StreamAdaptiveWindowConfig;
+
+use std::time::Duration;
+
+#[derive(Debug, Clone)]
+pub(crate) struct AdaptiveWindow {
+    window: usize,
+    /// Deliveries acknowledged since the window was last changed.
+    acked: usize,
+    /// Deliveries that were in flight when the window was last decreased.
+    /// They were sent with the old window, so their processing time is not
+    /// considered as a reason to decrease the window again.
+    in_flight_on_decrease: usize,
+}
+
+impl AdaptiveWindow {
+    pub(crate) fn new(min_window: usize) -> AdaptiveWindow {
+        AdaptiveWindow {
+            window: min_window,
+            acked: 0,
+            in_flight_on_decrease: 0,
+        }
+    }
+
+    /// The current window, within the given bounds. The bounds might change
+    /// on a library upgrade.
+    pub(crate) fn window(&self, min_window: usize, config: &StreamAdaptiveWindowConfig) -> usize {
+        self.window.min(config.max_window).max(min_window)
+    }
+
+    /// Update the window after a delivery was acknowledged.
+    /// `in_flight` is the amount of deliveries that are still pending,
+    /// `window_full` indicates whether the window limited the deliveries
+    /// and `lag` is the time since the record was added to the stream.
+    pub(crate) fn on_ack(
+        &mut self,
+        min_window: usize,
+        config: &StreamAdaptiveWindowConfig,
+        in_flight: usize,
+        window_full: bool,
+        processing_time: Duration,
+        lag: Duration,
+    ) {
+        self.window = self.window(min_window, config);
+        self.acked += 1;
+        if processing_time > Duration::from_millis(config.target_latency as u64) {
+            if self.acked > self.in_flight_on_decrease {
+                self.window = (self.window / 2).max(min_window);
+                self.acked = 0;
+                self.in_flight_on_decrease = in_flight;
+            }
+            return;
+        }
+        let queue_wait = lag.saturating_sub(processing_time);
+        if window_full && queue_wait > processing_time && self.acked >= self.window {
+            self.window = (self.window + 1).min(config.max_window);
+            self.acked = 0;
+            self.in_flight_on_decrease = 0;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const CONFIG: StreamAdaptiveWindowConfig = StreamAdaptiveWindowConfig {
+        max_window: 8,
+        target_latency: 100,
+    };
+
+    const FAST: Duration = Duration::from_millis(10);
+    const SLOW: Duration = Duration::from_millis(200);
+    /// The records waited 40ms on the stream before they were processed.
+    const LAG: Duration = Duration::from_millis(50);
+
+    fn ack_window(w: &mut AdaptiveWindow, processing_time: Duration, lag: Duration) {
+        let window = w.window(1, &CONFIG);
+        (0..window).for_each(|_| w.on_ack(1, &CONFIG, window, true, processing_time, lag));
+    }
+
+    #[test]
+    fn test_additive_increase() {
+        let mut w = AdaptiveWindow::new(1);
+        (2..=CONFIG.max_window).for_each(|expected| {
+            ack_window(&mut w, FAST, LAG);
+            assert_eq!(w.window(1, &CONFIG), expected);
+        });
+        ack_window(&mut w, FAST, LAG);
+        assert_eq!(w.window(1, &CONFIG), CONFIG.max_window);
+    }
+
+    #[test]
+    fn test_no_increase_without_backlog() {
+        let mut w = AdaptiveWindow::new(1);
+        // the window is not full, the consumer keeps up with the stream.
+        (0..10).for_each(|_| w.on_ack(1, &CONFIG, 0, false, FAST, LAG));
+        assert_eq!(w.window(1, &CONFIG), 1);
+        // records waited less on the stream than they took to process.
+        ack_window(&mut w, FAST, Duration::from_millis(15));
+        assert_eq!(w.window(1, &CONFIG), 1);
+    }
+
+    #[test]
+    fn test_multiplicative_decrease() {
+        let mut w = AdaptiveWindow::new(1);
+        (0..7).for_each(|_| ack_window(&mut w, FAST, LAG));
+        assert_eq!(w.window(1, &CONFIG), 8);
+        w.on_ack(1, &CONFIG, 7, true, SLOW, LAG);
+        assert_eq!(w.window(1, &CONFIG), 4);
+        // the deliveries sent with the old window do not decrease it again.
+        (0..7).for_each(|_| w.on_ack(1, &CONFIG, 7, true, SLOW, LAG));
+        assert_eq!(w.window(1, &CONFIG), 4);
+        w.on_ack(1, &CONFIG, 3, true, SLOW, LAG);
+        assert_eq!(w.window(1, &CONFIG), 2);
+        (0..10).for_each(|_| w.on_ack(1, &CONFIG, 0, true, SLOW, LAG));
+        assert_eq!(w.window(1, &CONFIG), 1);
+    }
+
+    #[test]
+    fn test_bounds_change() {
+        let mut w = AdaptiveWindow::new(1);
+        (0..7).for_each(|_| ack_window(&mut w, FAST, LAG));
+        let config = StreamAdaptiveWindowConfig {
+            max_window: 4,
+            ..CONFIG
+        };
+        assert_eq!(w.window(1, &config), 4);
+        assert_eq!(w.window(6, &config), 6);
+        w.on_ack(2, &config, 0, true, SLOW, LAG);
+        assert_eq!(w.window(2, &config), 2);
+    }
+}
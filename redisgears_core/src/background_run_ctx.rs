@@ -13,20 +13,42 @@ use redisgears_plugin_api::redisgears_plugin_api::{
 use crate::background_run_scope_guard::BackgroundRunScopeGuardCtx;
 use crate::run_ctx::RedisClientCallOptions;
 use crate::{
-    get_libraries, verify_ok_on_replica, verify_oom, Deserialize, GearsLibraryMetaData, Serialize,
+    get_libraries, lock_redis_for_background, verify_ok_on_replica, verify_oom, Deserialize,
+    GearsLibrary, GearsLibraryMetaData, Serialize,
 };
 
 use redis_module::{RedisString, RedisValue};
 
-use std::sync::atomic::Ordering;
-use std::sync::Arc;
+use std::cell::RefCell;
+use std::collections::HashMap;
+use std::rc::Rc;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::time::Instant;
 
-use mr::libmr::{calc_slot, record::Record, remote_task::RemoteTask, RustMRError};
+use mr::libmr::{calc_slot, is_my_slot, record::Record, remote_task::RemoteTask, RustMRError};
 
 use mr_derive::BaseObject;
 
 use crate::config::REMOTE_TASK_DEFAULT_TIMEOUT;
 
+/// The number of remote tasks this shard executed.
+static EXECUTED_REMOTE_TASKS: AtomicU64 = AtomicU64::new(0);
+/// The number of keys the [`GearsRemoteKeysTask`]s executed on this shard.
+static EXECUTED_REMOTE_KEYS: AtomicU64 = AtomicU64::new(0);
+
+pub(crate) struct RemoteTasksStats {
+    pub(crate) tasks: u64,
+    pub(crate) keys: u64,
+}
+
+pub(crate) fn remote_tasks_stats() -> RemoteTasksStats {
+    RemoteTasksStats {
+        tasks: EXECUTED_REMOTE_TASKS.load(Ordering::Relaxed),
+        keys: EXECUTED_REMOTE_KEYS.load(Ordering::Relaxed),
+    }
+}
+
 pub(crate) struct BackgroundRunCtx {
     call_options: RedisClientCallOptions,
     lib_meta_data: Arc<GearsLibraryMetaData>,
@@ -60,13 +82,7 @@ impl Record for GearsRemoteFunctionInputsRecord {
         RedisValue::Array(
             self.inputs
                 .iter()
-                .map(|v| {
-                    let buff = match v {
-                        RemoteFunctionData::Binary(b) => b,
-                        RemoteFunctionData::String(s) => s.as_bytes(),
-                    };
-                    RedisValue::StringBuffer(buff.to_vec())
-                })
+                .map(|v| RedisValue::StringBuffer(v.as_bytes().to_vec()))
                 .collect(),
         )
     }
@@ -83,19 +99,11 @@ pub(crate) struct GearsRemoteFunctionOutputRecord {
 
 impl Record for GearsRemoteFunctionOutputRecord {
     fn to_redis_value(&mut self) -> RedisValue {
-        let buff = match &self.output {
-            RemoteFunctionData::Binary(b) => b,
-            RemoteFunctionData::String(s) => s.as_bytes(),
-        };
-        RedisValue::StringBuffer(buff.to_vec())
+        RedisValue::StringBuffer(self.output.as_bytes().to_vec())
     }
 
     fn hash_slot(&self) -> usize {
-        let buff = match &self.output {
-            RemoteFunctionData::Binary(b) => b,
-            RemoteFunctionData::String(s) => s.as_bytes(),
-        };
-        calc_slot(buff)
+        calc_slot(self.output.as_bytes())
     }
 }
 
@@ -106,6 +114,36 @@ pub(crate) struct GearsRemoteTask {
     user: RedisString,
 }
 
+/// Returns the library holding the given remote function, the library is
+/// kept alive by the returned reference while the function is in use.
+fn get_remote_function_library(
+    lib_name: &str,
+    job_name: &str,
+) -> Result<Arc<GearsLibrary>, RustMRError> {
+    let library = {
+        let libraries = get_libraries();
+        let library = libraries.get(lib_name);
+        if library.is_none() {
+            return Err(format!(
+                "Library {} does not exists on remote shard",
+                lib_name
+            ));
+        }
+        Arc::clone(library.unwrap()) // make sure the library will not be free while in use
+    };
+    if !library
+        .gears_lib_ctx
+        .remote_functions
+        .contains_key(job_name)
+    {
+        return Err(format!(
+            "Remote function {} does not exists on library {}",
+            job_name, lib_name
+        ));
+    }
+    Ok(library)
+}
+
 impl RemoteTask for GearsRemoteTask {
     type InRecord = GearsRemoteFunctionInputsRecord;
     type OutRecord = GearsRemoteFunctionOutputRecord;
@@ -115,27 +153,15 @@ impl RemoteTask for GearsRemoteTask {
         r: Self::InRecord,
         on_done: Box<dyn FnOnce(Result<Self::OutRecord, RustMRError>) + Send>,
     ) {
-        let library = {
-            let libraries = get_libraries();
-            let library = libraries.get(&self.lib_name);
-            if library.is_none() {
-                on_done(Err(format!(
-                    "Library {} does not exists on remote shard",
-                    self.lib_name
-                )));
+        EXECUTED_REMOTE_TASKS.fetch_add(1, Ordering::Relaxed);
+        let library = match get_remote_function_library(&self.lib_name, &self.job_name) {
+            Ok(l) => l,
+            Err(e) => {
+                on_done(Err(e));
                 return;
             }
-            Arc::clone(library.unwrap()) // make sure the library will not be free while in use
         };
-        let remote_function = library.gears_lib_ctx.remote_functions.get(&self.job_name);
-        if remote_function.is_none() {
-            on_done(Err(format!(
-                "Remote function {} does not exists on library {}",
-                self.job_name, self.lib_name
-            )));
-            return;
-        }
-        let remote_function = remote_function.unwrap();
+        let remote_function = &library.gears_lib_ctx.remote_functions[&self.job_name];
         remote_function(
             r.inputs,
             Box::new(BackgroundRunCtx::new(
@@ -154,9 +180,585 @@ impl RemoteTask for GearsRemoteTask {
     }
 }
 
+#[derive(Clone, Serialize, Deserialize, BaseObject)]
+pub(crate) struct GearsRemoteFunctionKeysInputsRecord {
+    /// The slot of each key.
+    slots: Vec<usize>,
+    /// The data of the key argument of each key.
+    keys: Vec<RemoteFunctionData>,
+    inputs: Vec<RemoteFunctionData>,
+    /// Whether the record was sent to all the shards, in which case the
+    /// shards report the slots they hold instead of the keys they skipped.
+    to_all_shards: bool,
+}
+
+impl Record for GearsRemoteFunctionKeysInputsRecord {
+    fn to_redis_value(&mut self) -> RedisValue {
+        RedisValue::Array(
+            self.keys
+                .iter()
+                .chain(self.inputs.iter())
+                .map(|v| RedisValue::StringBuffer(v.as_bytes().to_vec()))
+                .collect(),
+        )
+    }
+
+    fn hash_slot(&self) -> usize {
+        1 // not relevant here
+    }
+}
+
+#[derive(Clone, Serialize, Deserialize, BaseObject)]
+pub(crate) struct GearsRemoteFunctionKeysOutputRecord {
+    /// The result of each key of the shard, with the index of the key.
+    outputs: Vec<(usize, Result<RemoteFunctionData, String>)>,
+    /// The indexes of the keys the shard was sent but does not hold.
+    skipped: Vec<usize>,
+    /// The ranges of the slots the shard holds, start inclusive and end exclusive.
+    slots: Vec<(usize, usize)>,
+}
+
+impl Record for GearsRemoteFunctionKeysOutputRecord {
+    fn to_redis_value(&mut self) -> RedisValue {
+        RedisValue::Array(
+            self.outputs
+                .iter()
+                .map(|(i, v)| {
+                    RedisValue::Array(vec![
+                        RedisValue::Integer(*i as i64),
+                        match v {
+                            Ok(v) => RedisValue::StringBuffer(v.as_bytes().to_vec()),
+                            Err(e) => RedisValue::SimpleString(e.clone()),
+                        },
+                    ])
+                })
+                .collect(),
+        )
+    }
+
+    fn hash_slot(&self) -> usize {
+        1 // not relevant here
+    }
+}
+
+/// The amount of hash slots of a cluster.
+const SLOTS: usize = 16384;
+
+/// The shard holding each slot, identified by its position in the results
+/// of the last [`GearsRemoteKeysTask`] that was sent to all the shards.
+/// Used to send the keys of [`BackgroundRunCtx::run_on_keys`] only to the
+/// shards that hold them. Dropped once a shard is sent a key it does not
+/// hold, for example after a slot migration.
+static SLOTS_OWNERS: Mutex<Option<Vec<Option<u16>>>> = Mutex::new(None);
+
+/// Returns the ranges of the slots held by this shard.
+fn my_slots() -> Vec<(usize, usize)> {
+    let mut ranges: Vec<(usize, usize)> = Vec::new();
+    (0..SLOTS)
+        .filter(|slot| is_my_slot(*slot))
+        .for_each(|slot| match ranges.last_mut() {
+            Some((_, end)) if *end == slot => *end += 1,
+            _ => ranges.push((slot, slot + 1)),
+        });
+    ranges
+}
+
+/// Learns the shard holding each slot from the results of a
+/// [`GearsRemoteKeysTask`] that was sent to all the shards. The shards are
+/// only known if they all answered.
+fn learn_slots_owners(shards_results: &[GearsRemoteFunctionKeysOutputRecord], complete: bool) {
+    let mut slots_owners = SLOTS_OWNERS.lock().unwrap();
+    if !complete {
+        *slots_owners = None;
+        return;
+    }
+    let mut owners = vec![None; SLOTS];
+    shards_results.iter().enumerate().for_each(|(shard, r)| {
+        r.slots.iter().for_each(|(start, end)| {
+            if let Some(owners) = owners.get_mut(*start..*end) {
+                owners.fill(Some(shard as u16));
+            }
+        })
+    });
+    *slots_owners = Some(owners);
+}
+
+/// Groups the keys of the given slots by the shard holding them. Returns
+/// `None` if the shard holding one of the slots is not known.
+fn group_by_shard(slots: &[usize], indexes: &[usize]) -> Option<Vec<Vec<usize>>> {
+    let slots_owners = SLOTS_OWNERS.lock().unwrap();
+    let slots_owners = slots_owners.as_ref()?;
+    let mut groups: HashMap<u16, Vec<usize>> = HashMap::new();
+    for index in indexes {
+        let owner = slots_owners.get(slots[*index]).copied().flatten()?;
+        groups.entry(owner).or_default().push(*index);
+    }
+    Some(groups.into_values().collect())
+}
+
+/// Returns the ranges of the slots held by each shard, if the shard
+/// holding each slot is known. Shards which hold no slots are not included.
+fn shards_slots() -> Option<Vec<Vec<(usize, usize)>>> {
+    let slots_owners = SLOTS_OWNERS.lock().unwrap();
+    let slots_owners = slots_owners.as_ref()?;
+    let mut shards: Vec<Vec<(usize, usize)>> = Vec::new();
+    for (slot, owner) in slots_owners.iter().enumerate() {
+        let owner = match owner {
+            Some(owner) => *owner as usize,
+            None => continue,
+        };
+        if shards.len() <= owner {
+            shards.resize(owner + 1, Vec::new());
+        }
+        let ranges = &mut shards[owner];
+        match ranges.last_mut() {
+            Some((_, end)) if *end == slot => *end += 1,
+            _ => ranges.push((slot, slot + 1)),
+        }
+    }
+    shards.retain(|ranges| !ranges.is_empty());
+    Some(shards)
+}
+
+/// Returns a key of the given slot, used to send a remote task to the
+/// shard holding the slot.
+fn slot_key(slot: usize) -> &'static str {
+    static SLOTS_KEYS: OnceLock<Vec<String>> = OnceLock::new();
+    let slots_keys = SLOTS_KEYS.get_or_init(|| {
+        let mut slots_keys = vec![String::new(); SLOTS];
+        let mut missing = SLOTS;
+        let mut i = 0_usize;
+        while missing > 0 {
+            let key = i.to_string();
+            let key_slot = &mut slots_keys[calc_slot(key.as_bytes())];
+            if key_slot.is_empty() {
+                *key_slot = key;
+                missing -= 1;
+            }
+            i += 1;
+        }
+        slots_keys
+    });
+    &slots_keys[slot]
+}
+
+/// Runs a remote function once for each of the given keys that are
+/// located on the shard, the other keys are skipped.
+#[derive(Clone, Serialize, Deserialize, BaseObject)]
+pub(crate) struct GearsRemoteKeysTask {
+    lib_name: String,
+    job_name: String,
+    user: RedisString,
+}
+
+/// Collects the results of the remote function invocations of a
+/// [`GearsRemoteKeysTask`].
+struct RemoteKeysTaskResults {
+    /// The indexes of the keys of the shard.
+    indexes: Vec<usize>,
+    outputs: Vec<Option<Result<RemoteFunctionData, String>>>,
+    skipped: Vec<usize>,
+    slots: Vec<(usize, usize)>,
+    pending: usize,
+    on_done:
+        Option<Box<dyn FnOnce(Result<GearsRemoteFunctionKeysOutputRecord, RustMRError>) + Send>>,
+}
+
+impl RemoteTask for GearsRemoteKeysTask {
+    type InRecord = GearsRemoteFunctionKeysInputsRecord;
+    type OutRecord = GearsRemoteFunctionKeysOutputRecord;
+
+    fn task(
+        self,
+        r: Self::InRecord,
+        on_done: Box<dyn FnOnce(Result<Self::OutRecord, RustMRError>) + Send>,
+    ) {
+        EXECUTED_REMOTE_TASKS.fetch_add(1, Ordering::Relaxed);
+        let (mine, others): (Vec<_>, Vec<_>) = r
+            .keys
+            .into_iter()
+            .enumerate()
+            .partition(|(i, _)| r.slots.get(*i).map_or(false, |slot| is_my_slot(*slot)));
+        let (indexes, keys): (Vec<_>, Vec<_>) = mine.into_iter().unzip();
+        // a shard only reports the keys it skipped if it was expected to hold them.
+        let (skipped, slots) = if r.to_all_shards {
+            (Vec::new(), my_slots())
+        } else {
+            (others.into_iter().map(|(i, _)| i).collect(), Vec::new())
+        };
+        if keys.is_empty() {
+            on_done(Ok(GearsRemoteFunctionKeysOutputRecord {
+                outputs: Vec::new(),
+                skipped,
+                slots,
+            }));
+            return;
+        }
+        let library = match get_remote_function_library(&self.lib_name, &self.job_name) {
+            Ok(l) => l,
+            Err(e) => {
+                on_done(Err(e));
+                return;
+            }
+        };
+        EXECUTED_REMOTE_KEYS.fetch_add(keys.len() as u64, Ordering::Relaxed);
+        let results = Arc::new(Mutex::new(RemoteKeysTaskResults {
+            outputs: vec![None; keys.len()],
+            pending: keys.len(),
+            indexes,
+            skipped,
+            slots,
+            on_done: Some(on_done),
+        }));
+        let remote_function = &library.gears_lib_ctx.remote_functions[&self.job_name];
+        for (i, key) in keys.into_iter().enumerate() {
+            let inputs = std::iter::once(key)
+                .chain(r.inputs.iter().cloned())
+                .collect();
+            let results = Arc::clone(&results);
+            remote_function(
+                inputs,
+                Box::new(BackgroundRunCtx::new(
+                    self.user.clone(),
+                    &library.gears_lib_ctx.meta_data,
+                    RedisClientCallOptions::new(FunctionFlags::NO_WRITES),
+                )),
+                Box::new(move |result| {
+                    let mut results = results.lock().unwrap();
+                    results.outputs[i] = Some(result.map_err(|e| e.get_msg().to_string()));
+                    results.pending -= 1;
+                    if results.pending > 0 {
+                        return;
+                    }
+                    let outputs = results
+                        .outputs
+                        .drain(..)
+                        .map(Option::unwrap)
+                        .zip(results.indexes.drain(..))
+                        .map(|(output, index)| (index, output))
+                        .collect();
+                    let skipped = std::mem::take(&mut results.skipped);
+                    let slots = std::mem::take(&mut results.slots);
+                    let on_done = results.on_done.take().unwrap();
+                    drop(results);
+                    on_done(Ok(GearsRemoteFunctionKeysOutputRecord {
+                        outputs,
+                        skipped,
+                        slots,
+                    }));
+                }),
+            );
+        }
+    }
+}
+
+/// The error given by a [`GearsRemoteShardTask`] which was sent to a shard
+/// that does not hold the expected slots.
+const SLOTS_CHANGED_ERROR: &str =
+    "The slots of the shard changed while the remote function was sent";
+
+#[derive(Clone, Serialize, Deserialize, BaseObject)]
+pub(crate) struct GearsRemoteFunctionShardInputsRecord {
+    /// The ranges of the slots the shard is expected to hold.
+    slots: Vec<(usize, usize)>,
+    inputs: Vec<RemoteFunctionData>,
+}
+
+impl Record for GearsRemoteFunctionShardInputsRecord {
+    fn to_redis_value(&mut self) -> RedisValue {
+        RedisValue::Array(
+            self.inputs
+                .iter()
+                .map(|v| RedisValue::StringBuffer(v.as_bytes().to_vec()))
+                .collect(),
+        )
+    }
+
+    fn hash_slot(&self) -> usize {
+        1 // not relevant here
+    }
+}
+
+/// Runs a remote function on a single shard, which is sent the task with
+/// a key of one of its slots. The shard only runs the remote function if
+/// it holds exactly the expected slots, so a shard never runs it twice
+/// when the slots move between the shards.
+#[derive(Clone, Serialize, Deserialize, BaseObject)]
+pub(crate) struct GearsRemoteShardTask {
+    lib_name: String,
+    job_name: String,
+    user: RedisString,
+}
+
+impl RemoteTask for GearsRemoteShardTask {
+    type InRecord = GearsRemoteFunctionShardInputsRecord;
+    type OutRecord = GearsRemoteFunctionOutputRecord;
+
+    fn task(
+        self,
+        r: Self::InRecord,
+        on_done: Box<dyn FnOnce(Result<Self::OutRecord, RustMRError>) + Send>,
+    ) {
+        if my_slots() != r.slots {
+            on_done(Err(SLOTS_CHANGED_ERROR.to_string()));
+            return;
+        }
+        let task = GearsRemoteTask {
+            lib_name: self.lib_name,
+            job_name: self.job_name,
+            user: self.user,
+        };
+        task.task(
+            GearsRemoteFunctionInputsRecord { inputs: r.inputs },
+            on_done,
+        );
+    }
+}
+
+type OnShardResult = Box<dyn FnMut(Result<RemoteFunctionData, GearsApiError>)>;
+
+/// The state of a [`BackgroundRunCtx::run_on_each_shard`] invocation,
+/// shared by the remote tasks it sent.
+struct RunOnEachShardCtx {
+    pending_tasks: usize,
+    on_result: OnShardResult,
+    on_done: Option<Box<dyn FnOnce()>>,
+}
+
+impl RunOnEachShardCtx {
+    /// Gives the result of a shard to `on_result`, and calls `on_done`
+    /// after the last shard.
+    fn on_shard_done(
+        ctx: &Rc<RefCell<RunOnEachShardCtx>>,
+        result: Result<RemoteFunctionData, GearsApiError>,
+    ) {
+        let on_done = {
+            let mut c = ctx.borrow_mut();
+            (c.on_result)(result);
+            c.pending_tasks -= 1;
+            if c.pending_tasks > 0 {
+                return;
+            }
+            c.on_done.take().unwrap()
+        };
+        on_done();
+    }
+}
+
+/// Sends the remote function to each of the given shards, identified by
+/// the ranges of their slots, with a key of its first slot.
+fn send_to_each_shard(
+    task: GearsRemoteShardTask,
+    inputs: Vec<RemoteFunctionData>,
+    shards: Vec<Vec<(usize, usize)>>,
+    timeout_ms: usize,
+    on_result: OnShardResult,
+    on_done: Box<dyn FnOnce()>,
+) {
+    if shards.is_empty() {
+        on_done();
+        return;
+    }
+    let ctx = Rc::new(RefCell::new(RunOnEachShardCtx {
+        pending_tasks: shards.len(),
+        on_result,
+        on_done: Some(on_done),
+    }));
+    for slots in shards {
+        let key = slot_key(slots[0].0);
+        let input_record = GearsRemoteFunctionShardInputsRecord {
+            slots,
+            inputs: inputs.clone(),
+        };
+        let ctx = Rc::clone(&ctx);
+        mr::libmr::remote_task::run_on_key(
+            key.as_bytes(),
+            task.clone(),
+            input_record,
+            move |result: Result<GearsRemoteFunctionOutputRecord, RustMRError>| {
+                if matches!(&result, Err(e) if e == SLOTS_CHANGED_ERROR) {
+                    // relearned by the next invocation.
+                    *SLOTS_OWNERS.lock().unwrap() = None;
+                }
+                RunOnEachShardCtx::on_shard_done(
+                    &ctx,
+                    result.map(|r| r.output).map_err(GearsApiError::new),
+                );
+            },
+            timeout_ms,
+        );
+    }
+}
+
+type RunOnKeysResults = Vec<Result<RemoteFunctionData, GearsApiError>>;
+
+/// The state of a [`BackgroundRunCtx::run_on_keys`] invocation, shared by
+/// the remote tasks it sent.
+struct RunOnKeysCtx {
+    task: GearsRemoteKeysTask,
+    /// The name and the data of each key.
+    keys: Vec<(Vec<u8>, RemoteFunctionData)>,
+    slots: Vec<usize>,
+    inputs: Vec<RemoteFunctionData>,
+    results: Vec<Option<Result<RemoteFunctionData, GearsApiError>>>,
+    /// Keys that were sent to a shard which does not hold them.
+    misrouted: Vec<usize>,
+    pending_tasks: usize,
+    on_done: Option<Box<dyn FnOnce(RunOnKeysResults)>>,
+}
+
+impl RunOnKeysCtx {
+    fn input_record(
+        &self,
+        indexes: &[usize],
+        to_all_shards: bool,
+    ) -> GearsRemoteFunctionKeysInputsRecord {
+        GearsRemoteFunctionKeysInputsRecord {
+            slots: indexes.iter().map(|i| self.slots[*i]).collect(),
+            keys: indexes.iter().map(|i| self.keys[*i].1.clone()).collect(),
+            inputs: self.inputs.clone(),
+            to_all_shards,
+        }
+    }
+
+    /// Sets the results of the given keys from the results of a remote task.
+    fn set_results(&mut self, indexes: &[usize], record: GearsRemoteFunctionKeysOutputRecord) {
+        record.outputs.into_iter().for_each(|(i, output)| {
+            if let Some(res @ None) = indexes.get(i).and_then(|i| self.results.get_mut(*i)) {
+                *res = Some(output.map_err(GearsApiError::new));
+            }
+        });
+        self.misrouted
+            .extend(record.skipped.into_iter().filter_map(|i| indexes.get(i)));
+    }
+
+    /// Sets the given error to the given keys which do not have a result.
+    fn set_error(&mut self, indexes: &[usize], error: &GearsApiError) {
+        indexes.iter().for_each(|i| {
+            if let Some(res @ None) = self.results.get_mut(*i) {
+                *res = Some(Err(error.clone()));
+            }
+        });
+    }
+}
+
+/// Sends the given keys to the shards that hold them, or to all the shards
+/// if one of them is not known.
+fn send_keys(ctx: &Rc<RefCell<RunOnKeysCtx>>, indexes: Vec<usize>) {
+    let groups = group_by_shard(&ctx.borrow().slots, &indexes);
+    let groups = match groups {
+        Some(groups) => groups,
+        None => {
+            send_keys_to_all_shards(ctx, indexes);
+            return;
+        }
+    };
+    // counted as a pending task until all the tasks were sent, in case
+    // a task is done before the next one is sent.
+    ctx.borrow_mut().pending_tasks += 1;
+    groups
+        .into_iter()
+        .for_each(|group| send_keys_to_shard(ctx, group));
+    on_task_done(ctx);
+}
+
+/// Sends the given keys, which are expected to be held by a single shard,
+/// to the shard holding the first of them.
+fn send_keys_to_shard(ctx: &Rc<RefCell<RunOnKeysCtx>>, indexes: Vec<usize>) {
+    let (key, task, input_record) = {
+        let mut c = ctx.borrow_mut();
+        c.pending_tasks += 1;
+        (
+            c.keys[indexes[0]].0.clone(),
+            c.task.clone(),
+            c.input_record(&indexes, false),
+        )
+    };
+    let ctx = Rc::clone(ctx);
+    mr::libmr::remote_task::run_on_key(
+        &key,
+        task,
+        input_record,
+        move |result: Result<GearsRemoteFunctionKeysOutputRecord, RustMRError>| {
+            {
+                let mut c = ctx.borrow_mut();
+                match result {
+                    Ok(r) => c.set_results(&indexes, r),
+                    Err(e) => c.set_error(&indexes, &GearsApiError::new(e)),
+                }
+            }
+            on_task_done(&ctx);
+        },
+        REMOTE_TASK_DEFAULT_TIMEOUT.load(Ordering::Relaxed) as usize,
+    );
+}
+
+/// Sends the given keys to all the shards, each shard runs the remote
+/// function on the keys it holds and reports its slots.
+fn send_keys_to_all_shards(ctx: &Rc<RefCell<RunOnKeysCtx>>, indexes: Vec<usize>) {
+    let (task, input_record) = {
+        let mut c = ctx.borrow_mut();
+        c.pending_tasks += 1;
+        (c.task.clone(), c.input_record(&indexes, true))
+    };
+    let ctx = Rc::clone(ctx);
+    mr::libmr::remote_task::run_on_all_shards(
+        task,
+        input_record,
+        move |shards_results: Vec<GearsRemoteFunctionKeysOutputRecord>, errors| {
+            learn_slots_owners(&shards_results, errors.is_empty());
+            {
+                let mut c = ctx.borrow_mut();
+                shards_results
+                    .into_iter()
+                    .for_each(|r| c.set_results(&indexes, r));
+                // A key without a result was held by a shard that failed,
+                // or by no shard while its slot was migrating.
+                let missing_key_error = errors.into_iter().next().map_or_else(
+                    || GearsApiError::new("No shard holds the key"),
+                    GearsApiError::new,
+                );
+                c.set_error(&indexes, &missing_key_error);
+            }
+            on_task_done(&ctx);
+        },
+        REMOTE_TASK_DEFAULT_TIMEOUT.load(Ordering::Relaxed) as usize,
+    );
+}
+
+/// Called once a remote task is done. Once all the tasks are done, the keys
+/// that were sent to a shard which does not hold them are sent to all the
+/// shards, otherwise the results are returned.
+fn on_task_done(ctx: &Rc<RefCell<RunOnKeysCtx>>) {
+    let misrouted = {
+        let mut c = ctx.borrow_mut();
+        c.pending_tasks -= 1;
+        if c.pending_tasks > 0 {
+            return;
+        }
+        std::mem::take(&mut c.misrouted)
+    };
+    if !misrouted.is_empty() {
+        // the slots owners changed since they were learned.
+        *SLOTS_OWNERS.lock().unwrap() = None;
+        send_keys_to_all_shards(ctx, misrouted);
+        return;
+    }
+    let (results, on_done) = {
+        let mut c = ctx.borrow_mut();
+        (std::mem::take(&mut c.results), c.on_done.take().unwrap())
+    };
+    on_done(
+        results
+            .into_iter()
+            .map(|res| res.unwrap_or_else(|| Err(GearsApiError::new("No shard holds the key"))))
+            .collect(),
+    );
+}
+
 impl BackgroundRunFunctionCtxInterface for BackgroundRunCtx {
     fn lock(&self) -> Result<Box<dyn RedisClientCtxInterface>, GearsApiError> {
-        let detached_ctx_guard = redis_module::MODULE_CONTEXT.lock();
+        let detached_ctx_guard = lock_redis_for_background();
         if !verify_ok_on_replica(&detached_ctx_guard, self.call_options.flags) {
             return Err(GearsApiError::new(
                 "Can not lock redis for write on replica or when the \"avoid replication traffic\" option is enabled".to_string(),
@@ -229,4 +831,108 @@ impl BackgroundRunFunctionCtxInterface for BackgroundRunCtx {
             REMOTE_TASK_DEFAULT_TIMEOUT.load(Ordering::Relaxed) as usize,
         )
     }
+
+    fn run_on_keys(
+        &self,
+        keys: Vec<(Vec<u8>, RemoteFunctionData)>,
+        job_name: &str,
+        inputs: Vec<RemoteFunctionData>,
+        on_done: Box<dyn FnOnce(Vec<Result<RemoteFunctionData, GearsApiError>>)>,
+    ) {
+        if keys.is_empty() {
+            on_done(Vec::new());
+            return;
+        }
+
+        // The keys are grouped by the shard holding them and each of those
+        // shards gets a single task with its own keys. Until the shards
+        // holding the slots are known, the keys are sent to all the shards,
+        // which report their slots.
+        let ctx = Rc::new(RefCell::new(RunOnKeysCtx {
+            task: GearsRemoteKeysTask {
+                lib_name: self.lib_meta_data.name.clone(),
+                job_name: job_name.to_string(),
+                user: self.user.clone(),
+            },
+            slots: keys.iter().map(|(key, _)| calc_slot(key)).collect(),
+            results: (0..keys.len()).map(|_| None).collect(),
+            keys,
+            inputs,
+            misrouted: Vec::new(),
+            pending_tasks: 0,
+            on_done: Some(on_done),
+        }));
+        let indexes = (0..ctx.borrow().keys.len()).collect();
+        send_keys(&ctx, indexes);
+    }
+
+    fn run_on_each_shard(
+        &self,
+        job_name: &str,
+        inputs: Vec<RemoteFunctionData>,
+        timeout_ms: Option<usize>,
+        mut on_result: Box<dyn FnMut(Result<RemoteFunctionData, GearsApiError>)>,
+        on_done: Box<dyn FnOnce()>,
+    ) {
+        let timeout_ms =
+            timeout_ms.unwrap_or(REMOTE_TASK_DEFAULT_TIMEOUT.load(Ordering::Relaxed) as usize);
+        let task = GearsRemoteShardTask {
+            lib_name: self.lib_meta_data.name.clone(),
+            job_name: job_name.to_string(),
+            user: self.user.clone(),
+        };
+        if let Some(shards) = shards_slots() {
+            send_to_each_shard(task, inputs, shards, timeout_ms, on_result, on_done);
+            return;
+        }
+
+        // The shards are identified by their slots, learn them first with
+        // a task that only reports the slots of each shard.
+        let started = Instant::now();
+        let slots_task = GearsRemoteKeysTask {
+            lib_name: self.lib_meta_data.name.clone(),
+            job_name: job_name.to_string(),
+            user: self.user.clone(),
+        };
+        let slots_record = GearsRemoteFunctionKeysInputsRecord {
+            slots: Vec::new(),
+            keys: Vec::new(),
+            inputs: Vec::new(),
+            to_all_shards: true,
+        };
+        mr::libmr::remote_task::run_on_all_shards(
+            slots_task,
+            slots_record,
+            move |shards_results: Vec<GearsRemoteFunctionKeysOutputRecord>, errors| {
+                learn_slots_owners(&shards_results, errors.is_empty());
+                let timeout_ms = timeout_ms
+                    .saturating_sub(started.elapsed().as_millis() as usize)
+                    .max(1);
+                if let Some(shards) = shards_slots() {
+                    send_to_each_shard(task, inputs, shards, timeout_ms, on_result, on_done);
+                    return;
+                }
+                // Not all the shards reported their slots, fall back to
+                // collecting the results of all the shards.
+                let task = GearsRemoteTask {
+                    lib_name: task.lib_name,
+                    job_name: task.job_name,
+                    user: task.user,
+                };
+                mr::libmr::remote_task::run_on_all_shards(
+                    task,
+                    GearsRemoteFunctionInputsRecord { inputs },
+                    move |results: Vec<GearsRemoteFunctionOutputRecord>, errors| {
+                        results.into_iter().for_each(|r| on_result(Ok(r.output)));
+                        errors
+                            .into_iter()
+                            .for_each(|e| on_result(Err(GearsApiError::new(e))));
+                        on_done();
+                    },
+                    timeout_ms,
+                );
+            },
+            timeout_ms,
+        );
+    }
 }
@@ -15,12 +15,13 @@ use redisgears_plugin_api::redisgears_plugin_api::{
     GearsApiError,
 };
 
-use crate::call_redis_command_async;
+use crate::lock_broker::LockLease;
 use crate::run_ctx::RedisClientCallOptions;
 use crate::{
     background_run_ctx::BackgroundRunCtx, call_redis_command, get_notification_blocker,
     GearsLibraryMetaData, NotificationBlocker,
 };
+use crate::{call_redis_command_async, call_redis_commands_batch};
 
 use std::sync::Arc;
 
@@ -29,7 +30,9 @@ use redisai_rs::redisai::redisai_script::RedisAIScript;
 
 pub(crate) struct BackgroundRunScopeGuardCtx {
     _notification_blocker: NotificationBlocker,
-    pub(crate) detached_ctx_guard: DetachedContextGuard,
+    /// Holds the Redis lock, possibly as part of a batch of background
+    /// jobs, see [`crate::lock_broker`].
+    pub(crate) detached_ctx_guard: LockLease<DetachedContextGuard>,
     call_options: RedisClientCallOptions,
     user: RedisString,
     lib_meta_data: Arc<GearsLibraryMetaData>,
@@ -40,7 +43,7 @@ unsafe impl Send for BackgroundRunScopeGuardCtx {}
 
 impl BackgroundRunScopeGuardCtx {
     pub(crate) fn new(
-        ctx_guard: DetachedContextGuard,
+        ctx_guard: LockLease<DetachedContextGuard>,
         user: RedisString,
         lib_meta_data: &Arc<GearsLibraryMetaData>,
         call_options: RedisClientCallOptions,
@@ -66,6 +69,15 @@ impl RedisClientCtxInterface for BackgroundRunScopeGuardCtx {
         )
     }
 
+    fn call_batch(&self, commands: &[(&str, Vec<&[u8]>)]) -> Vec<CallResult> {
+        call_redis_commands_batch(
+            &self.detached_ctx_guard,
+            &self.user,
+            &self.call_options.call_options,
+            commands,
+        )
+    }
+
     fn call_async(&self, command: &str, args: &[&[u8]]) -> PromiseReply<'static, '_> {
         call_redis_command_async(
             &self.detached_ctx_guard,
@@ -0,0 +1,269 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Drivers for the core hot paths, used by the criterion benchmarks
+//! under `benches/` to measure them without a Redis server. Only
+//! compiled with the `bench` feature.
+//!
+//! The measured paths only pass the Redis context on to the stream
+//! reader, trimmer and consumer callbacks, which are all mocked here,
+//! so the null context given to them is never used.
+
+use redis_module::raw::RedisModuleStreamID;
+use redis_module::Context;
+use redisgears_plugin_api::redisgears_plugin_api::stream_ctx::{
+    StreamAdaptiveWindowConfig, StreamBatchConfig,
+};
+
+use crate::invocation_stats::LatencyHistogram;
+use crate::keys_notifications::{KeysNotificationsCtx, NotificationCallback, NotificationConsumer};
+use crate::pending_ids::{PendingIdToken, PendingIds};
+use crate::stream_reader::{
+    AcknowledgeCallback, ConsumerData, ConsumerInfo, StreamConsumer, StreamReaderAck,
+    StreamReaderCtx, StreamReaderRecord,
+};
+use crate::RefCellWrapper;
+
+use std::cell::RefCell;
+use std::collections::LinkedList;
+use std::sync::Arc;
+use std::time::Instant;
+
+const STREAM_NAME: &[u8] = b"bench:stream";
+const MATCHED_PREFIX: &[u8] = b"bench:";
+const TOUCHED_KEY: &[u8] = b"bench:key";
+
+fn dummy_ctx() -> Context {
+    Context::new(std::ptr::null_mut())
+}
+
+struct BenchRecord {
+    id: RedisModuleStreamID,
+}
+
+impl StreamReaderRecord for BenchRecord {
+    fn get_id(&self) -> RedisModuleStreamID {
+        self.id
+    }
+}
+
+/// A consumer which acknowledges the records as soon as they arrive.
+struct BenchConsumer {
+    batch: Option<StreamBatchConfig>,
+}
+
+impl StreamConsumer<BenchRecord> for BenchConsumer {
+    fn new_data(
+        &self,
+        _ctx: &Context,
+        _stream_name: &[u8],
+        _record: BenchRecord,
+        _ack_callback: Box<AcknowledgeCallback>,
+    ) -> Option<StreamReaderAck> {
+        Some(StreamReaderAck::Ack)
+    }
+
+    fn new_data_batch(
+        &self,
+        _ctx: &Context,
+        _stream_name: &[u8],
+        _records: Vec<BenchRecord>,
+        _ack_callback: Box<AcknowledgeCallback>,
+    ) -> Option<StreamReaderAck> {
+        Some(StreamReaderAck::Ack)
+    }
+
+    fn batch_config(&self) -> Option<StreamBatchConfig> {
+        self.batch
+    }
+
+    fn adaptive_window_config(&self) -> Option<StreamAdaptiveWindowConfig> {
+        None
+    }
+}
+
+/// Drives [`StreamReaderCtx::on_stream_touched`] on a stream of
+/// `stream_len` records which is read by `consumers` consumers.
+pub struct StreamReaderBench {
+    reader: StreamReaderCtx<BenchRecord, BenchConsumer>,
+    consumers: Vec<Arc<RefCellWrapper<ConsumerData<BenchRecord, BenchConsumer>>>>,
+}
+
+impl StreamReaderBench {
+    pub fn new(consumers: usize, stream_len: u64, batch_size: Option<usize>) -> StreamReaderBench {
+        let mut reader = StreamReaderCtx::new(
+            Box::new(move |_ctx, _name, id, _include_id| {
+                let seq = id.map_or(0, |id| id.seq + 1);
+                Ok((seq < stream_len).then_some(BenchRecord {
+                    id: RedisModuleStreamID { ms: 0, seq },
+                }))
+            }),
+            Box::new(|_ctx, _name, _id| {}),
+        );
+        let batch = batch_size.map(|batch_size| StreamBatchConfig {
+            batch_size,
+            max_batch_delay: 0,
+        });
+        let consumers = (0..consumers)
+            .map(|_| {
+                reader.add_consumer(MATCHED_PREFIX, BenchConsumer { batch }, 1, true, None, None)
+            })
+            .collect();
+        StreamReaderBench { reader, consumers }
+    }
+
+    /// Rewinds all the consumers to the start of the stream, delivers
+    /// the entire stream to each of them and trims it, like the cron does.
+    pub fn touch(&mut self) {
+        let reader = &mut self.reader;
+        reader.clear_tracked_streams();
+        self.consumers
+            .iter()
+            .for_each(|c| c.ref_cell.borrow_mut().clear_streams_info());
+        let ctx = dummy_ctx();
+        reader.on_stream_touched(&ctx, "xadd", STREAM_NAME);
+        reader.trim_pending_streams(&ctx);
+    }
+}
+
+/// Drives [`KeysNotificationsCtx::on_key_touched`] with `matched`
+/// consumers that match the touched key, out of `consumers` consumers
+/// registered on distinct keys and prefixes.
+pub struct KeysNotificationsBench {
+    ctx: KeysNotificationsCtx,
+    _consumers: Vec<Arc<RefCell<NotificationConsumer>>>,
+}
+
+impl KeysNotificationsBench {
+    pub fn new(consumers: usize, matched: usize) -> KeysNotificationsBench {
+        let mut ctx = KeysNotificationsCtx::new();
+        let consumers = (0..consumers)
+            .map(|i| {
+                let callback: NotificationCallback =
+                    Box::new(|_ctx, _event, _key, ack| ack(Ok(())));
+                if i < matched {
+                    ctx.add_consumer_on_prefix(MATCHED_PREFIX, callback, None)
+                } else if i % 2 == 0 {
+                    ctx.add_consumer_on_key(format!("key:{i}").as_bytes(), callback, None)
+                } else {
+                    ctx.add_consumer_on_prefix(format!("prefix:{i}:").as_bytes(), callback, None)
+                }
+            })
+            .collect();
+        KeysNotificationsBench {
+            ctx,
+            _consumers: consumers,
+        }
+    }
+
+    pub fn touch(&self) {
+        self.ctx.on_key_touched(&dummy_ctx(), "set", TOUCHED_KEY);
+    }
+}
+
+/// Drives [`ConsumerInfo::ack_id`] by sending a window of records to a
+/// consumer and acknowledging them.
+pub struct PendingAckBench {
+    consumer_info: ConsumerInfo,
+    window: u64,
+    next_seq: u64,
+}
+
+impl PendingAckBench {
+    pub fn new(window: u64) -> PendingAckBench {
+        PendingAckBench {
+            consumer_info: ConsumerInfo {
+                last_processed_time: 0,
+                total_processed_time: 0,
+                last_lag: 0,
+                total_lag: 0,
+                records_processed: 0,
+                pending_ids: PendingIds::new(),
+                in_flight: 0,
+                last_error: None,
+                last_read_id: None,
+                batch_pending_since: None,
+                records_failed: 0,
+                latency: Arc::new(LatencyHistogram::new()),
+                adaptive_window: None,
+            },
+            window,
+            next_seq: 0,
+        }
+    }
+
+    /// Acknowledges a window of records, in the order they were sent
+    /// or in the reverse order.
+    pub fn run(&mut self, reverse: bool) {
+        let start_time = Instant::now();
+        let ids = (0..self.window)
+            .map(|_| {
+                let id = RedisModuleStreamID {
+                    ms: 0,
+                    seq: self.next_seq,
+                };
+                self.next_seq += 1;
+                (id, self.consumer_info.pending_ids.push(id))
+            })
+            .collect::<Vec<_>>();
+        let mut ack = |(id, token): (RedisModuleStreamID, PendingIdToken)| {
+            self.consumer_info.ack_id(id, token, start_time);
+        };
+        if reverse {
+            ids.into_iter().rev().for_each(&mut ack);
+        } else {
+            ids.into_iter().for_each(&mut ack);
+        }
+    }
+}
+
+/// The same as [`PendingAckBench`] on the linked list that was used to
+/// track the pending ids before [`PendingIds`], as a baseline.
+pub struct LinkedListAckBench {
+    pending_ids: LinkedList<RedisModuleStreamID>,
+    window: u64,
+    next_seq: u64,
+}
+
+impl LinkedListAckBench {
+    pub fn new(window: u64) -> LinkedListAckBench {
+        LinkedListAckBench {
+            pending_ids: LinkedList::new(),
+            window,
+            next_seq: 0,
+        }
+    }
+
+    fn ack(&mut self, id: RedisModuleStreamID) {
+        let mut temp_list = LinkedList::new();
+        while let Some(curr) = self.pending_ids.pop_front() {
+            if curr.ms == id.ms && curr.seq == id.seq {
+                break;
+            }
+            temp_list.push_back(curr);
+        }
+        self.pending_ids.append(&mut temp_list);
+    }
+
+    pub fn run(&mut self, reverse: bool) {
+        let ids = (0..self.window)
+            .map(|_| {
+                let id = RedisModuleStreamID {
+                    ms: 0,
+                    seq: self.next_seq,
+                };
+                self.next_seq += 1;
+                self.pending_ids.push_back(id);
+                id
+            })
+            .collect::<Vec<_>>();
+        if reverse {
+            ids.into_iter().rev().for_each(|id| self.ack(id));
+        } else {
+            ids.into_iter().for_each(|id| self.ack(id));
+        }
+    }
+}
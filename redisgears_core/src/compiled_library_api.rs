@@ -6,59 +6,77 @@
 
 use crate::execute_on_pool;
 use redisai_rs::redisai::redisai_tensor::RedisAITensor;
-use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::CompiledLibraryInterface;
+use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::{
+    CompiledLibraryInterface, JobPriority,
+};
 use redisgears_plugin_api::redisgears_plugin_api::redisai_interface::AITensorInterface;
 use redisgears_plugin_api::redisgears_plugin_api::GearsApiError;
 use std::collections::LinkedList;
 use std::sync::{Arc, Mutex, TryLockError};
 
+type Job = Box<dyn FnOnce() + Send>;
+
 pub(crate) struct CompiledLibraryInternals {
-    jobs: Mutex<LinkedList<Box<dyn FnOnce() + Send>>>,
+    /// The jobs of the queue, each submitted to the executor with the
+    /// priority of the job itself.
+    jobs: Mutex<LinkedList<(JobPriority, Job)>>,
+    /// Additional jobs queues of the library which are processed
+    /// in parallel to this one.
+    background_queues: Mutex<Vec<Arc<CompiledLibraryInternals>>>,
 }
 
 impl CompiledLibraryInternals {
     fn new() -> CompiledLibraryInternals {
         CompiledLibraryInternals {
             jobs: Mutex::new(LinkedList::new()),
+            background_queues: Mutex::new(Vec::new()),
         }
     }
 
     fn run_next_job(internals: &Arc<CompiledLibraryInternals>) {
-        let (job, jobs_left) = {
+        let (job, next_priority) = {
             let mut queue = internals.jobs.lock().unwrap();
             let job = queue.pop_back();
             match job {
-                Some(j) => (j, queue.len()),
+                Some((_, j)) => (j, queue.back().map(|(priority, _)| *priority)),
                 None => return,
             }
         };
         job();
-        if jobs_left > 0 {
-            let internals_ref = Arc::clone(internals);
-            execute_on_pool(move || {
-                Self::run_next_job(&internals_ref);
-            });
+        if let Some(priority) = next_priority {
+            Self::submit(internals, priority);
         }
     }
 
-    fn add_job(internals: &Arc<CompiledLibraryInternals>, job: Box<dyn FnOnce() + Send>) {
+    fn add_job(internals: &Arc<CompiledLibraryInternals>, job: Job, priority: JobPriority) {
         let pending_jobs = {
             let mut queue = internals.jobs.lock().unwrap();
             let pending_jobs = queue.len();
-            queue.push_front(job);
+            queue.push_front((priority, job));
             pending_jobs
         };
         if pending_jobs == 0 {
-            let internals_ref = Arc::clone(internals);
-            execute_on_pool(move || {
-                Self::run_next_job(&internals_ref);
-            });
+            Self::submit(internals, priority);
         }
     }
 
+    fn submit(internals: &Arc<CompiledLibraryInternals>, priority: JobPriority) {
+        let internals_ref = Arc::clone(internals);
+        execute_on_pool(
+            move || {
+                Self::run_next_job(&internals_ref);
+            },
+            priority,
+        );
+    }
+
     pub(crate) fn pending_jobs(&self) -> usize {
-        let queue = self.jobs.lock().unwrap();
-        queue.len()
+        let pending_jobs = self.jobs.lock().unwrap().len();
+        self.background_queues
+            .lock()
+            .unwrap()
+            .iter()
+            .fold(pending_jobs, |agg, v| agg + v.pending_jobs())
     }
 }
 
@@ -67,7 +85,7 @@ impl std::fmt::Debug for CompiledLibraryInternals {
         let jobs = match self.jobs.try_lock() {
             Ok(guard) => guard
                 .iter()
-                .map(|e| format!("{e:p}"))
+                .map(|(_, e)| format!("{e:p}"))
                 .collect::<Vec<String>>()
                 .join(", "),
             Err(TryLockError::Poisoned(err)) => err.to_string(),
@@ -75,6 +93,7 @@ impl std::fmt::Debug for CompiledLibraryInternals {
         };
         f.debug_struct("CompiledLibraryInternals")
             .field("jobs", &jobs)
+            .field("background_queues", &self.background_queues)
             .finish()
     }
 }
@@ -92,8 +111,8 @@ impl CompiledLibraryAPI {
         }
     }
 
-    fn add_job(&self, job: Box<dyn FnOnce() + Send>) {
-        CompiledLibraryInternals::add_job(&self.internals, job);
+    fn add_job(&self, job: Box<dyn FnOnce() + Send>, priority: JobPriority) {
+        CompiledLibraryInternals::add_job(&self.internals, job, priority);
     }
 
     pub(crate) fn take_internals(&self) -> Arc<CompiledLibraryInternals> {
@@ -131,7 +150,25 @@ impl CompiledLibraryInterface for CompiledLibraryAPI {
     }
 
     fn run_on_background(&self, job: Box<dyn FnOnce() + Send>) {
-        self.add_job(job);
+        self.add_job(job, JobPriority::High);
+    }
+
+    fn run_on_background_with_priority(
+        &self,
+        job: Box<dyn FnOnce() + Send>,
+        priority: JobPriority,
+    ) {
+        self.add_job(job, priority);
+    }
+
+    fn new_background_queue(&self) -> Box<dyn CompiledLibraryInterface + Send + Sync> {
+        let queue = CompiledLibraryAPI::new(self.log_scirpt_msg_for_debug);
+        self.internals
+            .background_queues
+            .lock()
+            .unwrap()
+            .push(queue.take_internals());
+        Box::new(queue)
     }
 
     fn redisai_create_tensor(
@@ -100,6 +100,10 @@ lazy_static! {
     /// Configuration value indicates the timeout for remote tasks that runs on a remote shard.
     pub(crate) static ref REMOTE_TASK_DEFAULT_TIMEOUT: AtomicI64 = AtomicI64::default();
 
+    /// Configuration value indicates the max amount of acknowledgements after
+    /// which a stream consumer progress is replicated, regardless of the cron.
+    pub(crate) static ref STREAM_CHECKPOINT_MAX_ACKS: AtomicI64 = AtomicI64::default();
+
     /// Configuration value indicates the timeout for locking Redis (except
     /// for the loading from RDB. For that, see the [`DB_LOADING_LOCK_REDIS_TIMEOUT`]).
     pub(crate) static ref LOCK_REDIS_TIMEOUT: LoadLockTimeout = LoadLockTimeout::default();
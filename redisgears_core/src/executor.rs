@@ -0,0 +1,426 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! A work stealing executor used to run the libraries background jobs.
+//!
+//! Each worker thread owns a local queue per priority. Jobs submitted
+//! from a worker thread (usually the next job of the library it just
+//! ran) are pushed to its local queue, jobs submitted from any other
+//! thread (usually the Redis main thread) are pushed to a global queue.
+//! A worker looks for a job on its local queue, then on the global queue
+//! and then steals from the other workers. All the queues are lock free,
+//! so a submission never waits for a worker which takes a job.
+//!
+//! [`JobPriority::High`] jobs are preferred over [`JobPriority::Low`]
+//! jobs, but every [`LOW_PRIORITY_INTERVAL`] jobs a worker prefers the
+//! low priority jobs so they are never starved.
+//!
+//! Fairness between the libraries comes from the libraries jobs queues,
+//! each queue has at most one job on the executor at any given time and
+//! re-submits itself after running a single job, so the libraries are
+//! served in a round robin manner.
+//!
+//! A job which panics is counted and the worker moves on to the next job.
+
+use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::JobPriority;
+
+use crossbeam_deque::{Injector, Steal, Stealer, Worker};
+
+use std::cell::Cell;
+use std::panic::AssertUnwindSafe;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::time::Instant;
+
+/// Every this amount of jobs, a worker prefers low priority jobs.
+const LOW_PRIORITY_INTERVAL: usize = 8;
+
+/// Every this amount of jobs, a worker checks the global queue before
+/// its local queue, so the global queue is not starved by a worker which
+/// keeps submitting jobs to itself.
+const GLOBAL_QUEUE_INTERVAL: usize = 31;
+
+type Job = Box<dyn FnOnce() + Send>;
+
+struct Task {
+    job: Job,
+    submitted_at: Instant,
+}
+
+/// Jobs queues indexed by [`lane`].
+type Queues<Q> = [Q; 2];
+
+fn lane(priority: JobPriority) -> usize {
+    match priority {
+        JobPriority::High => 0,
+        JobPriority::Low => 1,
+    }
+}
+
+/// The counters of the jobs of a single priority.
+#[derive(Default)]
+struct LaneCounters {
+    pending_jobs: AtomicUsize,
+    executed_jobs: AtomicU64,
+    total_wait_time_us: AtomicU64,
+    max_wait_time_us: AtomicU64,
+}
+
+impl LaneCounters {
+    fn stats(&self) -> JobsStats {
+        JobsStats {
+            pending_jobs: self.pending_jobs.load(Ordering::Relaxed),
+            executed_jobs: self.executed_jobs.load(Ordering::Relaxed),
+            total_wait_time_us: self.total_wait_time_us.load(Ordering::Relaxed),
+            max_wait_time_us: self.max_wait_time_us.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// Statistics of the jobs of a single priority.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub(crate) struct JobsStats {
+    /// Jobs which were submitted and did not yet start running.
+    pub(crate) pending_jobs: usize,
+    pub(crate) executed_jobs: u64,
+    /// The total time the executed jobs waited before they started running.
+    pub(crate) total_wait_time_us: u64,
+    pub(crate) max_wait_time_us: u64,
+}
+
+impl JobsStats {
+    pub(crate) fn avg_wait_time_us(&self) -> u64 {
+        self.total_wait_time_us
+            .checked_div(self.executed_jobs)
+            .unwrap_or(0)
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) struct ExecutorStats {
+    pub(crate) threads: usize,
+    /// Jobs which were taken from the local queue of another worker.
+    pub(crate) stolen_jobs: u64,
+    /// Jobs which panicked, the worker keeps running after a panic.
+    pub(crate) panicked_jobs: u64,
+    pub(crate) high_priority: JobsStats,
+    pub(crate) low_priority: JobsStats,
+}
+
+struct Shared {
+    /// Steal the jobs from the local queues of the workers.
+    workers: Vec<Queues<Stealer<Task>>>,
+    global: Queues<Injector<Task>>,
+    lanes: [LaneCounters; 2],
+    stolen_jobs: AtomicU64,
+    panicked_jobs: AtomicU64,
+    idle_workers: AtomicUsize,
+    sleep_lock: Mutex<()>,
+    wakeup: Condvar,
+}
+
+thread_local! {
+    /// The executor and the local queues of the worker running on the current thread.
+    static CURRENT_WORKER: Cell<Option<(*const Shared, *const Queues<Worker<Task>>)>> =
+        Cell::new(None);
+}
+
+/// Retries the steal until it either gets a job or finds the queue empty.
+fn steal_task(mut steal: impl FnMut() -> Steal<Task>) -> Option<Task> {
+    std::iter::repeat_with(|| steal())
+        .find(|res| !res.is_retry())
+        .and_then(Steal::success)
+}
+
+impl Shared {
+    fn pending_jobs(&self) -> usize {
+        self.lanes
+            .iter()
+            .map(|v| v.pending_jobs.load(Ordering::SeqCst))
+            .sum()
+    }
+
+    fn submit(&self, job: Job, priority: JobPriority) {
+        let lane = lane(priority);
+        let task = Task {
+            job,
+            submitted_at: Instant::now(),
+        };
+        self.lanes[lane].pending_jobs.fetch_add(1, Ordering::SeqCst);
+
+        let local = CURRENT_WORKER
+            .with(|v| v.get())
+            .filter(|(executor, _)| std::ptr::eq(*executor, self))
+            .map(|(_, local)| local);
+        match local {
+            // The local queues are owned by `run_worker`, which is running
+            // the current job on this thread.
+            Some(local) => unsafe { (*local)[lane].push(task) },
+            None => self.global[lane].push(task),
+        }
+
+        // Sleeping workers are counted before they check for pending
+        // jobs, so either they see the new job or we see them.
+        if self.idle_workers.load(Ordering::SeqCst) > 0 {
+            let _guard = self.sleep_lock.lock().unwrap();
+            self.wakeup.notify_one();
+        }
+    }
+
+    fn run_worker(&self, index: usize, local: Queues<Worker<Task>>) {
+        CURRENT_WORKER.with(|v| v.set(Some((self as *const Shared, &local as *const _))));
+        let mut tick: usize = 0;
+        loop {
+            tick = tick.wrapping_add(1);
+            match self.next_task(&local, index, tick) {
+                Some((lane, task)) => self.run_task(lane, task),
+                None => self.wait_for_jobs(),
+            }
+        }
+    }
+
+    fn next_task(
+        &self,
+        local: &Queues<Worker<Task>>,
+        index: usize,
+        tick: usize,
+    ) -> Option<(usize, Task)> {
+        let lanes = if tick % LOW_PRIORITY_INTERVAL == 0 {
+            [lane(JobPriority::Low), lane(JobPriority::High)]
+        } else {
+            [lane(JobPriority::High), lane(JobPriority::Low)]
+        };
+        lanes.into_iter().find_map(|lane| {
+            self.find_task(local, index, lane, tick)
+                .map(|task| (lane, task))
+        })
+    }
+
+    fn find_task(
+        &self,
+        local: &Queues<Worker<Task>>,
+        index: usize,
+        lane: usize,
+        tick: usize,
+    ) -> Option<Task> {
+        let local = || local[lane].pop();
+        let global = || steal_task(|| self.global[lane].steal());
+        let task = if tick % GLOBAL_QUEUE_INTERVAL == 0 {
+            global().or_else(local)
+        } else {
+            local().or_else(global)
+        };
+        task.or_else(|| self.steal(index, lane))
+    }
+
+    /// Takes the oldest job from the local queue of another worker.
+    fn steal(&self, index: usize, lane: usize) -> Option<Task> {
+        let workers = self.workers.len();
+        let task = (1..workers)
+            .map(|i| (index + i) % workers)
+            .find_map(|i| steal_task(|| self.workers[i][lane].steal()))?;
+        self.stolen_jobs.fetch_add(1, Ordering::Relaxed);
+        Some(task)
+    }
+
+    fn run_task(&self, lane: usize, task: Task) {
+        let counters = &self.lanes[lane];
+        let wait_time_us = task.submitted_at.elapsed().as_micros() as u64;
+        counters.pending_jobs.fetch_sub(1, Ordering::SeqCst);
+        counters.executed_jobs.fetch_add(1, Ordering::Relaxed);
+        counters
+            .total_wait_time_us
+            .fetch_add(wait_time_us, Ordering::Relaxed);
+        counters
+            .max_wait_time_us
+            .fetch_max(wait_time_us, Ordering::Relaxed);
+        if std::panic::catch_unwind(AssertUnwindSafe(task.job)).is_err() {
+            self.panicked_jobs.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    fn wait_for_jobs(&self) {
+        let guard = self.sleep_lock.lock().unwrap();
+        self.idle_workers.fetch_add(1, Ordering::SeqCst);
+        let _guard = self
+            .wakeup
+            .wait_while(guard, |_| self.pending_jobs() == 0)
+            .unwrap();
+        self.idle_workers.fetch_sub(1, Ordering::SeqCst);
+    }
+}
+
+/// The executor, the worker threads are started on creation and live
+/// as long as the process.
+pub(crate) struct Executor {
+    shared: Arc<Shared>,
+}
+
+impl Executor {
+    pub(crate) fn new(name: &str, threads: usize) -> Executor {
+        let threads = threads.max(1);
+        let local_queues = (0..threads)
+            .map(|_| [Worker::new_fifo(), Worker::new_fifo()])
+            .collect::<Vec<Queues<Worker<Task>>>>();
+        let shared = Arc::new(Shared {
+            workers: local_queues
+                .iter()
+                .map(|local| [local[0].stealer(), local[1].stealer()])
+                .collect(),
+            global: Default::default(),
+            lanes: Default::default(),
+            stolen_jobs: AtomicU64::new(0),
+            panicked_jobs: AtomicU64::new(0),
+            idle_workers: AtomicUsize::new(0),
+            sleep_lock: Mutex::new(()),
+            wakeup: Condvar::new(),
+        });
+        local_queues
+            .into_iter()
+            .enumerate()
+            .for_each(|(index, local)| {
+                let shared = Arc::clone(&shared);
+                std::thread::Builder::new()
+                    .name(format!("{name}-{index}"))
+                    .spawn(move || shared.run_worker(index, local))
+                    .expect("Failed spawning an executor thread");
+            });
+        Executor { shared }
+    }
+
+    pub(crate) fn execute<F: FnOnce() + Send + 'static>(&self, job: F, priority: JobPriority) {
+        self.shared.submit(Box::new(job), priority);
+    }
+
+    pub(crate) fn stats(&self) -> ExecutorStats {
+        ExecutorStats {
+            threads: self.shared.workers.len(),
+            stolen_jobs: self.shared.stolen_jobs.load(Ordering::Relaxed),
+            panicked_jobs: self.shared.panicked_jobs.load(Ordering::Relaxed),
+            high_priority: self.shared.lanes[lane(JobPriority::High)].stats(),
+            low_priority: self.shared.lanes[lane(JobPriority::Low)].stats(),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::mpsc::channel;
+    use std::time::Duration;
+
+    const TIMEOUT: Duration = Duration::from_secs(10);
+
+    #[test]
+    fn test_run_all_jobs() {
+        let executor = Executor::new("test", 4);
+        let (sender, receiver) = channel();
+        (0..1000).for_each(|i| {
+            let sender = sender.clone();
+            let priority = if i % 3 == 0 {
+                JobPriority::Low
+            } else {
+                JobPriority::High
+            };
+            executor.execute(move || sender.send(i).unwrap(), priority);
+        });
+        let mut res = (0..1000)
+            .map(|_| receiver.recv_timeout(TIMEOUT).unwrap())
+            .collect::<Vec<_>>();
+        res.sort();
+        assert_eq!(res, (0..1000).collect::<Vec<_>>());
+
+        let stats = executor.stats();
+        assert_eq!(stats.threads, 4);
+        assert_eq!(stats.high_priority.executed_jobs, 666);
+        assert_eq!(stats.low_priority.executed_jobs, 334);
+        assert_eq!(stats.high_priority.pending_jobs, 0);
+        assert_eq!(stats.low_priority.pending_jobs, 0);
+    }
+
+    #[test]
+    fn test_high_priority_first() {
+        let executor = Executor::new("test", 1);
+        let (block_sender, block_receiver) = channel::<()>();
+        let (sender, receiver) = channel();
+        executor.execute(
+            move || block_receiver.recv_timeout(TIMEOUT).unwrap(),
+            JobPriority::High,
+        );
+        [
+            ("low1", JobPriority::Low),
+            ("low2", JobPriority::Low),
+            ("high1", JobPriority::High),
+            ("high2", JobPriority::High),
+        ]
+        .into_iter()
+        .for_each(|(name, priority)| {
+            let sender = sender.clone();
+            executor.execute(move || sender.send(name).unwrap(), priority);
+        });
+        block_sender.send(()).unwrap();
+        let res = (0..4)
+            .map(|_| receiver.recv_timeout(TIMEOUT).unwrap())
+            .collect::<Vec<_>>();
+        assert_eq!(res, vec!["high1", "high2", "low1", "low2"]);
+    }
+
+    #[test]
+    fn test_low_priority_not_starved() {
+        let executor = Arc::new(Executor::new("test", 1));
+        let (sender, receiver) = channel();
+        // A high priority job which keeps re-submitting itself.
+        fn resubmit(executor: Arc<Executor>, sender: std::sync::mpsc::Sender<&'static str>) {
+            if sender.send("high").is_ok() {
+                let executor_ref = Arc::clone(&executor);
+                executor.execute(move || resubmit(executor_ref, sender), JobPriority::High);
+            }
+        }
+        let executor_ref = Arc::clone(&executor);
+        let high_sender = sender.clone();
+        executor.execute(
+            move || resubmit(executor_ref, high_sender),
+            JobPriority::High,
+        );
+        executor.execute(move || sender.send("low").unwrap(), JobPriority::Low);
+        let high_jobs = std::iter::from_fn(|| receiver.recv_timeout(TIMEOUT).ok())
+            .take_while(|v| *v != "low")
+            .count();
+        assert!(high_jobs <= LOW_PRIORITY_INTERVAL);
+    }
+
+    #[test]
+    fn test_steal() {
+        let executor = Arc::new(Executor::new("test", 2));
+        let (sender, receiver) = channel();
+        let executor_ref = Arc::clone(&executor);
+        executor.execute(
+            move || {
+                // The job is pushed to the local queue of the current worker,
+                // which is blocked until the job runs, so it must be stolen.
+                let (inner_sender, inner_receiver) = channel();
+                executor_ref.execute(move || inner_sender.send(()).unwrap(), JobPriority::High);
+                sender
+                    .send(inner_receiver.recv_timeout(TIMEOUT).is_ok())
+                    .unwrap();
+            },
+            JobPriority::High,
+        );
+        assert!(receiver.recv_timeout(TIMEOUT).unwrap());
+        assert_eq!(executor.stats().stolen_jobs, 1);
+    }
+
+    #[test]
+    fn test_panicking_job() {
+        let executor = Executor::new("test", 1);
+        let (sender, receiver) = channel();
+        executor.execute(|| panic!("job panicked"), JobPriority::High);
+        executor.execute(move || sender.send(()).unwrap(), JobPriority::High);
+        // The worker survived the panic and ran the next job.
+        assert!(receiver.recv_timeout(TIMEOUT).is_ok());
+        assert_eq!(executor.stats().panicked_jobs, 1);
+    }
+}
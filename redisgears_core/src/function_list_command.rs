@@ -10,10 +10,42 @@ use redisgears_plugin_api::redisgears_plugin_api::load_library_ctx::{
     FunctionFlags, FUNCTION_FLAG_ALLOW_OOM_GLOBAL_VALUE, FUNCTION_FLAG_NO_WRITES_GLOBAL_VALUE,
     FUNCTION_FLAG_RAW_ARGUMENTS_GLOBAL_VALUE,
 };
+use std::sync::atomic::Ordering;
 use std::sync::Arc;
 
+use crate::invocation_stats::{LatencyHistogram, LatencySummary};
 use crate::{get_globals, get_libraries, get_msg_verbose, GearsLibrary};
 
+/// The latency of a function or a trigger, in microseconds.
+#[derive(RedisValue)]
+struct LatencyInfo {
+    count: usize,
+    avg_us: usize,
+    p50_us: usize,
+    p99_us: usize,
+    p999_us: usize,
+    max_us: usize,
+}
+
+impl From<LatencySummary> for LatencyInfo {
+    fn from(value: LatencySummary) -> Self {
+        LatencyInfo {
+            count: value.count as usize,
+            avg_us: value.avg_us as usize,
+            p50_us: value.p50_us as usize,
+            p99_us: value.p99_us as usize,
+            p999_us: value.p999_us as usize,
+            max_us: value.max_us as usize,
+        }
+    }
+}
+
+impl From<&LatencyHistogram> for LatencyInfo {
+    fn from(value: &LatencyHistogram) -> Self {
+        value.summary().into()
+    }
+}
+
 /// Contains information about a single stream that tracked
 /// by a stream trigger.
 #[derive(RedisValue)]
@@ -24,6 +56,8 @@ struct StreamInfo {
     last_lag: usize,               // last lag in ms
     total_lag: usize,              // average lag in ms
     total_record_processed: usize, // average lag in ms
+    total_record_failed: usize,
+    window: usize, // the window currently in use, changes if the window is adaptive
     pending_ids: Vec<String>,
     id_to_read_from: Option<String>,
     last_error: Option<String>,
@@ -43,7 +77,12 @@ struct StreamTriggersInfoVerbose1 {
     prefix: Vec<u8>,
     window: usize,
     trim: bool,
+    batch_size: Option<usize>,
+    max_batch_delay: Option<usize>,
+    max_window: Option<usize>,
+    target_latency: Option<usize>,
     description: Option<String>,
+    latency: LatencyInfo,
 }
 
 /// A struct that allows to translate a [StreamTriggersInfo] into
@@ -61,6 +100,9 @@ enum StreamTriggersInfo {
 struct TriggersInfoVerbose1 {
     name: String,
     description: Option<String>,
+    debounce_window: Option<usize>,
+    debounce_max_events: Option<usize>,
+    num_events: usize,
     num_trigger: usize,
     num_success: usize,
     num_failed: usize,
@@ -68,6 +110,7 @@ struct TriggersInfoVerbose1 {
     last_error: Option<String>,
     last_execution_time: usize,
     total_execution_time: usize,
+    latency: LatencyInfo,
 }
 
 #[derive(RedisValue)]
@@ -83,6 +126,11 @@ struct FunctionInfoVerbose {
     flags: RedisValue,
     is_async: bool,
     description: Option<String>,
+    num_calls: usize,
+    num_errors: usize,
+    latency: LatencyInfo,
+    /// The time between blocking the client and replying to it.
+    async_wait_latency: Option<LatencyInfo>,
 }
 
 /// A struct that allows to translate a [RequestedFunctionInfo] into
@@ -182,6 +230,10 @@ fn get_library_info(
                         flags: function_list_command_flags(val.flags),
                         is_async: val.is_async,
                         description: val.description.to_owned(),
+                        num_calls: val.stats.calls.load(Ordering::Relaxed) as usize,
+                        num_errors: val.stats.errors.load(Ordering::Relaxed) as usize,
+                        latency: (&val.stats.latency).into(),
+                        async_wait_latency: val.is_async.then(|| (&val.stats.async_wait).into()),
                     })
                 }
             })
@@ -202,9 +254,13 @@ fn get_library_info(
                 }
                 let val = val.borrow();
                 let stats = val.get_stats();
+                let debounce_config = val.get_debounce_config();
                 TriggersInfo::Verbose1(TriggersInfoVerbose1 {
                     name: name.to_owned(),
                     description: val.get_description(),
+                    debounce_window: debounce_config.map(|v| v.window),
+                    debounce_max_events: debounce_config.and_then(|v| v.max_events),
+                    num_events: stats.num_events,
                     num_trigger: stats.num_trigger,
                     num_success: stats.num_success,
                     num_failed: stats.num_failed,
@@ -215,6 +271,7 @@ fn get_library_info(
                         .map(|v| get_msg_verbose(v).to_owned()),
                     last_execution_time: stats.last_execution_time as usize,
                     total_execution_time: stats.total_execution_time as usize,
+                    latency: (&stats.latency).into(),
                 })
             })
             .collect(),
@@ -227,12 +284,19 @@ fn get_library_info(
                     return StreamTriggersInfo::Verbose0(name.to_owned());
                 }
                 let val = val.ref_cell.borrow();
+                let batch_config = val.batch_config();
+                let adaptive_window_config = val.adaptive_window_config();
                 let stream_trigger_info = StreamTriggersInfoVerbose1 {
                     name: name.to_owned(),
                     prefix: val.prefix.clone(),
                     window: val.window,
                     trim: val.trim,
+                    batch_size: batch_config.map(|b| b.batch_size),
+                    max_batch_delay: batch_config.map(|b| b.max_batch_delay),
+                    max_window: adaptive_window_config.map(|a| a.max_window),
+                    target_latency: adaptive_window_config.map(|a| a.target_latency),
                     description: val.description.clone(),
+                    latency: val.latency.as_ref().into(),
                 };
                 if verbosity_level == 1 {
                     return StreamTriggersInfo::Verbose1(stream_trigger_info);
@@ -242,24 +306,26 @@ fn get_library_info(
                     streams: val
                         .consumed_streams
                         .iter()
-                        .map(|(name, val)| {
-                            let val = val.ref_cell.borrow();
+                        .map(|(name, stream_info)| {
+                            let stream_info = stream_info.ref_cell.borrow();
                             StreamInfo {
                                 name: name.to_owned(),
-                                last_processed_time: val.last_processed_time as usize,
-                                total_processed_time: val.total_processed_time as usize,
-                                last_lag: val.last_lag as usize,
-                                total_lag: val.total_lag as usize,
-                                total_record_processed: val.records_processed,
-                                pending_ids: val
+                                last_processed_time: stream_info.last_processed_time as usize,
+                                total_processed_time: stream_info.total_processed_time as usize,
+                                last_lag: stream_info.last_lag as usize,
+                                total_lag: stream_info.total_lag as usize,
+                                total_record_processed: stream_info.records_processed,
+                                total_record_failed: stream_info.records_failed,
+                                window: val.effective_window(&stream_info),
+                                pending_ids: stream_info
                                     .pending_ids
                                     .iter()
                                     .map(|id| format!("{}-{}", id.ms, id.seq))
                                     .collect(),
-                                id_to_read_from: val
+                                id_to_read_from: stream_info
                                     .last_read_id
                                     .map(|id| format!("{}-{}", id.ms, id.seq)),
-                                last_error: val
+                                last_error: stream_info
                                     .last_error
                                     .as_ref()
                                     .map(|v| get_msg_verbose(v).to_owned()),
@@ -10,6 +10,7 @@ use redis_module::{
 use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::BackendCtxInterfaceInitialised;
 use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::DebuggerBackend;
 use redisgears_plugin_api::redisgears_plugin_api::load_library_ctx::LibraryCtxInterface;
+use redisgears_plugin_api::redisgears_plugin_api::prologue::ApiVersion;
 use redisgears_plugin_api::redisgears_plugin_api::{GearsApiError, GearsApiResult};
 
 use crate::compiled_library_api::{CompiledLibraryAPI, CompiledLibraryInternals};
@@ -29,7 +30,8 @@ use std::iter::Skip;
 use std::vec::IntoIter;
 
 use std::collections::HashMap;
-use std::sync::Arc;
+
+use std::sync::{Arc, Mutex};
 
 use crate::get_msg_verbose;
 
@@ -154,12 +156,18 @@ pub(crate) fn function_load_revert(
             s_d.set_description(description);
         }
 
-        for (name, key, callback, description) in gears_library.revert_notifications_consumers {
+        for (name, key, callback, description, filter, debounce_config) in
+            gears_library.revert_notifications_consumers
+        {
             let notification_consumer = gears_library.notifications_consumers.get(&name).unwrap();
+            crate::get_globals_mut()
+                .notifications_ctx
+                .set_consumer_key(notification_consumer, key);
             let mut s_d = notification_consumer.borrow_mut();
-            s_d.set_key(key);
             let _ = s_d.set_callback(callback);
             s_d.set_description(description);
+            s_d.set_filter(filter);
+            s_d.set_debounce_config(debounce_config);
         }
 
         libraries.insert(gears_library.meta_data.name.clone(), old_lib);
@@ -171,27 +179,37 @@ fn compile_library(
     compilation_arguments: &CompilationArguments,
     debug: bool,
 ) -> GearsApiResult<CompiledLibraryData> {
-    let globals = get_globals();
     let meta_data = compilation_arguments
         .get_metadata()
         .map_err(GearsApiError::from)?;
-    let backend = compilation_arguments.get_backend_mut(context)?;
+    let backend = context.get_backend(meta_data.engine.as_str())?;
+    let (library, compile_lib_internals) =
+        compile_library_with_backend(backend.as_ref(), &meta_data, debug)?;
+
+    Ok(CompiledLibraryData {
+        meta_data,
+        library_ctx_interface: library,
+        compiled_library_internals: compile_lib_internals,
+    })
+}
+
+fn compile_library_with_backend(
+    backend: &dyn BackendCtxInterfaceInitialised,
+    meta_data: &GearsLibraryMetaData,
+    debug: bool,
+) -> GearsApiResult<(Box<dyn LibraryCtxInterface>, Arc<CompiledLibraryInternals>)> {
+    let globals = get_globals();
     let compile_lib_ctx = CompiledLibraryAPI::new(globals.redis_version.is_enterprise);
     let compile_lib_internals = compile_lib_ctx.take_internals();
     let library = backend.compile_library(
         debug,
         &meta_data.name,
-        &compilation_arguments.code,
+        &meta_data.code,
         meta_data.api_version,
         meta_data.config.as_ref(),
         Box::new(compile_lib_ctx),
     )?;
-
-    Ok(CompiledLibraryData {
-        meta_data,
-        library_ctx_interface: library,
-        compiled_library_internals: compile_lib_internals,
-    })
+    Ok((library, compile_lib_internals))
 }
 
 /// Evaluates the compiled function code and if everything is okay,
@@ -554,3 +572,141 @@ pub(crate) fn function_load_on_replica(
         Err(e) => Err(RedisError::String(e)),
     }
 }
+
+/// A backend that is shared with the compilation threads.
+#[derive(Clone, Copy)]
+struct SharedBackend<'backend>(&'backend dyn BackendCtxInterfaceInitialised);
+
+// SAFETY: the compilation threads only call
+// [BackendCtxInterfaceInitialised::compile_library] on the backend, which is
+// documented to be callable from multiple threads at the same time. The
+// threads are scoped and the main thread is blocked until they all exit, so
+// the backend is not used concurrently by anything else.
+unsafe impl Send for SharedBackend<'_> {}
+unsafe impl Sync for SharedBackend<'_> {}
+
+/// A library compiled on a compilation thread.
+struct CompiledLibrary(Box<dyn LibraryCtxInterface>);
+
+// SAFETY: the library is created by the compilation thread and is not
+// touched there after [BackendCtxInterfaceInitialised::compile_library]
+// returns. It is only used once it was moved to the main thread and the
+// compilation thread exited, and the libraries are not bound to the thread
+// that compiled them (they are already run from the backends threads).
+unsafe impl Send for CompiledLibrary {}
+
+/// A library to compile on a compilation thread. Only holds owned data that
+/// the compilation needs, the library metadata stays on the main thread.
+struct CompilationJob<'backend> {
+    index: usize,
+    backend: SharedBackend<'backend>,
+    name: String,
+    code: String,
+    api_version: ApiVersion,
+    config: Option<String>,
+    compiled_library_api: CompiledLibraryAPI,
+}
+
+impl CompilationJob<'_> {
+    fn compile(self) -> (usize, GearsApiResult<CompiledLibrary>) {
+        let res = self
+            .backend
+            .0
+            .compile_library(
+                false,
+                &self.name,
+                &self.code,
+                self.api_version,
+                self.config.as_ref(),
+                Box::new(self.compiled_library_api),
+            )
+            .map(CompiledLibrary);
+        (self.index, res)
+    }
+}
+
+/// Compiles the given libraries, without evaluating them, using multiple threads.
+/// Each library is compiled independently of the others. The results are returned
+/// in the same order as the given compilation arguments.
+pub(crate) fn function_compile_parallel(
+    context: &Context,
+    compilation_arguments: Vec<CompilationArguments>,
+) -> Vec<Result<CompiledLibraryInfo, String>> {
+    let to_compile_err = |e: GearsApiError| format!("Failed to compile library: {}", e.get_msg());
+    let is_enterprise = get_globals().redis_version.is_enterprise;
+
+    // Extract the metadata and get the backends on the current thread,
+    // getting a backend might require initialising it.
+    let mut jobs = Vec::new();
+    let meta_datas = compilation_arguments
+        .into_iter()
+        .enumerate()
+        .map(|(index, args)| {
+            let meta_data = args
+                .get_metadata()
+                .map_err(|e| to_compile_err(GearsApiError::from(e)))?;
+            let backend = context
+                .get_backend(meta_data.engine.as_str())
+                .map_err(|e| to_compile_err(GearsApiError::from(e)))?;
+            let compiled_library_api = CompiledLibraryAPI::new(is_enterprise);
+            let internals = compiled_library_api.take_internals();
+            jobs.push(CompilationJob {
+                index,
+                backend: SharedBackend(backend.as_ref()),
+                name: meta_data.name.clone(),
+                code: meta_data.code.clone(),
+                api_version: meta_data.api_version,
+                config: meta_data.config.clone(),
+                compiled_library_api,
+            });
+            Ok((meta_data, internals))
+        })
+        .collect::<Vec<Result<_, String>>>();
+
+    let threads = std::thread::available_parallelism()
+        .map_or(1, |v| v.get())
+        .min(jobs.len());
+    let jobs = &Mutex::new(jobs.into_iter());
+    let mut compiled = std::thread::scope(|scope| {
+        let handles = (0..threads)
+            .map(|_| {
+                std::thread::Builder::new()
+                    .name("RGCompile".to_owned())
+                    .spawn_scoped(scope, move || {
+                        let mut compiled = Vec::new();
+                        loop {
+                            let job = jobs.lock().unwrap().next();
+                            match job {
+                                Some(job) => compiled.push(job.compile()),
+                                None => return compiled,
+                            }
+                        }
+                    })
+                    .expect("Failed creating library compilation thread")
+            })
+            .collect::<Vec<_>>();
+        handles
+            .into_iter()
+            .flat_map(|h| h.join().expect("Library compilation thread panicked"))
+            .collect::<Vec<_>>()
+    });
+
+    compiled.sort_by_key(|(index, _)| *index);
+    let mut compiled = compiled.into_iter().map(|(_, res)| res);
+    meta_datas
+        .into_iter()
+        .map(|job| {
+            let (meta_data, internals) = job?;
+            // results are sorted and only exist for the successful jobs.
+            let CompiledLibrary(library_context) = compiled
+                .next()
+                .expect("Missing library compilation result")
+                .map_err(to_compile_err)?;
+            Ok(CompiledLibraryInfo {
+                meta_data,
+                library_context,
+                internals,
+            })
+        })
+        .collect()
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Runtime statistics of functions and triggers.
+//!
+//! Latencies are kept on a log-linear histogram with microseconds
+//! resolution: values are grouped by their power of two, and each group
+//! is split into [`SUB_BUCKETS`] equal buckets, so the reported
+//! percentiles are at most 1/32 above the actual values, regardless of
+//! their magnitude. The histogram is updated with relaxed atomics so it
+//! can be updated from any thread without locking.
+
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::Duration;
+
+const SUB_BUCKET_BITS: u32 = 5;
+const SUB_BUCKETS: usize = 1 << SUB_BUCKET_BITS;
+/// Latencies above 2^36us (about 19 hours) are counted as 2^36us.
+const MAX_VALUE_BITS: u32 = 36;
+const MAX_VALUE: u64 = (1 << MAX_VALUE_BITS) - 1;
+const BUCKETS: usize = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) as usize * SUB_BUCKETS;
+
+fn bucket_index(value: u64) -> usize {
+    let value = value.min(MAX_VALUE);
+    if value < SUB_BUCKETS as u64 {
+        return value as usize;
+    }
+    let magnitude = 63 - value.leading_zeros();
+    let shift = magnitude - SUB_BUCKET_BITS;
+    let group = (shift + 1) as usize;
+    group * SUB_BUCKETS + ((value >> shift) as usize & (SUB_BUCKETS - 1))
+}
+
+/// The highest value that is counted on the given bucket.
+fn bucket_upper_bound(index: usize) -> u64 {
+    let group = index / SUB_BUCKETS;
+    let sub_bucket = (index % SUB_BUCKETS) as u64;
+    if group == 0 {
+        return sub_bucket;
+    }
+    ((SUB_BUCKETS as u64 + sub_bucket + 1) << (group - 1)) - 1
+}
+
+/// A point in time view of a [`LatencyHistogram`], all values are in microseconds.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub(crate) struct LatencySummary {
+    pub(crate) count: u64,
+    pub(crate) avg_us: u64,
+    pub(crate) p50_us: u64,
+    pub(crate) p99_us: u64,
+    pub(crate) p999_us: u64,
+    pub(crate) max_us: u64,
+}
+
+pub(crate) struct LatencyHistogram {
+    buckets: Box<[AtomicU64]>,
+    total_us: AtomicU64,
+    max_us: AtomicU64,
+}
+
+impl LatencyHistogram {
+    pub(crate) fn new() -> LatencyHistogram {
+        LatencyHistogram {
+            buckets: (0..BUCKETS).map(|_| AtomicU64::new(0)).collect(),
+            total_us: AtomicU64::new(0),
+            max_us: AtomicU64::new(0),
+        }
+    }
+
+    pub(crate) fn record(&self, duration: Duration) {
+        let value = duration.as_micros().min(MAX_VALUE as u128) as u64;
+        self.buckets[bucket_index(value)].fetch_add(1, Ordering::Relaxed);
+        self.total_us.fetch_add(value, Ordering::Relaxed);
+        self.max_us.fetch_max(value, Ordering::Relaxed);
+    }
+
+    /// Adds the latencies recorded on the given histogram.
+    pub(crate) fn merge(&self, other: &LatencyHistogram) {
+        self.buckets
+            .iter()
+            .zip(other.buckets.iter())
+            .for_each(|(b, o)| {
+                b.fetch_add(o.load(Ordering::Relaxed), Ordering::Relaxed);
+            });
+        self.total_us
+            .fetch_add(other.total_us.load(Ordering::Relaxed), Ordering::Relaxed);
+        self.max_us
+            .fetch_max(other.max_us.load(Ordering::Relaxed), Ordering::Relaxed);
+    }
+
+    pub(crate) fn summary(&self) -> LatencySummary {
+        let counts = self
+            .buckets
+            .iter()
+            .map(|b| b.load(Ordering::Relaxed))
+            .collect::<Vec<_>>();
+        let count = counts.iter().sum::<u64>();
+        if count == 0 {
+            return LatencySummary::default();
+        }
+        let max_us = self.max_us.load(Ordering::Relaxed);
+        let percentile = |quantile: f64| {
+            let rank = ((count as f64 * quantile).ceil() as u64).max(1);
+            let mut seen = 0;
+            let index = counts
+                .iter()
+                .position(|c| {
+                    seen += c;
+                    seen >= rank
+                })
+                .unwrap_or(BUCKETS - 1);
+            bucket_upper_bound(index).min(max_us)
+        };
+        LatencySummary {
+            count,
+            avg_us: self.total_us.load(Ordering::Relaxed) / count,
+            p50_us: percentile(0.5),
+            p99_us: percentile(0.99),
+            p999_us: percentile(0.999),
+            max_us,
+        }
+    }
+}
+
+impl Default for LatencyHistogram {
+    fn default() -> Self {
+        LatencyHistogram::new()
+    }
+}
+
+impl Clone for LatencyHistogram {
+    fn clone(&self) -> Self {
+        let load = |v: &AtomicU64| AtomicU64::new(v.load(Ordering::Relaxed));
+        LatencyHistogram {
+            buckets: self.buckets.iter().map(load).collect(),
+            total_us: load(&self.total_us),
+            max_us: load(&self.max_us),
+        }
+    }
+}
+
+impl std::fmt::Debug for LatencyHistogram {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_tuple("LatencyHistogram")
+            .field(&self.summary())
+            .finish()
+    }
+}
+
+/// The statistics of a single function.
+#[derive(Debug, Default)]
+pub(crate) struct FunctionStats {
+    pub(crate) calls: AtomicU64,
+    pub(crate) errors: AtomicU64,
+    /// The time the function ran on the main thread.
+    pub(crate) latency: LatencyHistogram,
+    /// The time between blocking the client and replying to it,
+    /// only relevant for async functions.
+    pub(crate) async_wait: LatencyHistogram,
+}
+
+impl FunctionStats {
+    pub(crate) fn on_call(&self) {
+        self.calls.fetch_add(1, Ordering::Relaxed);
+    }
+
+    pub(crate) fn on_error(&self) {
+        self.errors.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_bucket_bounds() {
+        (0..BUCKETS).for_each(|i| {
+            assert_eq!(bucket_index(bucket_upper_bound(i)), i);
+            if i > 0 {
+                assert_eq!(bucket_index(bucket_upper_bound(i - 1) + 1), i);
+            }
+        });
+        assert_eq!(bucket_index(u64::MAX), BUCKETS - 1);
+    }
+
+    #[test]
+    fn test_relative_error() {
+        [1, 31, 32, 33, 100, 1000, 12345, 1_000_000, MAX_VALUE]
+            .into_iter()
+            .for_each(|v| {
+                let upper_bound = bucket_upper_bound(bucket_index(v));
+                assert!(upper_bound >= v);
+                assert!(upper_bound - v <= v / SUB_BUCKETS as u64);
+            });
+    }
+
+    #[test]
+    fn test_percentiles() {
+        let histogram = LatencyHistogram::new();
+        assert_eq!(histogram.summary(), LatencySummary::default());
+        (1..=1000).for_each(|v| histogram.record(Duration::from_micros(v)));
+        let summary = histogram.summary();
+        assert_eq!(summary.count, 1000);
+        assert_eq!(summary.avg_us, 500);
+        assert_eq!(summary.max_us, 1000);
+        assert!((500..=515).contains(&summary.p50_us));
+        assert!((990..=1000).contains(&summary.p99_us));
+        assert!((999..=1000).contains(&summary.p999_us));
+    }
+
+    #[test]
+    fn test_tail_latency() {
+        let histogram = LatencyHistogram::new();
+        (0..999).for_each(|_| histogram.record(Duration::from_micros(10)));
+        histogram.record(Duration::from_secs(1));
+        let summary = histogram.summary();
+        assert_eq!(summary.p50_us, 10);
+        assert_eq!(summary.p99_us, 10);
+        assert_eq!(summary.p999_us, 10);
+        assert_eq!(summary.max_us, 1_000_000);
+        histogram.record(Duration::from_secs(1));
+        assert!(histogram.summary().p999_us >= 1_000_000);
+    }
+
+    #[test]
+    fn test_merge() {
+        let first = LatencyHistogram::new();
+        let second = LatencyHistogram::new();
+        (0..10).for_each(|_| first.record(Duration::from_micros(10)));
+        (0..10).for_each(|_| second.record(Duration::from_micros(30)));
+        let merged = LatencyHistogram::new();
+        merged.merge(&first);
+        merged.merge(&second);
+        let summary = merged.summary();
+        assert_eq!(summary.count, 20);
+        assert_eq!(summary.avg_us, 20);
+        assert_eq!(summary.p50_us, 10);
+        assert_eq!(summary.max_us, 30);
+        assert_eq!(first.summary().count, 10);
+    }
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Coalesces the key space notifications of a trigger per key.
+//!
+//! The first notification of a key opens a window, the following
+//! notifications of the key only replace the event that will be delivered.
+//! The key is delivered once, with its last event, when the window expires
+//! or when it accumulated the maximum amount of notifications. Keys are
+//! delivered in the order of their first notification.
+
+use std::collections::{HashMap, VecDeque};
+use std::time::{Duration, Instant};
+
+#[derive(Debug)]
+struct PendingKey {
+    /// Identifies the entry of the key on the delivery queue.
+    seq: u64,
+    event: String,
+    events: usize,
+}
+
+#[derive(Debug, Default)]
+pub(crate) struct KeyDebouncer {
+    pending: HashMap<Vec<u8>, PendingKey>,
+    /// The pending keys by the time of their first notification. Keys that
+    /// were delivered before their window expired leave a stale entry that
+    /// is skipped by comparing its sequence.
+    queue: VecDeque<(u64, Instant, Vec<u8>)>,
+    next_seq: u64,
+}
+
+impl KeyDebouncer {
+    pub(crate) fn new() -> KeyDebouncer {
+        KeyDebouncer::default()
+    }
+
+    pub(crate) fn is_empty(&self) -> bool {
+        self.pending.is_empty()
+    }
+
+    /// Add a notification of the given key. Returns the event to deliver
+    /// right away if the key reached `max_events` notifications.
+    pub(crate) fn on_event(
+        &mut self,
+        event: &str,
+        key: &[u8],
+        max_events: Option<usize>,
+        now: Instant,
+    ) -> Option<String> {
+        let pending = match self.pending.get_mut(key) {
+            Some(pending) => {
+                pending.events += 1;
+                if pending.event != event {
+                    pending.event = event.to_owned();
+                }
+                pending
+            }
+            None => {
+                let seq = self.next_seq;
+                self.next_seq += 1;
+                self.queue.push_back((seq, now, key.to_vec()));
+                self.pending.entry(key.to_vec()).or_insert(PendingKey {
+                    seq,
+                    event: event.to_owned(),
+                    events: 1,
+                })
+            }
+        };
+        if max_events.map_or(true, |v| pending.events < v) {
+            return None;
+        }
+        self.pending.remove(key).map(|v| v.event)
+    }
+
+    /// Take the keys whose window expired, with the event to deliver.
+    pub(crate) fn take_expired(
+        &mut self,
+        window: Duration,
+        now: Instant,
+    ) -> Vec<(Vec<u8>, String)> {
+        let mut res = Vec::new();
+        while let Some((seq, first_event, key)) = self.queue.front() {
+            let is_stale = self.pending.get(key).map_or(true, |v| v.seq != *seq);
+            if !is_stale && now.duration_since(*first_event) < window {
+                break;
+            }
+            let (_, _, key) = self.queue.pop_front().unwrap();
+            if !is_stale {
+                let pending = self.pending.remove(&key).unwrap();
+                res.push((key, pending.event));
+            }
+        }
+        res
+    }
+
+    pub(crate) fn clear(&mut self) {
+        self.pending.clear();
+        self.queue.clear();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const WINDOW: Duration = Duration::from_millis(100);
+
+    #[test]
+    fn test_coalescing() {
+        let mut debouncer = KeyDebouncer::new();
+        let start = Instant::now();
+        (0..10).for_each(|_| assert_eq!(debouncer.on_event("hset", b"x", None, start), None));
+        debouncer.on_event("set", b"y", None, start + WINDOW / 2);
+        debouncer.on_event("del", b"x", None, start + WINDOW / 2);
+        assert!(debouncer
+            .take_expired(WINDOW, start + WINDOW / 2)
+            .is_empty());
+        assert_eq!(
+            debouncer.take_expired(WINDOW, start + WINDOW),
+            vec![(b"x".to_vec(), "del".to_owned())]
+        );
+        assert_eq!(
+            debouncer.take_expired(WINDOW, start + WINDOW * 2),
+            vec![(b"y".to_vec(), "set".to_owned())]
+        );
+        assert!(debouncer.is_empty());
+    }
+
+    #[test]
+    fn test_max_events() {
+        let mut debouncer = KeyDebouncer::new();
+        let start = Instant::now();
+        assert_eq!(debouncer.on_event("hset", b"x", Some(3), start), None);
+        assert_eq!(debouncer.on_event("hset", b"x", Some(3), start), None);
+        assert_eq!(
+            debouncer.on_event("hdel", b"x", Some(3), start),
+            Some("hdel".to_owned())
+        );
+        assert!(debouncer.is_empty());
+
+        // the key starts a new window after it was delivered.
+        debouncer.on_event("hset", b"x", Some(3), start + WINDOW / 2);
+        assert!(debouncer.take_expired(WINDOW, start + WINDOW).is_empty());
+        assert_eq!(
+            debouncer.take_expired(WINDOW, start + WINDOW * 2),
+            vec![(b"x".to_vec(), "hset".to_owned())]
+        );
+        assert!(debouncer.queue.is_empty());
+    }
+
+    #[test]
+    fn test_zero_window() {
+        let mut debouncer = KeyDebouncer::new();
+        let start = Instant::now();
+        debouncer.on_event("set", b"x", None, start);
+        debouncer.on_event("set", b"y", None, start);
+        assert_eq!(debouncer.take_expired(Duration::ZERO, start).len(), 2);
+        debouncer.on_event("set", b"x", None, start);
+        debouncer.clear();
+        assert!(debouncer.take_expired(Duration::ZERO, start).is_empty());
+    }
+}
@@ -4,11 +4,20 @@
  * the Server Side Public License v1 (SSPLv1).
  */
 
+use crate::invocation_stats::LatencyHistogram;
+use crate::key_debouncer::KeyDebouncer;
+use crate::prefix_trie::PrefixTrie;
+
 use redis_module::Context;
+use redisgears_plugin_api::redisgears_plugin_api::keys_notifications_consumer_ctx::{
+    KeySpaceTriggerDebounceConfig, KeySpaceTriggerFilter,
+};
 use redisgears_plugin_api::redisgears_plugin_api::{GearsApiError, RefCellWrapper};
 use std::cell::RefCell;
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::{Arc, Weak};
-use std::time::SystemTime;
+use std::time::{Duration, Instant};
 
 /// A callback that will be provider to the user to call when he finished to
 /// processes the notification
@@ -26,6 +35,9 @@ pub(crate) enum ConsumerKey {
 
 #[derive(Debug, Clone)]
 pub(crate) struct NotificationConsumerStats {
+    /// The notifications that were routed to the consumer, more than
+    /// [`Self::num_trigger`] if the notifications are debounced.
+    pub(crate) num_events: usize,
     pub(crate) num_trigger: usize,
     pub(crate) num_success: usize,
     pub(crate) num_failed: usize,
@@ -33,6 +45,7 @@ pub(crate) struct NotificationConsumerStats {
     pub(crate) last_error: Option<GearsApiError>,
     pub(crate) last_execution_time: u128,
     pub(crate) total_execution_time: u128,
+    pub(crate) latency: LatencyHistogram,
 }
 
 pub(crate) struct NotificationConsumer {
@@ -40,6 +53,21 @@ pub(crate) struct NotificationConsumer {
     callback: Option<NotificationCallback>,
     stats: Arc<RefCellWrapper<NotificationConsumerStats>>,
     description: Option<String>,
+    filter: Option<KeySpaceTriggerFilter>,
+    debounce_config: Option<KeySpaceTriggerDebounceConfig>,
+    debouncer: KeyDebouncer,
+    /// Whether the consumer is on the list of consumers with
+    /// debounced notifications.
+    flush_scheduled: bool,
+    /// Set when the consumer is dropped to indicate that the routing
+    /// index contains dead entries.
+    index_has_dead_consumers: Arc<AtomicBool>,
+}
+
+impl Drop for NotificationConsumer {
+    fn drop(&mut self) {
+        self.index_has_dead_consumers.store(true, Ordering::Relaxed);
+    }
 }
 
 impl std::fmt::Debug for NotificationConsumer {
@@ -55,6 +83,8 @@ impl std::fmt::Debug for NotificationConsumer {
             .field("callback", &callback)
             .field("stats", &self.stats)
             .field("description", &self.description)
+            .field("filter", &self.filter)
+            .field("debounce_config", &self.debounce_config)
             .finish()
     }
 }
@@ -64,12 +94,14 @@ impl NotificationConsumer {
         key: ConsumerKey,
         callback: NotificationCallback,
         description: Option<String>,
+        index_has_dead_consumers: &Arc<AtomicBool>,
     ) -> NotificationConsumer {
         NotificationConsumer {
             key: Some(key),
             callback: Some(callback),
             stats: Arc::new(RefCellWrapper {
                 ref_cell: RefCell::new(NotificationConsumerStats {
+                    num_events: 0,
                     num_trigger: 0,
                     num_success: 0,
                     num_failed: 0,
@@ -77,9 +109,15 @@ impl NotificationConsumer {
                     last_error: None,
                     last_execution_time: 0,
                     total_execution_time: 0,
+                    latency: LatencyHistogram::new(),
                 }),
             }),
             description,
+            filter: None,
+            debounce_config: None,
+            debouncer: KeyDebouncer::new(),
+            flush_scheduled: false,
+            index_has_dead_consumers: Arc::clone(index_has_dead_consumers),
         }
     }
 
@@ -89,7 +127,9 @@ impl NotificationConsumer {
         old_callback.unwrap()
     }
 
-    pub(crate) fn set_key(&mut self, key: ConsumerKey) -> ConsumerKey {
+    /// Set the consumer key, must only be called through
+    /// [`KeysNotificationsCtx::set_consumer_key`] to keep the routing index updated.
+    fn set_key(&mut self, key: ConsumerKey) -> ConsumerKey {
         let old_key = self.key.take();
         self.key = Some(key);
         old_key.unwrap()
@@ -101,6 +141,25 @@ impl NotificationConsumer {
         old_description
     }
 
+    pub(crate) fn set_filter(
+        &mut self,
+        filter: Option<KeySpaceTriggerFilter>,
+    ) -> Option<KeySpaceTriggerFilter> {
+        std::mem::replace(&mut self.filter, filter)
+    }
+
+    pub(crate) fn set_debounce_config(
+        &mut self,
+        debounce_config: Option<KeySpaceTriggerDebounceConfig>,
+    ) -> Option<KeySpaceTriggerDebounceConfig> {
+        std::mem::replace(&mut self.debounce_config, debounce_config)
+    }
+
+    /// Whether the given notification should fire the consumer.
+    fn is_interested(&self, event: &str, key: &[u8]) -> bool {
+        self.filter.as_ref().map_or(true, |f| f.matches(event, key))
+    }
+
     pub(crate) fn get_stats(&self) -> NotificationConsumerStats {
         self.stats.ref_cell.borrow().clone()
     }
@@ -108,6 +167,10 @@ impl NotificationConsumer {
     pub(crate) fn get_description(&self) -> Option<String> {
         self.description.clone()
     }
+
+    pub(crate) fn get_debounce_config(&self) -> Option<&KeySpaceTriggerDebounceConfig> {
+        self.debounce_config.as_ref()
+    }
 }
 
 fn fire_event(
@@ -122,21 +185,19 @@ fn fire_event(
         stats.num_trigger += 1;
     }
     let stats_ref = Arc::clone(&c.stats);
-    let start_time = SystemTime::now();
+    let start_time = Instant::now();
 
     (c.callback.as_ref().unwrap())(
         ctx,
         event,
         key,
         Box::new(move |res| {
-            let duration = match SystemTime::now().duration_since(start_time) {
-                Ok(d) => d.as_millis(),
-                Err(_) => 0,
-            };
+            let duration = start_time.elapsed();
             let mut stats = stats_ref.ref_cell.borrow_mut();
             stats.num_finished += 1;
-            stats.last_execution_time = duration;
-            stats.total_execution_time += duration;
+            stats.last_execution_time = duration.as_millis();
+            stats.total_execution_time += duration.as_millis();
+            stats.latency.record(duration);
             if let Err(e) = res {
                 stats.num_failed += 1;
                 stats.last_error = Some(e);
@@ -147,63 +208,227 @@ fn fire_event(
     );
 }
 
+/// A consumer entry on the routing index.
+struct IndexedConsumer {
+    /// Registration order, used to fire the matched consumers
+    /// in the same order they were registered.
+    seq: usize,
+    consumer: Weak<RefCell<NotificationConsumer>>,
+}
+
+impl IndexedConsumer {
+    fn is(&self, consumer: &Arc<RefCell<NotificationConsumer>>) -> bool {
+        std::ptr::eq(self.consumer.as_ptr(), Arc::as_ptr(consumer))
+    }
+}
+
+/// Routes key space notifications to the relevant consumers. Consumers
+/// registered on a key are kept on a hash map and consumers registered
+/// on a prefix are kept on a byte trie, so the dispatch cost depends on
+/// the number of matched consumers and not on the number of registrations.
 pub(crate) struct KeysNotificationsCtx {
-    consumers: Vec<Weak<RefCell<NotificationConsumer>>>,
+    keys: HashMap<Vec<u8>, Vec<IndexedConsumer>>,
+    prefixes: PrefixTrie<IndexedConsumer>,
+    next_seq: usize,
+    has_dead_consumers: Arc<AtomicBool>,
+    /// Consumers with notifications that wait to be delivered.
+    debounced_consumers: RefCell<Vec<Weak<RefCell<NotificationConsumer>>>>,
 }
 
 impl KeysNotificationsCtx {
     pub(crate) fn new() -> KeysNotificationsCtx {
         KeysNotificationsCtx {
-            consumers: Vec::new(),
+            keys: HashMap::new(),
+            prefixes: PrefixTrie::new(),
+            next_seq: 0,
+            has_dead_consumers: Arc::new(AtomicBool::new(false)),
+            debounced_consumers: RefCell::new(Vec::new()),
         }
     }
 
-    pub(crate) fn add_consumer_on_prefix(
+    fn index_consumer(&mut self, key: &ConsumerKey, consumer: IndexedConsumer) {
+        match key {
+            ConsumerKey::Key(k) => self.keys.entry(k.clone()).or_default().push(consumer),
+            ConsumerKey::Prefix(p) => self.prefixes.insert(p, consumer),
+        }
+    }
+
+    fn unindex_consumer(
         &mut self,
-        prefix: &[u8],
+        key: &ConsumerKey,
+        consumer: &Arc<RefCell<NotificationConsumer>>,
+    ) -> Option<IndexedConsumer> {
+        let consumers = match key {
+            ConsumerKey::Key(k) => self.keys.get_mut(k),
+            ConsumerKey::Prefix(p) => self.prefixes.get_mut(p),
+        }?;
+        let index = consumers.iter().position(|c| c.is(consumer))?;
+        let res = consumers.remove(index);
+        if consumers.is_empty() {
+            // empty entries are reclaimed on the next cleanup
+            self.has_dead_consumers.store(true, Ordering::Relaxed);
+        }
+        Some(res)
+    }
+
+    fn add_consumer(
+        &mut self,
+        key: ConsumerKey,
         callback: NotificationCallback,
         description: Option<String>,
     ) -> Arc<RefCell<NotificationConsumer>> {
         let consumer = Arc::new(RefCell::new(NotificationConsumer::new(
-            ConsumerKey::Prefix(prefix.to_vec()),
+            key,
             callback,
             description,
+            &self.has_dead_consumers,
         )));
-        self.consumers.push(Arc::downgrade(&consumer));
+        let indexed_consumer = IndexedConsumer {
+            seq: self.next_seq,
+            consumer: Arc::downgrade(&consumer),
+        };
+        self.next_seq += 1;
+        self.index_consumer(consumer.borrow().key.as_ref().unwrap(), indexed_consumer);
         consumer
     }
 
+    pub(crate) fn add_consumer_on_prefix(
+        &mut self,
+        prefix: &[u8],
+        callback: NotificationCallback,
+        description: Option<String>,
+    ) -> Arc<RefCell<NotificationConsumer>> {
+        self.add_consumer(ConsumerKey::Prefix(prefix.to_vec()), callback, description)
+    }
+
     pub(crate) fn add_consumer_on_key(
         &mut self,
         key: &[u8],
         callback: NotificationCallback,
         description: Option<String>,
     ) -> Arc<RefCell<NotificationConsumer>> {
-        let consumer = Arc::new(RefCell::new(NotificationConsumer::new(
-            ConsumerKey::Key(key.to_vec()),
-            callback,
-            description,
-        )));
-        self.consumers.push(Arc::downgrade(&consumer));
-        consumer
+        self.add_consumer(ConsumerKey::Key(key.to_vec()), callback, description)
+    }
+
+    /// Set the key of an existing consumer (on library upgrade or revert)
+    /// and move it on the routing index. Returns the old key.
+    pub(crate) fn set_consumer_key(
+        &mut self,
+        consumer: &Arc<RefCell<NotificationConsumer>>,
+        key: ConsumerKey,
+    ) -> ConsumerKey {
+        let old_key = consumer.borrow_mut().set_key(key);
+        let indexed_consumer = self
+            .unindex_consumer(&old_key, consumer)
+            .unwrap_or_else(|| {
+                let seq = self.next_seq;
+                self.next_seq += 1;
+                IndexedConsumer {
+                    seq,
+                    consumer: Arc::downgrade(consumer),
+                }
+            });
+        self.index_consumer(consumer.borrow().key.as_ref().unwrap(), indexed_consumer);
+        old_key
+    }
+
+    /// Drop the index entries of consumers that no longer exist.
+    pub(crate) fn remove_dead_consumers(&mut self) {
+        if !self.has_dead_consumers.swap(false, Ordering::Relaxed) {
+            return;
+        }
+        self.keys.retain(|_, consumers| {
+            consumers.retain(|c| c.consumer.strong_count() > 0);
+            !consumers.is_empty()
+        });
+        self.prefixes.retain(&mut |c| c.consumer.strong_count() > 0);
     }
 
     pub(crate) fn on_key_touched(&self, ctx: &Context, event: &str, key: &[u8]) {
-        for consumer in self.consumers.iter() {
-            let consumer = match consumer.upgrade() {
-                Some(c) => c,
-                None => continue,
+        let mut matches = Vec::new();
+        if let Some(consumers) = self.keys.get(key) {
+            matches.extend(consumers.iter());
+        }
+        self.prefixes.for_each_match(key, |c| matches.push(c));
+        if matches.is_empty() {
+            return;
+        }
+        if matches.len() > 1 {
+            matches.sort_unstable_by_key(|c| c.seq);
+        }
+        let consumers = matches
+            .into_iter()
+            .filter_map(|c| c.consumer.upgrade())
+            .filter(|c| c.borrow().is_interested(event, key))
+            .collect::<Vec<_>>();
+        let now = Instant::now();
+        for consumer in consumers {
+            consumer.borrow().stats.ref_cell.borrow_mut().num_events += 1;
+            let debounced = {
+                let mut c = consumer.borrow_mut();
+                let c = &mut *c;
+                c.debounce_config.as_ref().map(|config| {
+                    if !c.flush_scheduled {
+                        c.flush_scheduled = true;
+                        self.debounced_consumers
+                            .borrow_mut()
+                            .push(Arc::downgrade(&consumer));
+                    }
+                    c.debouncer.on_event(event, key, config.max_events, now)
+                })
             };
-            let res = {
-                let c = consumer.borrow_mut();
-                match c.key.as_ref().unwrap() {
-                    ConsumerKey::Key(k) => key == k,
-                    ConsumerKey::Prefix(prefix) => key.starts_with(prefix),
+            match debounced {
+                None => fire_event(ctx, &consumer, event, key),
+                Some(Some(event)) => fire_event(ctx, &consumer, &event, key),
+                Some(None) => (),
+            }
+        }
+    }
+
+    /// Fire the consumers on the debounced keys whose window expired.
+    pub(crate) fn flush_debounced_events(&self, ctx: &Context) {
+        let consumers = std::mem::take(&mut *self.debounced_consumers.borrow_mut());
+        if consumers.is_empty() {
+            return;
+        }
+        let now = Instant::now();
+        let mut still_pending = Vec::new();
+        for consumer in consumers.into_iter().filter_map(|c| c.upgrade()) {
+            let expired = {
+                let mut c = consumer.borrow_mut();
+                let c = &mut *c;
+                // the consumer might no longer be debounced after a library upgrade,
+                // deliver what is left right away.
+                let window = c
+                    .debounce_config
+                    .as_ref()
+                    .map_or(Duration::ZERO, |v| Duration::from_millis(v.window as u64));
+                let expired = c.debouncer.take_expired(window, now);
+                if c.debouncer.is_empty() {
+                    c.flush_scheduled = false;
+                } else {
+                    still_pending.push(Arc::downgrade(&consumer));
                 }
+                expired
             };
-            if res {
-                fire_event(ctx, &consumer, event, key);
+            for (key, event) in expired {
+                fire_event(ctx, &consumer, &event, &key);
             }
         }
+        self.debounced_consumers.borrow_mut().extend(still_pending);
+    }
+
+    /// Drop the debounced notifications, used when the
+    /// notifications should no longer be processed (e.g. on a replica).
+    pub(crate) fn clear_debounced_events(&self) {
+        let consumers = std::mem::take(&mut *self.debounced_consumers.borrow_mut());
+        consumers
+            .into_iter()
+            .filter_map(|c| c.upgrade())
+            .for_each(|c| {
+                let mut c = c.borrow_mut();
+                c.debouncer.clear();
+                c.flush_scheduled = false;
+            });
     }
 }
@@ -13,10 +13,12 @@
 use keys_notifications_ctx::KeySpaceNotificationsCtx;
 use redis_module::redisvalue::RedisValueKey;
 use redis_module::{
-    BlockingCallOptions, CallOptionResp, CallOptionsBuilder, CallResult, ContextFlags, ErrorReply,
-    PromiseCallReply, RedisGILGuard, Version,
+    BlockingCallOptions, CallOptionResp, CallOptionsBuilder, CallResult, ContextFlags,
+    DetachedContextGuard, ErrorReply, PromiseCallReply, RedisGILGuard, Version,
+};
+use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::{
+    BackendCtxInterfaceInitialised, JobPriority,
 };
-use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::BackendCtxInterfaceInitialised;
 use redisgears_plugin_api::redisgears_plugin_api::load_library_ctx::{
     FunctionFlags, InfoSectionData, ModuleInfo,
 };
@@ -26,9 +28,9 @@ use serde::{Deserialize, Serialize};
 
 use config::{
     FatalFailurePolicyConfiguration, DB_LOADING_LOCK_REDIS_TIMEOUT, ENABLE_DEBUG_COMMAND,
-    ERROR_VERBOSITY, EXECUTION_THREADS, FATAL_FAILURE_POLICY, LOCK_REDIS_TIMEOUT, V8_FLAGS,
-    V8_LIBRARY_INITIAL_MEMORY_LIMIT, V8_LIBRARY_INITIAL_MEMORY_USAGE,
-    V8_LIBRARY_MEMORY_USAGE_DELTA, V8_MAX_MEMORY, V8_PLUGIN_PATH,
+    ERROR_VERBOSITY, EXECUTION_THREADS, FATAL_FAILURE_POLICY, LOCK_REDIS_TIMEOUT,
+    STREAM_CHECKPOINT_MAX_ACKS, V8_FLAGS, V8_LIBRARY_INITIAL_MEMORY_LIMIT,
+    V8_LIBRARY_INITIAL_MEMORY_USAGE, V8_LIBRARY_MEMORY_USAGE_DELTA, V8_MAX_MEMORY, V8_PLUGIN_PATH,
 };
 
 use redis_module::raw::RedisModule__Assert;
@@ -50,12 +52,19 @@ use redis_module_macros::{
 };
 
 use redisgears_plugin_api::redisgears_plugin_api::{
-    backend_ctx::BackendCtx, backend_ctx::BackendCtxInterfaceUninitialised,
-    backend_ctx::LibraryFatalFailurePolicy, function_ctx::FunctionCtxInterface,
-    keys_notifications_consumer_ctx::KeysNotificationsConsumerCtxInterface,
-    load_library_ctx::LibraryCtxInterface, load_library_ctx::LoadLibraryCtxInterface,
-    load_library_ctx::RegisteredKeys, load_library_ctx::RemoteFunctionCtx,
-    stream_ctx::StreamCtxInterface, GearsApiError,
+    backend_ctx::BackendCtx,
+    backend_ctx::BackendCtxInterfaceUninitialised,
+    backend_ctx::LibraryFatalFailurePolicy,
+    function_ctx::FunctionCtxInterface,
+    keys_notifications_consumer_ctx::{
+        KeySpaceTriggerDebounceConfig, KeySpaceTriggerFilter, KeysNotificationsConsumerCtxInterface,
+    },
+    load_library_ctx::LibraryCtxInterface,
+    load_library_ctx::LoadLibraryCtxInterface,
+    load_library_ctx::RegisteredKeys,
+    load_library_ctx::RemoteFunctionCtx,
+    stream_ctx::StreamCtxInterface,
+    GearsApiError,
 };
 
 use redisgears_plugin_api::redisgears_plugin_api::{FunctionCallResult, RefCellWrapper};
@@ -64,17 +73,22 @@ use crate::run_ctx::RunCtx;
 
 use libloading::{Library, Symbol};
 
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 
 use std::sync::atomic::Ordering;
-use std::sync::{Arc, Mutex, MutexGuard, Weak};
+use std::sync::{Arc, Mutex, MutexGuard, OnceLock, Weak};
+use std::time::{Duration, Instant};
 
+use crate::stream_checkpoints::{StreamCheckpoint, StreamCheckpoints};
 use crate::stream_reader::{ConsumerData, StreamReaderCtx};
 use std::iter::Skip;
 use std::vec::IntoIter;
 
 use crate::compiled_library_api::CompiledLibraryInternals;
+use crate::executor::Executor;
+use crate::invocation_stats::{FunctionStats, LatencyHistogram};
 use crate::keys_notifications::{KeysNotificationsCtx, NotificationCallback, NotificationConsumer};
+use crate::lock_broker::{LockBroker, LockLease};
 use crate::stream_run_ctx::{GearsStreamConsumer, GearsStreamRecord};
 
 use std::cell::RefCell;
@@ -83,18 +97,29 @@ use crate::keys_notifications::ConsumerKey;
 
 use mr::libmr::mr_init;
 
+mod adaptive_window;
 mod background_run_ctx;
 mod background_run_scope_guard;
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench;
 mod compiled_library_api;
 mod config;
 mod debugging;
+mod executor;
 mod function_del_command;
 mod function_list_command;
 mod function_load_command;
+mod invocation_stats;
+mod key_debouncer;
 mod keys_notifications;
 mod keys_notifications_ctx;
+mod lock_broker;
+mod pending_ids;
+mod prefix_trie;
 mod rdb;
 mod run_ctx;
+mod stream_checkpoints;
 mod stream_reader;
 mod stream_run_ctx;
 
@@ -208,6 +233,7 @@ struct GearsFunctionCtx {
     flags: FunctionFlags,
     is_async: bool,
     description: Option<String>,
+    stats: Arc<FunctionStats>,
 }
 
 impl GearsFunctionCtx {
@@ -222,6 +248,7 @@ impl GearsFunctionCtx {
             flags,
             is_async,
             description,
+            stats: Arc::new(FunctionStats::default()),
         }
     }
 }
@@ -233,6 +260,7 @@ impl std::fmt::Debug for GearsFunctionCtx {
             .field("flags", &self.flags)
             .field("is_async", &self.is_async)
             .field("description", &self.description)
+            .field("stats", &self.stats)
             .finish()
     }
 }
@@ -248,8 +276,14 @@ struct GearsLibraryCtx {
         HashMap<String, Arc<RefCellWrapper<ConsumerData<GearsStreamRecord, GearsStreamConsumer>>>>,
     revert_stream_consumers: Vec<(String, GearsStreamConsumer, usize, bool, Option<String>)>,
     notifications_consumers: HashMap<String, Arc<RefCell<NotificationConsumer>>>,
-    revert_notifications_consumers:
-        Vec<(String, ConsumerKey, NotificationCallback, Option<String>)>,
+    revert_notifications_consumers: Vec<(
+        String,
+        ConsumerKey,
+        NotificationCallback,
+        Option<String>,
+        Option<KeySpaceTriggerFilter>,
+        Option<KeySpaceTriggerDebounceConfig>,
+    )>,
     old_lib: Option<Arc<GearsLibrary>>,
 }
 
@@ -452,16 +486,18 @@ impl<'ctx, 'lib_ctx> LoadLibraryCtxInterface for GearsLoadLibraryCtx<'ctx, 'lib_
                 window,
                 trim,
                 Some(Box::new(move |ctx, stream_name, ms, seq| {
-                    ctx.replicate(
-                        "_rg_internals.update_stream_last_read_id",
-                        &[
-                            lib_name.as_bytes(),
-                            consumer_name.as_bytes(),
-                            stream_name,
-                            ms.to_string().as_bytes(),
-                            seq.to_string().as_bytes(),
-                        ],
+                    let max_acks = STREAM_CHECKPOINT_MAX_ACKS.load(Ordering::Relaxed) as usize;
+                    let checkpoint = get_globals_mut().stream_checkpoints.on_acked(
+                        &lib_name,
+                        &consumer_name,
+                        stream_name,
+                        ms,
+                        seq,
+                        max_acks,
                     );
+                    if let Some(checkpoint) = checkpoint {
+                        replicate_stream_checkpoint(ctx, stream_name, &checkpoint);
+                    }
                 })),
                 description,
             );
@@ -499,6 +535,8 @@ impl<'ctx, 'lib_ctx> LoadLibraryCtxInterface for GearsLoadLibraryCtx<'ctx, 'lib_
             ));
         }
 
+        let filter = keys_notifications_consumer_ctx.filter();
+        let debounce_config = keys_notifications_consumer_ctx.debounce_config();
         let meta_data = Arc::clone(&self.gears_lib_ctx.meta_data);
         let permissions = AclPermissions::all();
         let fire_event_callback: NotificationCallback =
@@ -534,25 +572,35 @@ impl<'ctx, 'lib_ctx> LoadLibraryCtxInterface for GearsLoadLibraryCtx<'ctx, 'lib_
                 .as_ref()
                 .and_then(|v| v.gears_lib_ctx.notifications_consumers.get(name))
         {
-            let mut o_c = old_notification_consumer.borrow_mut();
-            let old_consumer_callback = o_c.set_callback(fire_event_callback);
+            let (old_consumer_callback, old_description, old_filter, old_debounce_config) = {
+                let mut o_c = old_notification_consumer.borrow_mut();
+                (
+                    o_c.set_callback(fire_event_callback),
+                    o_c.set_description(description),
+                    o_c.set_filter(filter),
+                    o_c.set_debounce_config(debounce_config),
+                )
+            };
             let new_key = match key {
                 RegisteredKeys::Key(s) => ConsumerKey::Key(s.to_vec()),
                 RegisteredKeys::Prefix(s) => ConsumerKey::Prefix(s.to_vec()),
             };
-            let old_key = o_c.set_key(new_key);
-            let old_description = o_c.set_description(description);
+            let old_key = get_globals_mut()
+                .notifications_ctx
+                .set_consumer_key(old_notification_consumer, new_key);
             self.gears_lib_ctx.revert_notifications_consumers.push((
                 name.to_string(),
                 old_key,
                 old_consumer_callback,
                 old_description,
+                old_filter,
+                old_debounce_config,
             ));
             Arc::clone(old_notification_consumer)
         } else {
             let globals = get_globals_mut();
 
-            match key {
+            let consumer = match key {
                 RegisteredKeys::Key(k) => globals.notifications_ctx.add_consumer_on_key(
                     k,
                     fire_event_callback,
@@ -563,7 +611,13 @@ impl<'ctx, 'lib_ctx> LoadLibraryCtxInterface for GearsLoadLibraryCtx<'ctx, 'lib_
                     fire_event_callback,
                     description,
                 ),
+            };
+            {
+                let mut c = consumer.borrow_mut();
+                c.set_filter(filter);
+                c.set_debounce_config(debounce_config);
             }
+            consumer
         };
 
         self.gears_lib_ctx
@@ -610,11 +664,20 @@ struct GlobalCtx {
     uninitialised_backends: HashMap<String, Box<dyn BackendCtxInterfaceUninitialised>>,
     /// Holds the handler to the dyn library of all backends, we need to keep it so the handler will not be freed.
     _plugins: Vec<Library>,
-    pool: Mutex<Option<ThreadPool>>,
+    /// The executor which runs the libraries background jobs, created
+    /// on first use.
+    pool: OnceLock<Executor>,
+    /// Grants the Redis lock to background jobs, in batches.
+    lock_broker: LockBroker<DetachedContextGuard>,
     /// Thread pool which used to run management tasks that should not be
     /// starved by user tasks (which run on [`GlobalCtx::pool`]).
     management_pool: RedisGILGuard<Option<ThreadPool>>,
     stream_ctx: StreamReaderCtx<GearsStreamRecord, GearsStreamConsumer>,
+    /// Streams that were touched and wait for a post notification job to process
+    /// them, so that multiple writes to a stream are processed together.
+    touched_streams: HashSet<Vec<u8>>,
+    /// The stream consumers progress that was not yet replicated.
+    stream_checkpoints: StreamCheckpoints,
     notifications_ctx: KeysNotificationsCtx,
     avoid_key_space_notifications: bool,
     allow_unsafe_redis_commands: bool,
@@ -662,8 +725,13 @@ fn get_libraries() -> MutexGuard<'static, HashMap<String, Arc<GearsLibrary>>> {
     get_globals().libraries.lock().unwrap()
 }
 
-pub(crate) fn get_thread_pool() -> MutexGuard<'static, Option<ThreadPool>> {
-    get_globals().pool.lock().unwrap()
+pub(crate) fn get_thread_pool() -> &'static Executor {
+    get_globals().pool.get_or_init(|| {
+        Executor::new(
+            "RGExecutor",
+            EXECUTION_THREADS.load(Ordering::Relaxed) as usize,
+        )
+    })
 }
 
 struct Sentinel;
@@ -682,19 +750,22 @@ impl Drop for Sentinel {
     }
 }
 
-/// Executes the passed job object in a dedicated thread allocated
-/// from the global module thread pool.
-pub(crate) fn execute_on_pool<F: FnOnce() + Send + 'static>(job: F) {
-    let mut pool = get_thread_pool();
-    pool.get_or_insert_with(|| {
-        ThreadPool::with_name(
-            "RGExecutor".to_owned(),
-            EXECUTION_THREADS.load(Ordering::Relaxed) as usize,
-        )
-    })
-    .execute(move || {
-        job();
-    });
+/// Returns the time after which a batch of background jobs holding the
+/// Redis lock stops admitting more jobs, a tenth of the lock timeout.
+fn lock_batch_budget() -> Duration {
+    Duration::from_millis(LOCK_REDIS_TIMEOUT.load(Ordering::Relaxed) as u64 / 10)
+}
+
+/// Locks Redis on behalf of a background job, the lock might be held
+/// by a batch of background jobs which the job will join.
+pub(crate) fn lock_redis_for_background() -> LockLease<DetachedContextGuard> {
+    get_globals().lock_broker.lock()
+}
+
+/// Executes the passed job object with the given priority on a thread
+/// of the global module executor.
+pub(crate) fn execute_on_pool<F: FnOnce() + Send + 'static>(job: F, priority: JobPriority) {
+    get_thread_pool().execute(job, priority);
 }
 
 /// Calls a redis command and returns the value.
@@ -711,6 +782,30 @@ pub(crate) fn call_redis_command(
     ctx.call_ext(command, call_options, args)
 }
 
+/// Calls the given redis commands one after the other, authenticating
+/// the user only once, and returns their results.
+pub(crate) fn call_redis_commands_batch(
+    ctx: &Context,
+    user: &RedisString,
+    call_options: &CallOptions,
+    commands: &[(&str, Vec<&[u8]>)],
+) -> Vec<CallResult<'static>> {
+    let _authenticate_scope = match ctx.authenticate_user(user) {
+        Ok(scope) => scope,
+        Err(e) => {
+            let msg = e.to_string();
+            return commands
+                .iter()
+                .map(|_| Err(ErrorReply::Message(msg.clone())))
+                .collect();
+        }
+    };
+    commands
+        .iter()
+        .map(|(command, args)| ctx.call_ext(command, call_options, args))
+        .collect()
+}
+
 type FutureHandlerContextCallback = dyn FnOnce(&Context, CallResult<'static>);
 type FutureHandlerContextDisposer = dyn FnOnce(&Context, bool);
 
@@ -1048,7 +1143,8 @@ fn js_init(ctx: &Context, _args: &[RedisString]) -> Status {
         backends: HashMap::new(),
         uninitialised_backends: HashMap::from([(v8_backend_name, v8_backend)]),
         _plugins: vec![plugin_lib],
-        pool: Mutex::new(None),
+        pool: OnceLock::new(),
+        lock_broker: LockBroker::new(|| redis_module::MODULE_CONTEXT.lock(), lock_batch_budget),
         management_pool: RedisGILGuard::new(None),
         stream_ctx: StreamReaderCtx::new(
             Box::new(|ctx, key, id, include_id| {
@@ -1102,6 +1198,8 @@ fn js_init(ctx: &Context, _args: &[RedisString]) -> Status {
                 });
             }),
         ),
+        touched_streams: HashSet::new(),
+        stream_checkpoints: StreamCheckpoints::new(),
         notifications_ctx: KeysNotificationsCtx::new(),
         avoid_key_space_notifications: false,
         allow_unsafe_redis_commands: false,
@@ -1169,6 +1267,26 @@ fn build_initialised_backends_info(ctx: &InfoContext) -> RedisResult<()> {
         .try_for_each(|info| build_backend_module_info(ctx, info))
 }
 
+/// Adds the percentiles of the given latency histogram to the library
+/// information, in microseconds.
+fn add_latency_info(
+    library_info: &mut HashMap<String, String>,
+    prefix: &str,
+    latency: &LatencyHistogram,
+) {
+    let summary = latency.summary();
+    [
+        ("p50", summary.p50_us),
+        ("p99", summary.p99_us),
+        ("p999", summary.p999_us),
+        ("max", summary.max_us),
+    ]
+    .into_iter()
+    .for_each(|(name, value)| {
+        library_info.insert(format!("{prefix}_{name}_us"), value.to_string());
+    });
+}
+
 fn build_per_library_info(ctx: &InfoContext) -> RedisResult<()> {
     let libraries = get_globals().libraries.lock()?;
     if libraries.is_empty() {
@@ -1245,6 +1363,61 @@ fn build_per_library_info(ctx: &InfoContext) -> RedisResult<()> {
             library.1.gears_lib_ctx.remote_functions.len().to_string(),
         );
 
+        let functions = library.1.gears_lib_ctx.functions.values();
+        let functions_latency = LatencyHistogram::new();
+        let functions_async_wait = LatencyHistogram::new();
+        let (functions_calls, functions_errors) = functions.fold((0, 0), |(calls, errors), f| {
+            functions_latency.merge(&f.stats.latency);
+            functions_async_wait.merge(&f.stats.async_wait);
+            (
+                calls + f.stats.calls.load(Ordering::Relaxed),
+                errors + f.stats.errors.load(Ordering::Relaxed),
+            )
+        });
+        library_info.insert("functions_calls".to_owned(), functions_calls.to_string());
+        library_info.insert("functions_errors".to_owned(), functions_errors.to_string());
+        add_latency_info(&mut library_info, "functions_latency", &functions_latency);
+        add_latency_info(
+            &mut library_info,
+            "functions_async_wait",
+            &functions_async_wait,
+        );
+
+        let triggers_latency = LatencyHistogram::new();
+        let mut triggers_calls = 0;
+        let mut triggers_failures = 0;
+        library
+            .1
+            .gears_lib_ctx
+            .notifications_consumers
+            .values()
+            .for_each(|c| {
+                let stats = c.borrow().get_stats();
+                triggers_latency.merge(&stats.latency);
+                triggers_calls += stats.num_trigger;
+                triggers_failures += stats.num_failed;
+            });
+        library
+            .1
+            .gears_lib_ctx
+            .stream_consumers
+            .values()
+            .for_each(|c| {
+                let c = c.ref_cell.borrow();
+                triggers_latency.merge(&c.latency);
+                c.consumed_streams.values().for_each(|s| {
+                    let s = s.ref_cell.borrow();
+                    triggers_calls += s.records_processed;
+                    triggers_failures += s.records_failed;
+                });
+            });
+        library_info.insert("triggers_calls".to_owned(), triggers_calls.to_string());
+        library_info.insert(
+            "triggers_failures".to_owned(),
+            triggers_failures.to_string(),
+        );
+        add_latency_info(&mut library_info, "triggers_latency", &triggers_latency);
+
         if let Some(info) = library.1.lib_ctx.get_info() {
             if let Some(first_level) = info.sections.into_iter().next() {
                 if let InfoSectionData::KeyValuePairs(key_value_pairs) = first_level.1 {
@@ -1274,11 +1447,95 @@ fn build_per_library_info(ctx: &InfoContext) -> RedisResult<()> {
     Ok(())
 }
 
+fn build_executor_info(ctx: &InfoContext) -> RedisResult<()> {
+    let stats = match get_globals().pool.get() {
+        Some(executor) => executor.stats(),
+        None => return Ok(()),
+    };
+
+    let section_builder = ctx
+        .builder()
+        .add_section("Executor")
+        .field("threads", stats.threads.to_string())?
+        .field("stolen_jobs", stats.stolen_jobs.to_string())?
+        .field("panicked_jobs", stats.panicked_jobs.to_string())?;
+
+    let section_builder = [
+        ("high_priority", stats.high_priority),
+        ("low_priority", stats.low_priority),
+    ]
+    .into_iter()
+    .try_fold(section_builder, |section_builder, (name, jobs_stats)| {
+        section_builder
+            .field(
+                &format!("{name}_pending_jobs"),
+                jobs_stats.pending_jobs.to_string(),
+            )?
+            .field(
+                &format!("{name}_executed_jobs"),
+                jobs_stats.executed_jobs.to_string(),
+            )?
+            .field(
+                &format!("{name}_avg_wait_time_us"),
+                jobs_stats.avg_wait_time_us().to_string(),
+            )?
+            .field(
+                &format!("{name}_max_wait_time_us"),
+                jobs_stats.max_wait_time_us.to_string(),
+            )
+    })?;
+
+    let _ = section_builder.build_section()?.build_info()?;
+
+    Ok(())
+}
+
+fn build_lock_broker_info(ctx: &InfoContext) -> RedisResult<()> {
+    let stats = get_globals().lock_broker.stats();
+    if stats.batches == 0 {
+        return Ok(());
+    }
+
+    let _ = ctx
+        .builder()
+        .add_section("BackgroundLock")
+        .field("batches", stats.batches.to_string())?
+        .field("locks", stats.locks.to_string())?
+        .field("avg_batch_size", stats.avg_batch_size().to_string())?
+        .field("max_batch_size", stats.max_batch_size.to_string())?
+        .field("avg_hold_time_us", stats.avg_hold_time_us().to_string())?
+        .field("max_hold_time_us", stats.max_hold_time_us.to_string())?
+        .build_section()?
+        .build_info()?;
+
+    Ok(())
+}
+
+fn build_remote_tasks_info(ctx: &InfoContext) -> RedisResult<()> {
+    let stats = background_run_ctx::remote_tasks_stats();
+    if stats.tasks == 0 {
+        return Ok(());
+    }
+
+    let _ = ctx
+        .builder()
+        .add_section("RemoteTasks")
+        .field("executed_tasks", stats.tasks.to_string())?
+        .field("executed_keys", stats.keys.to_string())?
+        .build_section()?
+        .build_info()?;
+
+    Ok(())
+}
+
 #[info_command_handler]
 fn module_info(ctx: &InfoContext, _for_crash_report: bool) -> RedisResult<()> {
     build_uninitialised_backends_info(ctx)?;
     build_initialised_backends_info(ctx)?;
     build_per_library_info(ctx)?;
+    build_executor_info(ctx)?;
+    build_lock_broker_info(ctx)?;
+    build_remote_tasks_info(ctx)?;
 
     Ok(())
 }
@@ -1367,13 +1624,17 @@ fn function_call_command(
 
     {
         let _notification_blocker = get_notification_blocker();
+        function.stats.on_call();
+        let start_time = Instant::now();
         let res = function.func.call(&RunCtx {
             ctx,
             args,
             flags: function.flags,
             lib_meta_data: Arc::clone(&lib.gears_lib_ctx.meta_data),
             allow_block,
+            stats: &function.stats,
         });
+        function.stats.latency.record(start_time.elapsed());
         if matches!(res, FunctionCallResult::Hold) && !allow_block {
             // If we reach here, it means that the plugin violates the API, it blocked the client even though it is not allow to.
             log::warn!(
@@ -1431,7 +1692,7 @@ fn function_debug_command(
     let backend_name = args.next_arg()?.try_as_str()?;
     match backend_name {
         "panic_on_thread_pool" => {
-            execute_on_pool(|| panic!("debug panic"));
+            execute_on_pool(|| panic!("debug panic"), JobPriority::High);
             return Ok(RedisValue::SimpleStringStatic("OK"));
         }
         "allow_unsafe_redis_commands" => {
@@ -1507,24 +1768,80 @@ fn function_debug_command(
         .map_err(|e| RedisError::String(e.get_msg().to_string()))
 }
 
-fn on_stream_touched(ctx: &Context, _event_type: NotifyEvent, event: &str, key: &[u8]) {
-    if is_master(ctx) {
-        let key = key.to_vec();
-        let event = event.to_owned();
-        ctx.add_post_notification_job(move |ctx| {
-            let stream_ctx = &mut get_globals_mut().stream_ctx;
-            stream_ctx.on_stream_touched(ctx, &event, &key);
+fn replicate_stream_checkpoint(ctx: &Context, stream_name: &[u8], checkpoint: &StreamCheckpoint) {
+    ctx.replicate(
+        "_rg_internals.update_stream_last_read_id",
+        &[
+            checkpoint.library.as_bytes(),
+            checkpoint.consumer.as_bytes(),
+            stream_name,
+            checkpoint.ms.to_string().as_bytes(),
+            checkpoint.seq.to_string().as_bytes(),
+        ],
+    );
+}
+
+/// Replicate the progress of the stream consumers that was accumulated since the last call.
+fn replicate_stream_checkpoints(ctx: &Context) {
+    let checkpoints = get_globals_mut().stream_checkpoints.take();
+    if checkpoints.is_empty() || !is_master(ctx) || ctx.avoid_replication_traffic() {
+        // an instance that is no longer a master should not replicate an old progress.
+        return;
+    }
+    let libraries = get_libraries();
+    checkpoints
+        .into_iter()
+        .filter(|(_, checkpoint)| {
+            // the library or the consumer might have been deleted since.
+            libraries.get(&checkpoint.library).map_or(false, |l| {
+                l.gears_lib_ctx
+                    .stream_consumers
+                    .contains_key(&checkpoint.consumer)
+            })
+        })
+        .for_each(|(stream_name, checkpoint)| {
+            replicate_stream_checkpoint(ctx, &stream_name, &checkpoint)
         });
+}
+
+fn on_stream_touched(ctx: &Context, _event_type: NotifyEvent, event: &str, key: &[u8]) {
+    if !is_master(ctx) {
+        return;
+    }
+    let globals = get_globals_mut();
+    if globals.touched_streams.contains(key) {
+        // a job that will process the stream is already pending.
+        return;
+    }
+    let key = key.to_vec();
+    let job_key = key.clone();
+    let event = event.to_owned();
+    let res = ctx.add_post_notification_job(move |ctx| {
+        let globals = get_globals_mut();
+        // removed before processing the stream so that records added
+        // by the consumers will schedule another job.
+        globals.touched_streams.remove(&job_key);
+        globals.stream_ctx.on_stream_touched(ctx, &event, &job_key);
+    });
+    if res == Status::Ok {
+        globals.touched_streams.insert(key);
     }
 }
 
 fn generic_notification(ctx: &Context, _event_type: NotifyEvent, event: &str, key: &[u8]) {
-    if event == "del" {
+    if (event == "del"
+        || event == "expired"
+        || event == "evicted"
+        || event == "rename_from"
+        || event == "move_from")
+        && get_globals().stream_ctx.is_stream_tracked(key)
+    {
         let event = event.to_owned();
         let key = key.to_vec();
         ctx.add_post_notification_job(move |_ctx| {
-            let stream_ctx = &mut get_globals_mut().stream_ctx;
-            stream_ctx.on_stream_deleted(&event, &key);
+            let globals = get_globals_mut();
+            globals.stream_ctx.on_stream_deleted(&event, &key);
+            globals.stream_checkpoints.on_stream_deleted(&key);
         });
     }
 }
@@ -1651,7 +1968,11 @@ fn on_config_change(ctx: &Context, values: &[&str]) {
 }
 
 /// Will be called by Redis to execute some repeated tasks.
-/// Currently we will clean future handlers that has been finished.
+/// Currently we will clean future handlers that has been finished,
+/// drop dead key space and stream triggers from the routing indexes,
+/// reclaim streams that are no longer consumed or no longer exist, flush stream batches
+/// that reached their max delay, trim the acknowledged streams and
+/// replicate the stream consumers progress.
 #[cron_event_handler]
 fn cron_event_handler(ctx: &Context, _hz: u64) {
     let globals = get_globals_mut();
@@ -1682,6 +2003,30 @@ fn cron_event_handler(ctx: &Context, _hz: u64) {
     }
     globals.avoid_replication_traffic = ctx.avoid_replication_traffic();
 
+    globals.notifications_ctx.remove_dead_consumers();
+    globals.stream_ctx.remove_dead_consumers();
+
+    if is_master(ctx) && !globals.avoid_replication_traffic {
+        // deliver stream batches that waited long enough to fill up.
+        globals.stream_ctx.flush_expired_batches(ctx);
+        // trim the streams once per tick instead of on every acknowledgement.
+        globals.stream_ctx.trim_pending_streams(ctx);
+        // forget the idle streams that were deleted without a notification.
+        globals
+            .stream_ctx
+            .reclaim_idle_streams(ctx)
+            .iter()
+            .for_each(|stream| globals.stream_checkpoints.on_stream_deleted(stream));
+    }
+    if is_master(ctx) {
+        // deliver the debounced key space notifications whose window expired.
+        globals.notifications_ctx.flush_debounced_events(ctx);
+    } else {
+        // notifications are not fired on a replica.
+        globals.notifications_ctx.clear_debounced_events();
+    }
+    replicate_stream_checkpoints(ctx);
+
     let mut should_stop_debugger = false;
     if let Some(debugger_backend) = globals.debugger_server.as_mut() {
         match debugger_backend.process_events(ctx) {
@@ -1903,7 +2248,7 @@ mod gears_module {
         commands: [],
         event_handlers: [
             [@STREAM: on_stream_touched],
-            [@GENERIC: generic_notification],
+            [@GENERIC @EXPIRED @EVICTED: generic_notification],
             [@ALL @MISSED: key_space_notification],
         ]
         configurations:[
@@ -1913,6 +2258,7 @@ mod gears_module {
                 ["remote-task-default-timeout", &*REMOTE_TASK_DEFAULT_TIMEOUT , 500, 1, i64::MAX, ConfigurationFlags::DEFAULT, None],
                 ["lock-redis-timeout", &*LOCK_REDIS_TIMEOUT , 500, 100, 1000000000, ConfigurationFlags::DEFAULT, None],
                 ["db-loading-lock-redis-timeout", &*DB_LOADING_LOCK_REDIS_TIMEOUT , 30000, 100, 1000000000, ConfigurationFlags::DEFAULT, None],
+                ["stream-checkpoint-max-acks", &*STREAM_CHECKPOINT_MAX_ACKS , 1000, 1, 1000000000, ConfigurationFlags::DEFAULT, None],
 
                 [
                     "v8-maxmemory",
@@ -0,0 +1,337 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Group acquisition of the Redis lock for background jobs.
+//!
+//! The first background job which asks for the lock becomes the batch
+//! leader and acquires the lock. Jobs which ask for the lock while the
+//! leader holds it are queued. When the leader is done, instead of
+//! releasing the lock, it grants the lock to the queued jobs one after
+//! the other until no job is waiting or the batch time budget is
+//! exhausted. Only then the lock is released, and if jobs are still
+//! waiting, the first of them becomes the leader of the next batch.
+//!
+//! The lock is always acquired and released by the leader thread, the
+//! other jobs of the batch run under it.
+
+use std::collections::VecDeque;
+use std::ops::Deref;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Condvar, Mutex};
+use std::time::{Duration, Instant};
+
+type Ticket = u64;
+
+/// A pointer to the lock guard held by the batch leader.
+struct GuardPtr<G>(*const G);
+
+unsafe impl<G> Send for GuardPtr<G> {}
+
+struct BrokerState<G> {
+    /// Whether or not a batch is in progress (or its leader is acquiring the lock).
+    batch_in_progress: bool,
+    next_ticket: Ticket,
+    /// The jobs waiting for the lock, in arrival order.
+    waiters: VecDeque<Ticket>,
+    /// The waiter which was granted the lock by the leader.
+    granted: Option<(Ticket, GuardPtr<G>)>,
+    /// The waiter which should lead the next batch.
+    next_leader: Option<Ticket>,
+}
+
+#[derive(Default)]
+struct BrokerCounters {
+    batches: AtomicU64,
+    locks: AtomicU64,
+    max_batch_size: AtomicU64,
+    total_hold_time_us: AtomicU64,
+    max_hold_time_us: AtomicU64,
+}
+
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub(crate) struct LockBrokerStats {
+    pub(crate) batches: u64,
+    /// The number of times the lock was granted, over all batches.
+    pub(crate) locks: u64,
+    pub(crate) max_batch_size: u64,
+    /// The total time the lock was held, over all batches.
+    pub(crate) total_hold_time_us: u64,
+    pub(crate) max_hold_time_us: u64,
+}
+
+impl LockBrokerStats {
+    pub(crate) fn avg_batch_size(&self) -> u64 {
+        self.locks.checked_div(self.batches).unwrap_or(0)
+    }
+
+    pub(crate) fn avg_hold_time_us(&self) -> u64 {
+        self.total_hold_time_us
+            .checked_div(self.batches)
+            .unwrap_or(0)
+    }
+}
+
+pub(crate) struct LockBroker<G> {
+    /// Acquires the lock, the lock is released when the returned guard is dropped.
+    acquire: fn() -> G,
+    /// Returns the time after which the leader stops granting the lock
+    /// to the waiting jobs.
+    batch_budget: fn() -> Duration,
+    state: Mutex<BrokerState<G>>,
+    state_changed: Condvar,
+    counters: BrokerCounters,
+}
+
+enum LeaseKind<G> {
+    Leader { guard: Box<G>, batch_start: Instant },
+    Follower { ticket: Ticket, guard: *const G },
+}
+
+/// Gives access to the lock guard, the lock is given back to the broker
+/// on drop.
+pub(crate) struct LockLease<G: 'static> {
+    broker: &'static LockBroker<G>,
+    kind: Option<LeaseKind<G>>,
+}
+
+impl<G> Deref for LockLease<G> {
+    type Target = G;
+
+    fn deref(&self) -> &G {
+        match self.kind.as_ref().unwrap() {
+            LeaseKind::Leader { guard, .. } => guard,
+            // The leader keeps the guard until the lease is dropped.
+            LeaseKind::Follower { guard, .. } => unsafe { &**guard },
+        }
+    }
+}
+
+impl<G> Drop for LockLease<G> {
+    fn drop(&mut self) {
+        match self.kind.take().unwrap() {
+            LeaseKind::Leader { guard, batch_start } => {
+                self.broker.run_batch(&guard, batch_start);
+                // Release the lock only after the batch state was updated,
+                // so the next leader will only acquire it after us.
+                drop(guard);
+            }
+            LeaseKind::Follower { ticket, .. } => {
+                let mut state = self.broker.state.lock().unwrap();
+                debug_assert!(matches!(state.granted, Some((t, _)) if t == ticket));
+                state.granted = None;
+                self.broker.state_changed.notify_all();
+            }
+        }
+    }
+}
+
+impl<G> LockBroker<G> {
+    pub(crate) const fn new(acquire: fn() -> G, batch_budget: fn() -> Duration) -> LockBroker<G> {
+        LockBroker {
+            acquire,
+            batch_budget,
+            state: Mutex::new(BrokerState {
+                batch_in_progress: false,
+                next_ticket: 0,
+                waiters: VecDeque::new(),
+                granted: None,
+                next_leader: None,
+            }),
+            state_changed: Condvar::new(),
+            counters: BrokerCounters {
+                batches: AtomicU64::new(0),
+                locks: AtomicU64::new(0),
+                max_batch_size: AtomicU64::new(0),
+                total_hold_time_us: AtomicU64::new(0),
+                max_hold_time_us: AtomicU64::new(0),
+            },
+        }
+    }
+
+    /// Waits until the lock is held on behalf of the caller.
+    pub(crate) fn lock(&'static self) -> LockLease<G> {
+        let ticket = {
+            let mut state = self.state.lock().unwrap();
+            if !state.batch_in_progress {
+                state.batch_in_progress = true;
+                None
+            } else {
+                let ticket = state.next_ticket;
+                state.next_ticket += 1;
+                state.waiters.push_back(ticket);
+                Some(ticket)
+            }
+        };
+
+        let ticket = match ticket {
+            Some(ticket) => ticket,
+            None => return self.lead_batch(),
+        };
+
+        let mut state = self
+            .state_changed
+            .wait_while(self.state.lock().unwrap(), |state| {
+                !matches!(state.granted, Some((t, _)) if t == ticket)
+                    && state.next_leader != Some(ticket)
+            })
+            .unwrap();
+        if state.next_leader == Some(ticket) {
+            state.next_leader = None;
+            drop(state);
+            return self.lead_batch();
+        }
+        let guard = state.granted.as_ref().unwrap().1 .0;
+        LockLease {
+            broker: self,
+            kind: Some(LeaseKind::Follower { ticket, guard }),
+        }
+    }
+
+    fn lead_batch(&'static self) -> LockLease<G> {
+        let guard = Box::new((self.acquire)());
+        LockLease {
+            broker: self,
+            kind: Some(LeaseKind::Leader {
+                guard,
+                batch_start: Instant::now(),
+            }),
+        }
+    }
+
+    /// Grants the lock to the waiting jobs, called by the leader once it
+    /// is done with the lock.
+    fn run_batch(&self, guard: &G, batch_start: Instant) {
+        let batch_budget = (self.batch_budget)();
+        let mut batch_size = 1;
+        let mut state = self.state.lock().unwrap();
+        while batch_start.elapsed() < batch_budget {
+            let ticket = match state.waiters.pop_front() {
+                Some(ticket) => ticket,
+                None => break,
+            };
+            state.granted = Some((ticket, GuardPtr(guard as *const G)));
+            self.state_changed.notify_all();
+            state = self
+                .state_changed
+                .wait_while(state, |state| state.granted.is_some())
+                .unwrap();
+            batch_size += 1;
+        }
+
+        match state.waiters.pop_front() {
+            Some(ticket) => state.next_leader = Some(ticket),
+            None => state.batch_in_progress = false,
+        }
+        self.state_changed.notify_all();
+        drop(state);
+
+        let hold_time_us = batch_start.elapsed().as_micros() as u64;
+        self.counters.batches.fetch_add(1, Ordering::Relaxed);
+        self.counters.locks.fetch_add(batch_size, Ordering::Relaxed);
+        self.counters
+            .max_batch_size
+            .fetch_max(batch_size, Ordering::Relaxed);
+        self.counters
+            .total_hold_time_us
+            .fetch_add(hold_time_us, Ordering::Relaxed);
+        self.counters
+            .max_hold_time_us
+            .fetch_max(hold_time_us, Ordering::Relaxed);
+    }
+
+    pub(crate) fn stats(&self) -> LockBrokerStats {
+        LockBrokerStats {
+            batches: self.counters.batches.load(Ordering::Relaxed),
+            locks: self.counters.locks.load(Ordering::Relaxed),
+            max_batch_size: self.counters.max_batch_size.load(Ordering::Relaxed),
+            total_hold_time_us: self.counters.total_hold_time_us.load(Ordering::Relaxed),
+            max_hold_time_us: self.counters.max_hold_time_us.load(Ordering::Relaxed),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::mpsc::channel;
+    use std::sync::MutexGuard;
+
+    type TestBroker = LockBroker<MutexGuard<'static, u64>>;
+
+    /// Creates a broker owned by the calling test, so the stats and the
+    /// batch state are not shared with the other tests.
+    fn new_broker(
+        acquire: fn() -> MutexGuard<'static, u64>,
+        batch_budget: fn() -> Duration,
+    ) -> &'static TestBroker {
+        Box::leak(Box::new(LockBroker::new(acquire, batch_budget)))
+    }
+
+    /// Holds the lock with a leader while the given amount of jobs
+    /// queue up, then releases it. Returns the amount of jobs which
+    /// ran under the lock.
+    fn run_jobs(broker: &'static TestBroker, jobs: usize) -> usize {
+        let (sender, receiver) = channel();
+        let leader = broker.lock();
+        let threads = (0..jobs)
+            .map(|_| {
+                let sender = sender.clone();
+                std::thread::spawn(move || {
+                    let lease = broker.lock();
+                    sender.send(**lease).unwrap();
+                })
+            })
+            .collect::<Vec<_>>();
+        // wait for all the jobs to queue up
+        while broker.state.lock().unwrap().waiters.len() < jobs {
+            std::thread::yield_now();
+        }
+        drop(leader);
+        threads.into_iter().for_each(|t| t.join().unwrap());
+        drop(sender);
+        receiver.iter().count()
+    }
+
+    #[test]
+    fn test_batch() {
+        static LOCK: Mutex<u64> = Mutex::new(0);
+        fn acquire() -> MutexGuard<'static, u64> {
+            LOCK.lock().unwrap()
+        }
+        fn budget() -> Duration {
+            Duration::from_secs(10)
+        }
+
+        let broker = new_broker(acquire, budget);
+        assert_eq!(run_jobs(broker, 10), 10);
+        let stats = broker.stats();
+        assert_eq!(stats.batches, 1);
+        assert_eq!(stats.locks, 11);
+        assert_eq!(stats.max_batch_size, 11);
+        assert_eq!(stats.avg_batch_size(), 11);
+        assert!(!broker.state.lock().unwrap().batch_in_progress);
+    }
+
+    #[test]
+    fn test_budget_exhausted() {
+        static LOCK: Mutex<u64> = Mutex::new(0);
+        fn acquire() -> MutexGuard<'static, u64> {
+            LOCK.lock().unwrap()
+        }
+        fn no_budget() -> Duration {
+            Duration::ZERO
+        }
+
+        // Each job leads its own batch, the lock is released in between.
+        let broker = new_broker(acquire, no_budget);
+        assert_eq!(run_jobs(broker, 5), 5);
+        let stats = broker.stats();
+        assert_eq!(stats.batches, 6);
+        assert_eq!(stats.locks, 6);
+        assert_eq!(stats.max_batch_size, 1);
+        assert!(!broker.state.lock().unwrap().batch_in_progress);
+    }
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Tracking of stream ids that were sent to a consumer and are not yet
+//! acknowledged.
+//!
+//! Stream ids are always added in increasing order, so the pending ids
+//! are kept on a ring of slots ordered by id. Each added id gets a token,
+//! tokens are increasing too. As long as the ring was not compacted a
+//! token directly maps to its slot, allowing to acknowledge an id in O(1)
+//! regardless of the acknowledgement order. Acknowledged slots at the
+//! front of the ring are reclaimed right away, so the first slot always
+//! holds the lowest pending id.
+//!
+//! While the lowest id is pending, the slots of the ids acknowledged
+//! after it can not be reclaimed from the front. Once those slots
+//! outnumber the pending ids the ring is compacted, which bounds the
+//! amount of slots to about twice the amount of pending ids. After a
+//! compaction, slots are located by a binary search on their token.
+
+use redis_module::raw::RedisModuleStreamID;
+
+use std::collections::VecDeque;
+
+/// A token returned when adding a pending id, used to acknowledge it.
+pub(crate) type PendingIdToken = u64;
+
+/// Acknowledged slots are never compacted below this amount, so that
+/// small rings are not compacted over and over.
+const MIN_SLOTS_TO_COMPACT: usize = 64;
+
+#[derive(Debug, Clone)]
+struct Slot {
+    token: PendingIdToken,
+    /// `None` indicates an acknowledged id which was not yet reclaimed.
+    id: Option<RedisModuleStreamID>,
+}
+
+#[derive(Debug, Clone, Default)]
+pub(crate) struct PendingIds {
+    /// Slots ordered by token (and so by id).
+    slots: VecDeque<Slot>,
+    /// The token of the next added id.
+    next_token: PendingIdToken,
+    /// Amount of ids which are not yet acknowledged.
+    len: usize,
+}
+
+impl PendingIds {
+    pub(crate) fn new() -> PendingIds {
+        PendingIds::default()
+    }
+
+    /// Add a new pending id, the id must be greater than all the ids
+    /// that were previously added.
+    pub(crate) fn push(&mut self, id: RedisModuleStreamID) -> PendingIdToken {
+        let token = self.next_token;
+        self.next_token += 1;
+        self.slots.push_back(Slot {
+            token,
+            id: Some(id),
+        });
+        self.len += 1;
+        token
+    }
+
+    /// Return the index of the slot of the given token, if it was not yet reclaimed.
+    fn slot_index(&self, token: PendingIdToken) -> Option<usize> {
+        let head = self.slots.front()?.token;
+        if token < head {
+            return None;
+        }
+        // the direct mapping holds until the slots before the token are compacted.
+        let index = (token - head) as usize;
+        if matches!(self.slots.get(index), Some(slot) if slot.token == token) {
+            return Some(index);
+        }
+        self.slots
+            .binary_search_by_key(&token, |slot| slot.token)
+            .ok()
+    }
+
+    /// Acknowledge the id represented by the given token. Return `true`
+    /// if the acknowledged id was the lowest pending id.
+    pub(crate) fn ack(&mut self, token: PendingIdToken) -> bool {
+        let index = match self.slot_index(token) {
+            Some(index) if self.slots[index].id.is_some() => index,
+            _ => return false,
+        };
+        self.slots[index].id = None;
+        self.len -= 1;
+        if index != 0 {
+            self.compact();
+            return false;
+        }
+        while let Some(Slot { id: None, .. }) = self.slots.front() {
+            self.slots.pop_front();
+        }
+        true
+    }
+
+    /// Drop the acknowledged slots once they outnumber the pending ids.
+    /// Each compaction follows at least as many acknowledgements as the
+    /// slots it visits, so its cost is amortized over them.
+    fn compact(&mut self) {
+        let acked = self.slots.len() - self.len;
+        if acked < MIN_SLOTS_TO_COMPACT || acked <= self.len {
+            return;
+        }
+        self.slots.retain(|slot| slot.id.is_some());
+    }
+
+    /// Release the memory of the slots that are no longer used, to be
+    /// called once the ids are not expected to be added for a while.
+    pub(crate) fn shrink_to_fit(&mut self) {
+        self.slots.shrink_to_fit();
+    }
+
+    /// Return the lowest pending id.
+    pub(crate) fn front(&self) -> Option<&RedisModuleStreamID> {
+        self.slots.front().and_then(|slot| slot.id.as_ref())
+    }
+
+    /// Amount of ids which are not yet acknowledged.
+    pub(crate) fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Iterate the pending ids in increasing order, in O(pending ids).
+    pub(crate) fn iter(&self) -> impl Iterator<Item = &RedisModuleStreamID> {
+        self.slots.iter().filter_map(|slot| slot.id.as_ref())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn id(ms: u64) -> RedisModuleStreamID {
+        RedisModuleStreamID { ms, seq: 0 }
+    }
+
+    #[test]
+    fn test_in_order_ack() {
+        let mut pending = PendingIds::new();
+        let tokens = (1..=3).map(|i| pending.push(id(i))).collect::<Vec<_>>();
+        assert_eq!(pending.len(), 3);
+        assert_eq!(pending.front().map(|v| v.ms), Some(1));
+        assert!(pending.ack(tokens[0]));
+        assert_eq!(pending.front().map(|v| v.ms), Some(2));
+        assert!(pending.ack(tokens[1]));
+        assert!(pending.ack(tokens[2]));
+        assert_eq!(pending.len(), 0);
+        assert!(pending.front().is_none());
+    }
+
+    #[test]
+    fn test_out_of_order_ack() {
+        let mut pending = PendingIds::new();
+        let tokens = (1..=4).map(|i| pending.push(id(i))).collect::<Vec<_>>();
+        assert!(!pending.ack(tokens[2]));
+        assert!(!pending.ack(tokens[1]));
+        assert_eq!(pending.len(), 2);
+        assert_eq!(pending.iter().map(|v| v.ms).collect::<Vec<_>>(), vec![1, 4]);
+        assert!(pending.ack(tokens[0]));
+        assert_eq!(pending.front().map(|v| v.ms), Some(4));
+        assert_eq!(pending.len(), 1);
+    }
+
+    #[test]
+    fn test_double_ack() {
+        let mut pending = PendingIds::new();
+        let t1 = pending.push(id(1));
+        let t2 = pending.push(id(2));
+        assert!(!pending.ack(t2));
+        assert!(!pending.ack(t2));
+        assert!(pending.ack(t1));
+        assert!(!pending.ack(t1));
+        assert_eq!(pending.len(), 0);
+        let t3 = pending.push(id(3));
+        assert_eq!(t3, 2);
+        assert!(pending.ack(t3));
+    }
+
+    #[test]
+    fn test_stuck_first_id() {
+        let mut pending = PendingIds::new();
+        let first = pending.push(id(0));
+        // a first id which is never acknowledged should not pin the slots after it.
+        let mut tokens = VecDeque::new();
+        for i in 1..=100_000 {
+            tokens.push_back(pending.push(id(i)));
+            if tokens.len() > 10 {
+                assert!(!pending.ack(tokens.pop_front().unwrap()));
+            }
+            assert!(pending.slots.len() <= 2 * pending.len() + MIN_SLOTS_TO_COMPACT);
+        }
+        assert_eq!(pending.len(), 11);
+        assert_eq!(pending.iter().count(), 11);
+        assert_eq!(pending.front().map(|v| v.ms), Some(0));
+
+        // acknowledging after a compaction locates the slots by their token.
+        let last = tokens.pop_back().unwrap();
+        assert!(!pending.ack(last));
+        assert!(!pending.ack(last));
+        assert!(pending.ack(first));
+        assert_eq!(pending.front().map(|v| v.ms), Some(99_991));
+        tokens.into_iter().for_each(|t| {
+            pending.ack(t);
+        });
+        assert_eq!(pending.len(), 0);
+        assert!(pending.front().is_none());
+        assert!(pending.slots.is_empty());
+    }
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! A byte trie used to route keys to the entries registered on
+//! one of their prefixes.
+
+/// A byte trie node, each node holds the values registered on the
+/// prefix leading to it.
+#[derive(Debug)]
+pub(crate) struct PrefixTrie<V> {
+    values: Vec<V>,
+    children: Vec<(u8, PrefixTrie<V>)>, // sorted by the byte value
+}
+
+impl<V> Default for PrefixTrie<V> {
+    fn default() -> Self {
+        PrefixTrie {
+            values: Vec::new(),
+            children: Vec::new(),
+        }
+    }
+}
+
+impl<V> PrefixTrie<V> {
+    pub(crate) fn new() -> PrefixTrie<V> {
+        PrefixTrie::default()
+    }
+
+    /// Return the values registered on exactly the given prefix,
+    /// creating the path to it if needed.
+    pub(crate) fn get_or_create(&mut self, prefix: &[u8]) -> &mut Vec<V> {
+        let node = prefix.iter().fold(self, |node, b| {
+            let index = match node.children.binary_search_by_key(b, |(c, _)| *c) {
+                Ok(i) => i,
+                Err(i) => {
+                    node.children.insert(i, (*b, PrefixTrie::default()));
+                    i
+                }
+            };
+            &mut node.children[index].1
+        });
+        &mut node.values
+    }
+
+    /// Return the values registered on exactly the given prefix.
+    pub(crate) fn get_mut(&mut self, prefix: &[u8]) -> Option<&mut Vec<V>> {
+        let node = prefix.iter().try_fold(self, |node, b| {
+            let index = node.children.binary_search_by_key(b, |(c, _)| *c).ok()?;
+            Some(&mut node.children[index].1)
+        })?;
+        Some(&mut node.values)
+    }
+
+    pub(crate) fn insert(&mut self, prefix: &[u8], value: V) {
+        self.get_or_create(prefix).push(value);
+    }
+
+    /// Call the given callback on all the values registered on
+    /// a prefix of the given key, shorter prefixes first.
+    pub(crate) fn for_each_match<'a>(&'a self, key: &[u8], mut f: impl FnMut(&'a V)) {
+        let mut node = self;
+        node.values.iter().for_each(&mut f);
+        for b in key {
+            node = match node.children.binary_search_by_key(b, |(c, _)| *c) {
+                Ok(i) => &node.children[i].1,
+                Err(_) => return,
+            };
+            node.values.iter().for_each(&mut f);
+        }
+    }
+
+    /// Call the given callback on all the values in the trie.
+    pub(crate) fn for_each<'a>(&'a self, f: &mut impl FnMut(&'a V)) {
+        self.values.iter().for_each(&mut *f);
+        self.children
+            .iter()
+            .for_each(|(_, child)| child.for_each(f));
+    }
+
+    /// Keep only the values for which the given callback returns `true`
+    /// and drop the nodes that became empty. Return `true` if the trie
+    /// is empty.
+    pub(crate) fn retain(&mut self, f: &mut impl FnMut(&V) -> bool) -> bool {
+        self.values.retain(&mut *f);
+        self.children.retain_mut(|(_, child)| !child.retain(f));
+        self.is_empty()
+    }
+
+    pub(crate) fn is_empty(&self) -> bool {
+        self.values.is_empty() && self.children.is_empty()
+    }
+
+    pub(crate) fn clear(&mut self) {
+        self.values.clear();
+        self.children.clear();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn matches(trie: &PrefixTrie<usize>, key: &[u8]) -> Vec<usize> {
+        let mut res = Vec::new();
+        trie.for_each_match(key, |v| res.push(*v));
+        res
+    }
+
+    #[test]
+    fn test_match() {
+        let mut trie = PrefixTrie::new();
+        trie.insert(b"", 0);
+        trie.insert(b"foo", 1);
+        trie.insert(b"fo", 2);
+        trie.insert(b"foo", 3);
+        trie.insert(b"bar", 4);
+        assert_eq!(matches(&trie, b"foobar"), vec![0, 2, 1, 3]);
+        assert_eq!(matches(&trie, b"fo"), vec![0, 2]);
+        assert_eq!(matches(&trie, b"ba"), vec![0]);
+        assert_eq!(matches(&trie, b"bar"), vec![0, 4]);
+        trie.get_mut(b"").unwrap().clear();
+        assert!(matches(&trie, b"x").is_empty());
+        assert_eq!(matches(&trie, b"barbar"), vec![4]);
+    }
+
+    #[test]
+    fn test_retain() {
+        let mut trie = PrefixTrie::new();
+        trie.insert(b"a", 1);
+        trie.insert(b"ab", 2);
+        trie.insert(b"abc", 3);
+        assert!(!trie.retain(&mut |v| *v != 2 && *v != 3));
+        assert!(trie.get_mut(b"ab").is_none());
+        let mut all = Vec::new();
+        trie.for_each(&mut |v| all.push(*v));
+        assert_eq!(all, vec![1]);
+        assert!(trie.retain(&mut |_| false));
+        assert!(trie.is_empty());
+    }
+}
@@ -5,7 +5,9 @@
  */
 
 use crate::{
-    function_load_command::{function_load_internal, CompilationArguments},
+    function_load_command::{
+        function_compile_parallel, function_evaluate_and_store, CompilationArguments,
+    },
     get_globals, get_globals_mut, get_libraries,
 };
 
@@ -93,63 +95,73 @@ extern "C" fn aux_save(rdb: *mut raw::RedisModuleIO, _when: c_int) {
     }
 }
 
-fn aux_load_internals(ctx: &Context, rdb: *mut raw::RedisModuleIO) -> Result<(), Error> {
-    let num_of_libs = raw::load_unsigned(rdb)?;
+/// The data of a single library as read from the RDB.
+struct LibraryRdbData {
+    name: String,
+    /// `None` if the library is already loaded and should not be compiled.
+    compilation_arguments: Option<CompilationArguments>,
+    /// The last read id of each stream, for each stream consumer.
+    stream_consumers: Vec<(String, Vec<(Vec<u8>, u64, u64)>)>,
+}
 
-    for _ in 0..num_of_libs {
-        let name = raw::load_string_buffer(rdb)
-            .map_err(|e| Error::generic(&format!("Failed loading name from rdb, {}.", e)))?
-            .to_string()
-            .map_err(|e| {
-                Error::generic(&format!("Failed parsing name from rdb as string, {}.", e))
-            })?;
-        let code = raw::load_string_buffer(rdb)
-            .map_err(|e| Error::generic(&format!("Failed loading code from rdb, {}.", e)))?
-            .to_string()
-            .map_err(|e| {
-                Error::generic(&format!("Failed parsing code from rdb as string, {}.", e))
-            })?;
-        let user = raw::load_string(rdb)
-            .map_err(|e| Error::generic(&format!("Failed loading user from rdb, {}.", e)))?;
-
-        let has_config = raw::load_unsigned(rdb).map_err(|e| {
-            Error::generic(&format!("Failed loading config indicator from rdb, {}.", e))
-        })?;
-
-        let config = if has_config > 0 {
-            Some(
-                raw::load_string_buffer(rdb)
-                    .map_err(|e| Error::generic(&format!("Failed loading user from rdb, {}.", e)))?
-                    .to_string()
-                    .map_err(|e| {
-                        Error::generic(&format!("Failed parsing user from rdb as string, {}.", e))
-                    })?,
-            )
-        } else {
-            None
-        };
-
-        // allow upgrade on pseudo_slave (replica-of) because we might get the same function multiple time from different source shards.
-        let is_pseudo_slave = get_globals().db_policy.is_pseudo_slave();
-        let compilation_arguments = CompilationArguments::new(user, code, config);
-        match function_load_internal(ctx, compilation_arguments, false, is_pseudo_slave, true) {
-            Ok(_) => {}
-            Err(e) => return Err(Error::generic(&format!("Failed loading librart, {}", e))),
-        }
+fn aux_load_library(
+    rdb: *mut raw::RedisModuleIO,
+    is_pseudo_slave: bool,
+) -> Result<LibraryRdbData, Error> {
+    let name = raw::load_string_buffer(rdb)
+        .map_err(|e| Error::generic(&format!("Failed loading name from rdb, {}.", e)))?
+        .to_string()
+        .map_err(|e| Error::generic(&format!("Failed parsing name from rdb as string, {}.", e)))?;
+    let code = raw::load_string_buffer(rdb)
+        .map_err(|e| Error::generic(&format!("Failed loading code from rdb, {}.", e)))?
+        .to_string()
+        .map_err(|e| Error::generic(&format!("Failed parsing code from rdb as string, {}.", e)))?;
+    let user = raw::load_string(rdb)
+        .map_err(|e| Error::generic(&format!("Failed loading user from rdb, {}.", e)))?;
 
-        // library was load, we must be able to find it
-        let libraries = get_libraries();
-        let lib = libraries.get(&name).unwrap();
+    let has_config = raw::load_unsigned(rdb).map_err(|e| {
+        Error::generic(&format!("Failed loading config indicator from rdb, {}.", e))
+    })?;
+
+    let config = if has_config > 0 {
+        Some(
+            raw::load_string_buffer(rdb)
+                .map_err(|e| Error::generic(&format!("Failed loading user from rdb, {}.", e)))?
+                .to_string()
+                .map_err(|e| {
+                    Error::generic(&format!("Failed parsing user from rdb as string, {}.", e))
+                })?,
+        )
+    } else {
+        None
+    };
+
+    // When getting the same library from multiple source shards, avoid recompiling
+    // and reevaluating it if it is already loaded with the exact same code, config and user.
+    let already_loaded = is_pseudo_slave
+        && get_libraries().get(&name).map_or(false, |lib| {
+            let meta_data = &lib.gears_lib_ctx.meta_data;
+            meta_data.code == code
+                && meta_data.config == config
+                && meta_data.user.as_slice() == user.as_slice()
+        });
+    let compilation_arguments = if already_loaded {
+        log::debug!("Library '{name}' already loaded with the same code, skip compiling it.");
+        None
+    } else {
+        Some(CompilationArguments::new(user, code, config))
+    };
 
-        // load stream consumers data
-        let num_of_streams_consumers = raw::load_unsigned(rdb).map_err(|e| {
-            Error::generic(&format!(
-                "Failed loading number of streams from rdb, {}.",
-                e
-            ))
-        })?;
+    // load stream consumers data
+    let num_of_streams_consumers = raw::load_unsigned(rdb).map_err(|e| {
+        Error::generic(&format!(
+            "Failed loading number of streams from rdb, {}.",
+            e
+        ))
+    })?;
 
-        for _ in 0..num_of_streams_consumers {
+    let stream_consumers = (0..num_of_streams_consumers)
+        .map(|_| {
             let consumer_name = raw::load_string_buffer(rdb)
                 .map_err(|e| {
                     Error::generic(&format!("Failed loading consumer name from rdb, {}.", e))
@@ -161,11 +173,6 @@ fn aux_load_internals(ctx: &Context, rdb: *mut raw::RedisModuleIO) -> Result<(),
                         e
                     ))
                 })?;
-            let consumer = lib
-                .gears_lib_ctx
-                .stream_consumers
-                .get(&consumer_name)
-                .unwrap();
             // read the number of streams for this consumer
             let num_of_streams = raw::load_unsigned(rdb).map_err(|e| {
                 Error::generic(&format!(
@@ -173,34 +180,94 @@ fn aux_load_internals(ctx: &Context, rdb: *mut raw::RedisModuleIO) -> Result<(),
                     consumer_name, e
                 ))
             })?;
-            for _ in 0..num_of_streams {
-                let stream_name = raw::load_string_buffer(rdb).map_err(|e| {
-                    Error::generic(&format!(
-                        "Failed loading stream name for consumer '{}', {}.",
-                        consumer_name, e
-                    ))
-                })?;
-                let ms = raw::load_unsigned(rdb).map_err(|e| {
-                    Error::generic(&format!(
-                        "Failed loading ms value for consumer '{}', {}.",
-                        consumer_name, e
-                    ))
-                })?;
-                let seq = raw::load_unsigned(rdb).map_err(|e| {
-                    Error::generic(&format!(
-                        "Failed loading seq value for consumer '{}', {}.",
-                        consumer_name, e
-                    ))
-                })?;
+            let streams = (0..num_of_streams)
+                .map(|_| {
+                    let stream_name = raw::load_string_buffer(rdb).map_err(|e| {
+                        Error::generic(&format!(
+                            "Failed loading stream name for consumer '{}', {}.",
+                            consumer_name, e
+                        ))
+                    })?;
+                    let ms = raw::load_unsigned(rdb).map_err(|e| {
+                        Error::generic(&format!(
+                            "Failed loading ms value for consumer '{}', {}.",
+                            consumer_name, e
+                        ))
+                    })?;
+                    let seq = raw::load_unsigned(rdb).map_err(|e| {
+                        Error::generic(&format!(
+                            "Failed loading seq value for consumer '{}', {}.",
+                            consumer_name, e
+                        ))
+                    })?;
+                    Ok((stream_name.as_ref().to_vec(), ms, seq))
+                })
+                .collect::<Result<Vec<_>, Error>>()?;
+            Ok((consumer_name, streams))
+        })
+        .collect::<Result<Vec<_>, Error>>()?;
+
+    Ok(LibraryRdbData {
+        name,
+        compilation_arguments,
+        stream_consumers,
+    })
+}
+
+fn aux_load_internals(ctx: &Context, rdb: *mut raw::RedisModuleIO) -> Result<(), Error> {
+    let num_of_libs = raw::load_unsigned(rdb)?;
+
+    // allow upgrade on pseudo_slave (replica-of) because we might get the same function multiple time from different source shards.
+    let is_pseudo_slave = get_globals().db_policy.is_pseudo_slave();
+
+    let libraries_data = (0..num_of_libs)
+        .map(|_| aux_load_library(rdb, is_pseudo_slave))
+        .collect::<Result<Vec<_>, Error>>()?;
+
+    // Compile all the libraries in parallel, then evaluate them one by one
+    // and in order on the current thread.
+    let compiled_libraries = function_compile_parallel(
+        ctx,
+        libraries_data
+            .iter()
+            .filter_map(|v| v.compilation_arguments.clone())
+            .collect(),
+    );
+    let mut compiled_libraries = compiled_libraries.into_iter();
+
+    for library_data in libraries_data {
+        if library_data.compilation_arguments.is_some() {
+            let compiled_library = compiled_libraries
+                .next()
+                .expect("Missing compiled library")
+                .and_then(|compiled_library| {
+                    function_evaluate_and_store(ctx, compiled_library, is_pseudo_slave, true)
+                });
+            if let Err(e) = compiled_library {
+                return Err(Error::generic(&format!("Failed loading librart, {}", e)));
+            }
+        }
+
+        // library was load, we must be able to find it
+        let libraries = get_libraries();
+        let lib = libraries.get(&library_data.name).unwrap();
+
+        for (consumer_name, streams) in library_data.stream_consumers {
+            let consumer = lib
+                .gears_lib_ctx
+                .stream_consumers
+                .get(&consumer_name)
+                .unwrap();
+            for (stream_name, ms, seq) in streams {
                 // Add the stream only if it belong to our slot range.
                 if is_pseudo_slave {
-                    let slot = calc_slot(stream_name.as_ref());
+                    let slot = calc_slot(&stream_name);
                     if !is_my_slot(slot) {
                         continue;
                     }
                 }
                 get_globals_mut().stream_ctx.update_stream_for_consumer(
-                    stream_name.as_ref(),
+                    &stream_name,
                     consumer,
                     ms,
                     seq,
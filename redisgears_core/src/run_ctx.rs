@@ -21,13 +21,15 @@ use redisgears_plugin_api::redisgears_plugin_api::{
 };
 
 use crate::{
-    call_redis_command, call_redis_command_async, get_globals, get_msg_verbose,
-    GearsLibraryMetaData,
+    call_redis_command, call_redis_command_async, call_redis_commands_batch, get_globals,
+    get_msg_verbose, GearsLibraryMetaData,
 };
 
 use crate::background_run_ctx::BackgroundRunCtx;
+use crate::invocation_stats::FunctionStats;
 
 use std::sync::Arc;
+use std::time::Instant;
 
 use redisai_rs::redisai::redisai_model::RedisAIModel;
 use redisai_rs::redisai::redisai_script::RedisAIScript;
@@ -103,6 +105,15 @@ impl<'ctx> RedisClientCtxInterface for RedisClient<'ctx> {
         )
     }
 
+    fn call_batch(&self, commands: &[(&str, Vec<&[u8]>)]) -> Vec<CallResult> {
+        call_redis_commands_batch(
+            self.ctx,
+            &self.user,
+            &self.call_options.call_options,
+            commands,
+        )
+    }
+
     fn call_async(&self, command: &str, args: &[&[u8]]) -> PromiseReply<'static, '_> {
         call_redis_command_async(
             self.ctx,
@@ -149,14 +160,19 @@ pub(crate) struct RunCtx<'a> {
     pub(crate) flags: FunctionFlags,
     pub(crate) lib_meta_data: Arc<GearsLibraryMetaData>,
     pub(crate) allow_block: bool,
+    pub(crate) stats: &'a Arc<FunctionStats>,
 }
 
 impl<'a> ReplyCtxInterface for RunCtx<'a> {
     fn send_reply(&self, reply: RedisResult) {
+        if reply.is_err() {
+            self.stats.on_error();
+        }
         self.ctx.reply(reply);
     }
 
     fn reply_with_error(&self, val: GearsApiError) {
+        self.stats.on_error();
         self.ctx.reply_error_string(get_msg_verbose(&val));
     }
 
@@ -182,7 +198,11 @@ impl<'a> RunFunctionCtxInterface for RunCtx<'a> {
         }
         let blocked_client = self.ctx.block_client();
         let thread_ctx = ThreadSafeContext::with_blocked_client(blocked_client);
-        Ok(Box::new(BackgroundClientCtx { thread_ctx }))
+        Ok(Box::new(BackgroundClientCtx {
+            thread_ctx,
+            stats: Arc::clone(self.stats),
+            blocked_at: Instant::now(),
+        }))
     }
 
     fn get_redis_client(&self) -> Box<dyn RedisClientCtxInterface + '_> {
@@ -201,6 +221,10 @@ impl<'a> RunFunctionCtxInterface for RunCtx<'a> {
 
 pub(crate) struct BackgroundClientCtx {
     thread_ctx: ThreadSafeContext<redis_module::BlockedClient>,
+    stats: Arc<FunctionStats>,
+    /// The time the client was blocked, used to measure the time it
+    /// waits for the reply.
+    blocked_at: Instant,
 }
 
 unsafe impl Sync for BackgroundClientCtx {}
@@ -208,10 +232,16 @@ unsafe impl Send for BackgroundClientCtx {}
 
 impl ReplyCtxInterface for BackgroundClientCtx {
     fn send_reply(&self, reply: RedisResult) {
+        self.stats.async_wait.record(self.blocked_at.elapsed());
+        if reply.is_err() {
+            self.stats.on_error();
+        }
         self.thread_ctx.reply(reply);
     }
 
     fn reply_with_error(&self, val: GearsApiError) {
+        self.stats.async_wait.record(self.blocked_at.elapsed());
+        self.stats.on_error();
         self.thread_ctx
             .reply(Err(RedisError::String(get_msg_verbose(&val).into())));
     }
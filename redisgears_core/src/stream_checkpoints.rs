@@ -0,0 +1,165 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Coalesces the replication of the stream consumers progress.
+//!
+//! Instead of replicating the last read id of a consumer on every
+//! acknowledgement, only the latest id of each consumer and stream is
+//! kept and replicated periodically, or once it accumulated a given
+//! amount of acknowledgements. This bounds the amount of records that
+//! are processed again after a failover.
+
+use std::collections::HashMap;
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub(crate) struct StreamCheckpoint {
+    pub(crate) library: String,
+    pub(crate) consumer: String,
+    pub(crate) ms: u64,
+    pub(crate) seq: u64,
+    /// Acknowledgements since the checkpoint was last replicated.
+    acks: usize,
+}
+
+#[derive(Debug, Default)]
+pub(crate) struct StreamCheckpoints {
+    /// The checkpoints that were not yet replicated, by stream.
+    pending: HashMap<Vec<u8>, Vec<StreamCheckpoint>>,
+}
+
+impl StreamCheckpoints {
+    pub(crate) fn new() -> StreamCheckpoints {
+        StreamCheckpoints::default()
+    }
+
+    /// Update the checkpoint of the given consumer on the given stream. Return the
+    /// checkpoint if it should be replicated right away, that is if it reached `max_acks`
+    /// acknowledgements since it was last replicated.
+    pub(crate) fn on_acked(
+        &mut self,
+        library: &str,
+        consumer: &str,
+        stream: &[u8],
+        ms: u64,
+        seq: u64,
+        max_acks: usize,
+    ) -> Option<StreamCheckpoint> {
+        let checkpoints = match self.pending.get_mut(stream) {
+            Some(c) => c,
+            None => self.pending.entry(stream.to_vec()).or_default(),
+        };
+        let index = match checkpoints
+            .iter()
+            .position(|c| c.library == library && c.consumer == consumer)
+        {
+            Some(index) => index,
+            None => {
+                checkpoints.push(StreamCheckpoint {
+                    library: library.to_owned(),
+                    consumer: consumer.to_owned(),
+                    ms,
+                    seq,
+                    acks: 0,
+                });
+                checkpoints.len() - 1
+            }
+        };
+        let checkpoint = &mut checkpoints[index];
+        checkpoint.ms = ms;
+        checkpoint.seq = seq;
+        checkpoint.acks += 1;
+        if checkpoint.acks < max_acks {
+            return None;
+        }
+        let checkpoint = checkpoints.swap_remove(index);
+        if checkpoints.is_empty() {
+            self.pending.remove(stream);
+        }
+        Some(checkpoint)
+    }
+
+    /// Drop the checkpoints of a deleted stream, a new stream with
+    /// the same name is read from the start.
+    pub(crate) fn on_stream_deleted(&mut self, stream: &[u8]) {
+        self.pending.remove(stream);
+    }
+
+    /// Take all the checkpoints that were not yet replicated.
+    pub(crate) fn take(&mut self) -> Vec<(Vec<u8>, StreamCheckpoint)> {
+        self.pending
+            .drain()
+            .flat_map(|(stream, checkpoints)| {
+                checkpoints.into_iter().map(move |c| (stream.clone(), c))
+            })
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_coalescing() {
+        let mut checkpoints = StreamCheckpoints::new();
+        (1..=10).for_each(|seq| {
+            assert_eq!(
+                checkpoints.on_acked("lib", "consumer", b"stream", 1, seq, 100),
+                None
+            );
+        });
+        checkpoints.on_acked("lib", "other", b"stream", 1, 3, 100);
+        checkpoints.on_acked("lib", "consumer", b"other", 2, 1, 100);
+        let mut taken = checkpoints
+            .take()
+            .into_iter()
+            .map(|(stream, c)| (stream, c.consumer, c.ms, c.seq))
+            .collect::<Vec<_>>();
+        taken.sort();
+        assert_eq!(
+            taken,
+            vec![
+                (b"other".to_vec(), "consumer".to_owned(), 2, 1),
+                (b"stream".to_vec(), "consumer".to_owned(), 1, 10),
+                (b"stream".to_vec(), "other".to_owned(), 1, 3),
+            ]
+        );
+        assert!(checkpoints.take().is_empty());
+    }
+
+    #[test]
+    fn test_max_acks() {
+        let mut checkpoints = StreamCheckpoints::new();
+        assert_eq!(
+            checkpoints.on_acked("lib", "consumer", b"stream", 1, 1, 3),
+            None
+        );
+        assert_eq!(
+            checkpoints.on_acked("lib", "consumer", b"stream", 1, 2, 3),
+            None
+        );
+        let checkpoint = checkpoints
+            .on_acked("lib", "consumer", b"stream", 1, 3, 3)
+            .unwrap();
+        assert_eq!((checkpoint.ms, checkpoint.seq), (1, 3));
+        assert!(checkpoints.take().is_empty());
+        // replicate every acknowledgement
+        assert!(checkpoints
+            .on_acked("lib", "consumer", b"stream", 1, 4, 1)
+            .is_some());
+    }
+
+    #[test]
+    fn test_stream_deleted() {
+        let mut checkpoints = StreamCheckpoints::new();
+        checkpoints.on_acked("lib", "consumer", b"stream", 1, 1, 3);
+        checkpoints.on_acked("lib", "consumer", b"other", 1, 1, 3);
+        checkpoints.on_stream_deleted(b"stream");
+        let taken = checkpoints.take();
+        assert_eq!(taken.len(), 1);
+        assert_eq!(taken[0].0, b"other".to_vec());
+    }
+}
@@ -6,16 +6,23 @@
 
 use redis_module::raw::RedisModuleStreamID;
 use redis_module::Context;
+use redisgears_plugin_api::redisgears_plugin_api::stream_ctx::{
+    StreamAdaptiveWindowConfig, StreamBatchConfig,
+};
 use redisgears_plugin_api::redisgears_plugin_api::GearsApiError;
 
 use std::collections::HashMap;
 
 use std::cell::RefCell;
-use std::collections::LinkedList;
+use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::{Arc, Weak};
 
-use std::time::{SystemTime, UNIX_EPOCH};
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
 
+use crate::adaptive_window::AdaptiveWindow;
+use crate::invocation_stats::LatencyHistogram;
+use crate::pending_ids::{PendingIdToken, PendingIds};
+use crate::prefix_trie::PrefixTrie;
 use crate::RefCellWrapper;
 
 pub type RecordAcknowledgeCallback = dyn Fn(&Context, &[u8], u64, u64);
@@ -49,16 +56,75 @@ pub(crate) trait StreamConsumer<T: StreamReaderRecord> {
         record: T,
         ack_callback: Box<AcknowledgeCallback>,
     ) -> Option<StreamReaderAck>;
+
+    fn new_data_batch(
+        &self,
+        ctx: &Context,
+        stream_name: &[u8],
+        records: Vec<T>,
+        ack_callback: Box<AcknowledgeCallback>,
+    ) -> Option<StreamReaderAck>;
+
+    fn batch_config(&self) -> Option<StreamBatchConfig>;
+
+    fn adaptive_window_config(&self) -> Option<StreamAdaptiveWindowConfig>;
 }
 
+fn now_ms() -> u128 {
+    SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .unwrap()
+        .as_millis()
+}
+
+/// A stream is trimmed right away, instead of waiting for the next call to
+/// [`StreamReaderCtx::trim_pending_streams`], once it accumulated this amount
+/// of acknowledgements that allow trimming it.
+const TRIM_ACKS_THRESHOLD: usize = 1000;
+
+/// A tracked stream which was neither touched nor acknowledged for this
+/// amount of time is checked for existence by
+/// [`StreamReaderCtx::reclaim_idle_streams`].
+const IDLE_STREAMS_CHECK_INTERVAL_MS: u128 = 10_000;
+
+/// Names of the streams that wait to be trimmed.
+type StreamsToTrim = Arc<RefCellWrapper<Vec<Vec<u8>>>>;
+
 pub(crate) struct TrackedStream {
     name: Vec<u8>,
     consumers_data: Vec<Weak<RefCellWrapper<ConsumerInfo>>>,
     stream_trimmer: Arc<Box<StreamTrimmerCallback>>,
+    streams_to_trim: StreamsToTrim,
+    /// Whether the stream was added to `streams_to_trim`.
+    trim_pending: bool,
+    acks_since_trim: usize,
+    /// Whether the stream was touched or acknowledged since the last
+    /// call to [`StreamReaderCtx::reclaim_idle_streams`].
+    active: bool,
 }
 
 impl TrackedStream {
+    /// Schedule the stream to be trimmed on the next call to
+    /// [`StreamReaderCtx::trim_pending_streams`], or trim it right away
+    /// if enough acknowledgements accumulated since it was last trimmed.
+    fn request_trim(&mut self, ctx: &Context) {
+        self.acks_since_trim += 1;
+        if self.acks_since_trim >= TRIM_ACKS_THRESHOLD {
+            self.trim(ctx);
+            return;
+        }
+        if !self.trim_pending {
+            self.trim_pending = true;
+            self.streams_to_trim
+                .ref_cell
+                .borrow_mut()
+                .push(self.name.clone());
+        }
+    }
+
     fn trim(&mut self, ctx: &Context) {
+        self.trim_pending = false;
+        self.acks_since_trim = 0;
         let mut id_to_trim: RedisModuleStreamID = RedisModuleStreamID {
             ms: u64::MAX,
             seq: u64::MAX,
@@ -116,36 +182,39 @@ pub(crate) struct ConsumerInfo {
     pub(crate) last_lag: u128,            // last lag in ms
     pub(crate) total_lag: u128,           // average lag in ms
     pub(crate) records_processed: usize,  // average lag in ms
-    pub(crate) pending_ids: LinkedList<RedisModuleStreamID>,
+    pub(crate) pending_ids: PendingIds,
+    /// Deliveries (records or batches) that were sent and not yet acknowledged.
+    pub(crate) in_flight: usize,
     pub(crate) last_read_id: Option<RedisModuleStreamID>,
     pub(crate) last_error: Option<GearsApiError>,
+    pub(crate) batch_pending_since: Option<u128>, // time in ms since a partial batch is waiting to be delivered
+    pub(crate) records_failed: usize,
+    /// The processing time of the records, shared by all the streams of the consumer.
+    pub(crate) latency: Arc<LatencyHistogram>,
+    /// Set on the first acknowledgement if the consumer window is adaptive.
+    pub(crate) adaptive_window: Option<AdaptiveWindow>,
 }
 
 impl ConsumerInfo {
-    fn ack_id(&mut self, id: RedisModuleStreamID, start_time: u128) -> bool {
+    /// Acknowledge the given pending id, return `true` if it was the
+    /// lowest pending id.
+    pub(crate) fn ack_id(
+        &mut self,
+        id: RedisModuleStreamID,
+        token: PendingIdToken,
+        start_time: Instant,
+    ) -> bool {
         self.records_processed += 1;
-        let since_the_epoch = SystemTime::now()
-            .duration_since(UNIX_EPOCH)
-            .unwrap()
-            .as_millis();
+        let since_the_epoch = now_ms();
         let lag = since_the_epoch - id.ms as u128;
-        self.last_processed_time = since_the_epoch - start_time;
+        let processed_time = start_time.elapsed();
+        self.latency.record(processed_time);
+        self.last_processed_time = processed_time.as_millis();
         self.total_processed_time += self.last_processed_time;
         self.last_lag = lag;
         self.total_lag += lag;
 
-        let mut temp_list = LinkedList::new();
-        while let Some(curr) = self.pending_ids.pop_front() {
-            if curr.ms == id.ms && curr.seq == id.seq {
-                break;
-            }
-            temp_list.push_back(curr);
-        }
-        if temp_list.is_empty() {
-            return true; // indicate that the first element was removed
-        }
-        self.pending_ids.append(&mut temp_list);
-        false
+        self.pending_ids.ack(token)
     }
 }
 
@@ -157,9 +226,20 @@ pub(crate) struct ConsumerData<T: StreamReaderRecord, C: StreamConsumer<T>> {
     pub(crate) trim: bool,
     pub(crate) on_record_acked: Option<Box<RecordAcknowledgeCallback>>,
     pub(crate) description: Option<String>,
+    pub(crate) latency: Arc<LatencyHistogram>,
+    /// Set when the consumer is dropped to indicate that the consumers
+    /// index and the tracked streams contain dead entries.
+    reader_has_dead_consumers: Arc<AtomicBool>,
     phantom: std::marker::PhantomData<T>,
 }
 
+impl<T: StreamReaderRecord, C: StreamConsumer<T>> Drop for ConsumerData<T, C> {
+    fn drop(&mut self) {
+        self.reader_has_dead_consumers
+            .store(true, Ordering::Relaxed);
+    }
+}
+
 impl<T, C> std::fmt::Debug for ConsumerData<T, C>
 where
     T: StreamReaderRecord + std::fmt::Debug,
@@ -182,6 +262,7 @@ where
                 &self.on_record_acked.as_ref().map(|e| format!("{e:p}")),
             )
             .field("description", &self.description)
+            .field("latency", &self.latency)
             .finish()
     }
 }
@@ -215,6 +296,35 @@ where
         old_description
     }
 
+    pub(crate) fn batch_config(&self) -> Option<StreamBatchConfig> {
+        self.consumer.as_ref().and_then(|c| c.batch_config())
+    }
+
+    pub(crate) fn adaptive_window_config(&self) -> Option<StreamAdaptiveWindowConfig> {
+        self.consumer
+            .as_ref()
+            .and_then(|c| c.adaptive_window_config())
+    }
+
+    /// The window currently in use on the given stream, differs from
+    /// `window` only if the window is adaptive.
+    pub(crate) fn effective_window(&self, consumer_info: &ConsumerInfo) -> usize {
+        match (
+            self.adaptive_window_config(),
+            consumer_info.adaptive_window.as_ref(),
+        ) {
+            (Some(config), Some(adaptive_window)) => adaptive_window.window(self.window, &config),
+            _ => self.window,
+        }
+    }
+
+    /// Whether the given stream reached the max amount of deliveries that can be
+    /// in flight at the same time. When batching is enabled the window counts
+    /// batches, including partial batches that were flushed by `max_batch_delay`.
+    fn is_window_full(&self, consumer_info: &ConsumerInfo) -> bool {
+        consumer_info.in_flight >= self.effective_window(consumer_info)
+    }
+
     pub(crate) fn get_or_create_consumed_stream(
         &mut self,
         name: &[u8],
@@ -232,9 +342,14 @@ where
                         last_lag: 0,
                         total_lag: 0,
                         records_processed: 0,
-                        pending_ids: LinkedList::new(),
+                        pending_ids: PendingIds::new(),
+                        in_flight: 0,
                         last_error: None,
                         last_read_id: None,
+                        batch_pending_since: None,
+                        records_failed: 0,
+                        latency: Arc::clone(&self.latency),
+                        adaptive_window: None,
                     }),
                 })
             });
@@ -268,11 +383,18 @@ where
     T: StreamReaderRecord,
     C: StreamConsumer<T>,
 {
-    // map between consumers to streams the consumer is reading from
-    consumers: Vec<Weak<RefCellWrapper<ConsumerData<T, C>>>>,
+    /// The consumers indexed by their prefix.
+    consumers: PrefixTrie<Weak<RefCellWrapper<ConsumerData<T, C>>>>,
     stream_reader: Arc<Box<StreamReaderCallback<T>>>,
     stream_trimmer: Arc<Box<StreamTrimmerCallback>>,
+    /// Streams that are consumed by at least one consumer, created on the
+    /// first match and reclaimed once the stream is deleted or no consumer
+    /// reads it.
     tracked_streams: HashMap<Vec<u8>, Arc<RefCellWrapper<TrackedStream>>>,
+    streams_to_trim: StreamsToTrim,
+    has_dead_consumers: Arc<AtomicBool>,
+    /// Time in ms of the last check for idle streams.
+    last_idle_streams_check: u128,
 }
 
 fn read_next_data<T: StreamReaderRecord>(
@@ -296,11 +418,159 @@ fn read_next_data<T: StreamReaderRecord>(
     r
 }
 
+/// Read the next batch of records. Without batch configuration, the batch
+/// will contain at most a single record. A partial batch is not returned (and
+/// the read is reverted) until `max_batch_delay` passed since it was first
+/// seen, unless `flush` is set.
+fn read_next_batch<T: StreamReaderRecord>(
+    ctx: &Context,
+    name: &[u8],
+    id: Option<RedisModuleStreamID>,
+    consumer_info: &Arc<RefCellWrapper<ConsumerInfo>>,
+    stream_reader: &Arc<Box<StreamReaderCallback<T>>>,
+    batch: Option<&StreamBatchConfig>,
+    flush: bool,
+) -> Result<Vec<T>, String> {
+    let batch = match batch {
+        Some(b) => b,
+        None => {
+            return read_next_data(ctx, name, id, false, consumer_info, stream_reader)
+                .map(|r| r.into_iter().collect())
+        }
+    };
+    let mut records = Vec::with_capacity(batch.batch_size);
+    let mut last_id = id;
+    while records.len() < batch.batch_size {
+        let record = match read_next_data(ctx, name, last_id, false, consumer_info, stream_reader) {
+            Ok(Some(r)) => r,
+            Ok(None) => break,
+            Err(e) => {
+                if records.is_empty() {
+                    return Err(e);
+                }
+                // we already advanced the last read id, deliver what we have.
+                break;
+            }
+        };
+        last_id = Some(record.get_id());
+        records.push(record);
+    }
+
+    let mut c_i = consumer_info.ref_cell.borrow_mut();
+    if records.is_empty()
+        || records.len() >= batch.batch_size
+        || batch.max_batch_delay == 0
+        || flush
+    {
+        c_i.batch_pending_since = None;
+        return Ok(records);
+    }
+    let now = now_ms();
+    let pending_since = *c_i.batch_pending_since.get_or_insert(now);
+    if now.saturating_sub(pending_since) >= batch.max_batch_delay as u128 {
+        c_i.batch_pending_since = None;
+        return Ok(records);
+    }
+    // give the batch a chance to fill up, we will read those records again later.
+    c_i.last_read_id = id;
+    Ok(Vec::new())
+}
+
+/// Acknowledge the given ids, fire the `on_record_acked` callback and trim
+/// the stream if needed. Returns the id from which to continue reading.
+#[allow(clippy::too_many_arguments)]
+fn ack_records<T: StreamReaderRecord, C: StreamConsumer<T>>(
+    ctx: &Context,
+    stream: &mut TrackedStream,
+    consumer_weak: &Weak<RefCellWrapper<ConsumerData<T, C>>>,
+    consumer_info: &Arc<RefCellWrapper<ConsumerInfo>>,
+    ids: &[(RedisModuleStreamID, PendingIdToken)],
+    start_time: Instant,
+    ack: StreamReaderAck,
+    trim: bool,
+) -> Option<RedisModuleStreamID> {
+    let (trimmed_first, last_read_id) = {
+        let mut c_i = consumer_info.ref_cell.borrow_mut();
+        let consumer = consumer_weak.upgrade();
+        // whether the window limited the deliveries, checked before the ids are acked.
+        let window_full = consumer
+            .as_ref()
+            .map_or(false, |c| c.ref_cell.borrow().is_window_full(&c_i));
+        c_i.in_flight = c_i.in_flight.saturating_sub(1);
+        let last_trimmed = ids.iter().fold(None, |last_trimmed, (id, token)| {
+            if c_i.ack_id(*id, *token, start_time) {
+                Some(*id)
+            } else {
+                last_trimmed
+            }
+        });
+        let mut trimmed_first = last_trimmed.is_some();
+        if let Some(c) = consumer {
+            let c = c.ref_cell.borrow();
+            if let Some(config) = c.adaptive_window_config() {
+                let in_flight = c_i.in_flight;
+                let processing_time = start_time.elapsed();
+                let lag = Duration::from_millis(c_i.last_lag as u64);
+                c_i.adaptive_window
+                    .get_or_insert_with(|| AdaptiveWindow::new(c.window))
+                    .on_ack(
+                        c.window,
+                        &config,
+                        in_flight,
+                        window_full,
+                        processing_time,
+                        lag,
+                    );
+            }
+            // consumer is still allive, fire the on acked event.
+            // only if we trimmed the first element we
+            // can fire the acked callback to notify
+            // that it is safe to continue from this ID
+            // in case of a crash.
+            if let Some(id) = last_trimmed {
+                if let Some(on_record_acked) = c.on_record_acked.as_ref() {
+                    on_record_acked(ctx, &stream.name, id.ms, id.seq);
+                }
+            }
+        } else {
+            // consumer is dead, lets not trim the stream.
+            trimmed_first = false;
+        }
+        match ack {
+            StreamReaderAck::Ack => {}
+            StreamReaderAck::Nack(msg) => {
+                c_i.records_failed += ids.len();
+                c_i.last_error = Some(msg);
+            }
+        }
+        (trimmed_first, c_i.last_read_id)
+    };
+    stream.active = true;
+    if trimmed_first && trim {
+        stream.request_trim(ctx);
+    }
+    last_read_id
+}
+
+/// Whether the consumer window of the given stream is full, checked before
+/// every delivery as the adaptive window might have shrunk on the last
+/// acknowledgement. A dead consumer is considered full.
+fn is_window_full<T: StreamReaderRecord, C: StreamConsumer<T>>(
+    consumer_weak: &Weak<RefCellWrapper<ConsumerData<T, C>>>,
+    consumer_info: &Arc<RefCellWrapper<ConsumerInfo>>,
+) -> bool {
+    consumer_weak.upgrade().map_or(true, |c| {
+        c.ref_cell
+            .borrow()
+            .is_window_full(&consumer_info.ref_cell.borrow())
+    })
+}
+
 fn send_new_data<T: StreamReaderRecord + 'static, C: StreamConsumer<T> + 'static>(
     ctx: &Context,
     stream: Arc<RefCellWrapper<TrackedStream>>,
     consumer_weak: Weak<RefCellWrapper<ConsumerData<T, C>>>,
-    mut actual_record: Result<Option<T>, String>,
+    mut actual_records: Result<Vec<T>, String>,
     consumer_info: Arc<RefCellWrapper<ConsumerInfo>>,
     stream_reader: Arc<Box<StreamReaderCallback<T>>>,
 ) {
@@ -308,26 +578,28 @@ fn send_new_data<T: StreamReaderRecord + 'static, C: StreamConsumer<T> + 'static
         Some(c) => c,
         None => return,
     };
-    let trim = { consumer.ref_cell.borrow().trim };
+    let (trim, batch) = {
+        let c = consumer.ref_cell.borrow();
+        (c.trim, c.batch_config())
+    };
     loop {
-        let (id, record) = {
+        let (ids, records) = {
             let mut c_i = consumer_info.ref_cell.borrow_mut();
-            if actual_record.is_err() {
-                return;
-            }
-            let record = actual_record.unwrap();
-            if record.is_none() {
-                return;
-            }
-            let record = record.unwrap();
-            let id = record.get_id();
-            c_i.pending_ids.push_back(id);
-            (id, record)
+            let records = match actual_records {
+                Ok(records) if !records.is_empty() => records,
+                _ => return,
+            };
+            let ids = records
+                .iter()
+                .map(|r| {
+                    let id = r.get_id();
+                    (id, c_i.pending_ids.push(id))
+                })
+                .collect::<Vec<(RedisModuleStreamID, PendingIdToken)>>();
+            c_i.in_flight += 1;
+            (ids, records)
         };
-        let start_time = SystemTime::now()
-            .duration_since(UNIX_EPOCH)
-            .unwrap()
-            .as_millis();
+        let start_time = Instant::now();
         let res = {
             let t_s = stream.ref_cell.borrow();
             let c = consumer.ref_cell.borrow();
@@ -335,119 +607,79 @@ fn send_new_data<T: StreamReaderRecord + 'static, C: StreamConsumer<T> + 'static
             let clone_consumer_info = Arc::downgrade(&consumer_info);
             let clone_stream = Arc::clone(&stream);
             let clone_stream_reader = Arc::clone(&stream_reader);
-            c.consumer.as_ref().unwrap().new_data(
-                ctx,
-                &t_s.name,
-                record,
-                Box::new(move |ctx, ack| {
-                    // if weak ref returns None it means that stream was deleted
-                    if let Some(clone_consumer_info) = clone_consumer_info.upgrade() {
-                        let record = {
-                            let mut t_s = clone_stream.ref_cell.borrow_mut();
-                            let last_read_id = {
-                                let (trimmed_first, last_read_id) = {
-                                    let mut c_i = clone_consumer_info.ref_cell.borrow_mut();
-                                    let mut trimmed_first = c_i.ack_id(id, start_time);
-                                    if let Some(c) = clone_consumer_weak.upgrade() {
-                                        // consumer is still allive, fire the on acked event.
-                                        if trimmed_first {
-                                            // only if we trimmed the first element we
-                                            // can fire the acked callback to notify
-                                            // that it is safe to continue from this ID
-                                            // in case of a crash.
-                                            if let Some(on_record_acked) =
-                                                c.ref_cell.borrow().on_record_acked.as_ref()
-                                            {
-                                                on_record_acked(ctx, &t_s.name, id.ms, id.seq);
-                                            }
-                                        }
-                                    } else {
-                                        // consumer is dead, lets not trim the stream.
-                                        trimmed_first = false;
-                                    }
-                                    match ack {
-                                        StreamReaderAck::Ack => {}
-                                        StreamReaderAck::Nack(msg) => c_i.last_error = Some(msg),
-                                    }
-                                    (trimmed_first, c_i.last_read_id)
-                                };
-                                if trimmed_first && trim {
-                                    t_s.trim(ctx);
-                                }
-                                last_read_id
-                            };
-                            read_next_data(
-                                ctx,
-                                &t_s.name,
-                                last_read_id,
-                                false,
-                                &clone_consumer_info,
-                                &clone_stream_reader,
-                            )
-                        };
-                        send_new_data(
+            let clone_ids = ids.clone();
+            let ack_callback: Box<AcknowledgeCallback> = Box::new(move |ctx, ack| {
+                // if weak ref returns None it means that stream was deleted
+                if let Some(clone_consumer_info) = clone_consumer_info.upgrade() {
+                    let records = {
+                        let mut t_s = clone_stream.ref_cell.borrow_mut();
+                        let last_read_id = ack_records(
                             ctx,
-                            clone_stream,
-                            clone_consumer_weak,
-                            record,
-                            clone_consumer_info,
-                            clone_stream_reader,
+                            &mut t_s,
+                            &clone_consumer_weak,
+                            &clone_consumer_info,
+                            &clone_ids,
+                            start_time,
+                            ack,
+                            trim,
                         );
-                    }
-                }),
-            )
+                        if is_window_full(&clone_consumer_weak, &clone_consumer_info) {
+                            return;
+                        }
+                        read_next_batch(
+                            ctx,
+                            &t_s.name,
+                            last_read_id,
+                            &clone_consumer_info,
+                            &clone_stream_reader,
+                            batch.as_ref(),
+                            false,
+                        )
+                    };
+                    send_new_data(
+                        ctx,
+                        clone_stream,
+                        clone_consumer_weak,
+                        records,
+                        clone_consumer_info,
+                        clone_stream_reader,
+                    );
+                }
+            });
+            let consumer = c.consumer.as_ref().unwrap();
+            if batch.is_some() {
+                consumer.new_data_batch(ctx, &t_s.name, records, ack_callback)
+            } else {
+                let record = records.into_iter().next().unwrap();
+                consumer.new_data(ctx, &t_s.name, record, ack_callback)
+            }
         };
 
         let mut t_s = stream.ref_cell.borrow_mut();
         let last_read_id = match res {
-            Some(r) => {
-                let (trimmed_first, last_read_id) = {
-                    let mut c_i = consumer_info.ref_cell.borrow_mut();
-                    let mut trimmed_first = c_i.ack_id(id, start_time);
-                    if let Some(c) = consumer_weak.upgrade() {
-                        // consumer is still allive, fire the on acked event.
-                        if trimmed_first {
-                            // only if we trimmed the first element we
-                            // can fire the acked callback to notify
-                            // that it is safe to continue from this ID
-                            // in case of a crash.
-                            if let Some(on_record_acked) =
-                                c.ref_cell.borrow().on_record_acked.as_ref()
-                            {
-                                on_record_acked(ctx, &t_s.name, id.ms, id.seq);
-                            }
-                        }
-                    } else {
-                        // consumer is dead, lets not trim the stream.
-                        trimmed_first = false;
-                    }
-                    match r {
-                        StreamReaderAck::Ack => {}
-                        StreamReaderAck::Nack(msg) => c_i.last_error = Some(msg),
-                    }
-                    (trimmed_first, c_i.last_read_id)
-                };
-                if trimmed_first && trim {
-                    t_s.trim(ctx);
-                }
-                last_read_id
-            }
-            None => {
-                let window = { consumer.ref_cell.borrow().window };
-                let c_i = consumer_info.ref_cell.borrow();
-                if c_i.pending_ids.len() >= window {
-                    return;
-                }
-                c_i.last_read_id
-            }
+            Some(r) => ack_records(
+                ctx,
+                &mut t_s,
+                &consumer_weak,
+                &consumer_info,
+                &ids,
+                start_time,
+                r,
+                trim,
+            ),
+            None => consumer_info.ref_cell.borrow().last_read_id,
         };
-        actual_record = read_next_data(
+        if is_window_full(&consumer_weak, &consumer_info) {
+            return;
+        }
+        actual_records = read_next_batch(
             ctx,
             &t_s.name,
             last_read_id,
-            false,
             &consumer_info,
             &stream_reader,
+            batch.as_ref(),
+            false,
         );
     }
 }
@@ -471,10 +703,15 @@ where
         stream_trimmer: Box<StreamTrimmerCallback>,
     ) -> Self {
         StreamReaderCtx {
-            consumers: Vec::new(),
+            consumers: PrefixTrie::new(),
             stream_reader: Arc::new(stream_reader),
             stream_trimmer: Arc::new(stream_trimmer),
             tracked_streams: HashMap::new(),
+            streams_to_trim: Arc::new(RefCellWrapper {
+                ref_cell: RefCell::new(Vec::new()),
+            }),
+            has_dead_consumers: Arc::new(AtomicBool::new(false)),
+            last_idle_streams_check: now_ms(),
         }
     }
 
@@ -484,7 +721,7 @@ where
     }
 
     pub(crate) fn add_consumer(
-        &'static mut self,
+        &mut self,
         prefix: &[u8],
         consumer: C,
         window: usize,
@@ -502,40 +739,139 @@ where
                 trim,
                 on_record_acked,
                 description,
+                latency: Arc::new(LatencyHistogram::new()),
+                reader_has_dead_consumers: Arc::clone(&self.has_dead_consumers),
             }),
         });
-        self.consumers.push(Arc::downgrade(&consumer_data));
+        self.consumers
+            .insert(prefix, Arc::downgrade(&consumer_data));
         consumer_data
     }
 
-    pub(crate) fn on_stream_deleted(&mut self, _event: &str, key: &[u8]) {
-        let mut ids_to_remove = Vec::new();
-        self.tracked_streams.remove(key);
-        for (i, c) in self.consumers.iter().enumerate() {
-            let c = c.upgrade();
-            if c.is_none() {
-                ids_to_remove.push(i);
-                continue;
+    /// Return the live consumers whose prefix matches the given key.
+    fn matched_consumers(&self, key: &[u8]) -> Vec<Arc<RefCellWrapper<ConsumerData<T, C>>>> {
+        let mut res = Vec::new();
+        self.consumers.for_each_match(key, |c| {
+            if let Some(c) = c.upgrade() {
+                res.push(c);
             }
-            let c = c.unwrap();
+        });
+        res
+    }
+
+    /// Return `true` if any consumer reads the given stream.
+    pub(crate) fn is_stream_tracked(&self, key: &[u8]) -> bool {
+        self.tracked_streams.contains_key(key)
+    }
+
+    pub(crate) fn on_stream_deleted(&mut self, _event: &str, key: &[u8]) {
+        self.remove_tracked_stream(key);
+    }
+
+    /// Forget the given stream, a new stream with the same name is read from the start.
+    fn remove_tracked_stream(&mut self, key: &[u8]) {
+        if self.tracked_streams.remove(key).is_none() {
+            // no consumer reads this stream
+            return;
+        }
+        for c in self.matched_consumers(key) {
             let mut consumer_data = c.ref_cell.borrow_mut();
             consumer_data.consumed_streams.remove(key);
         }
     }
 
+    /// Reclaim the tracked streams that were idle since the last check and no
+    /// longer exist, which happens when a stream is deleted without a
+    /// deletion notification, for example when it is overwritten by a key of
+    /// another type. Idle streams that still exist keep the position of their
+    /// consumers, which is persisted, but release the memory of their pending
+    /// ids. Returns the reclaimed streams. Expected to be called periodically.
+    pub(crate) fn reclaim_idle_streams(&mut self, ctx: &Context) -> Vec<Vec<u8>> {
+        let now = now_ms();
+        if now.saturating_sub(self.last_idle_streams_check) < IDLE_STREAMS_CHECK_INTERVAL_MS {
+            return Vec::new();
+        }
+        self.last_idle_streams_check = now;
+
+        let idle_streams = self
+            .tracked_streams
+            .iter()
+            .filter_map(|(name, tracked_stream)| {
+                let mut t_s = tracked_stream.ref_cell.borrow_mut();
+                if std::mem::replace(&mut t_s.active, false) || t_s.trim_pending {
+                    return None;
+                }
+                let consumers_info = t_s
+                    .consumers_data
+                    .iter()
+                    .filter_map(Weak::upgrade)
+                    .collect::<Vec<_>>();
+                let busy = consumers_info.iter().any(|c_i| {
+                    let c_i = c_i.ref_cell.borrow();
+                    c_i.in_flight > 0 || c_i.batch_pending_since.is_some()
+                });
+                if busy {
+                    return None;
+                }
+                Some((name.clone(), consumers_info))
+            })
+            .collect::<Vec<_>>();
+
+        let mut reclaimed = Vec::new();
+        for (name, consumers_info) in idle_streams {
+            // the read fails if the key does not exist or is not a stream.
+            if (self.stream_reader)(ctx, &name, None, true).is_ok() {
+                consumers_info.iter().for_each(|c_i| {
+                    c_i.ref_cell.borrow_mut().pending_ids.shrink_to_fit();
+                });
+                continue;
+            }
+            self.remove_tracked_stream(&name);
+            reclaimed.push(name);
+        }
+        reclaimed
+    }
+
+    /// Drop dead consumers from the index and reclaim the tracked streams
+    /// that are no longer read by any consumer. Expected to be called periodically.
+    pub(crate) fn remove_dead_consumers(&mut self) {
+        if !self.has_dead_consumers.swap(false, Ordering::Relaxed) {
+            return;
+        }
+        self.consumers.retain(&mut |c| c.strong_count() > 0);
+        self.tracked_streams.retain(|_, t_s| {
+            let mut t_s = t_s.ref_cell.borrow_mut();
+            t_s.consumers_data.retain(|c| c.strong_count() > 0);
+            !t_s.consumers_data.is_empty()
+        });
+    }
+
+    /// Return the tracked stream of the given name, and whether it was created.
+    /// The consumers that already read the stream are not attached to a created
+    /// tracked stream, this is up to the caller.
     fn get_or_create_tracked_stream(
         &mut self,
         name: &[u8],
-    ) -> &std::sync::Arc<RefCellWrapper<TrackedStream>> {
-        self.tracked_streams
+    ) -> (Arc<RefCellWrapper<TrackedStream>>, bool) {
+        let mut is_new = false;
+        let res = self
+            .tracked_streams
             .entry(name.to_vec())
-            .or_insert(Arc::new(RefCellWrapper {
-                ref_cell: RefCell::new(TrackedStream {
-                    name: name.to_vec(),
-                    consumers_data: Vec::new(),
-                    stream_trimmer: Arc::clone(&self.stream_trimmer),
-                }),
-            }))
+            .or_insert_with(|| {
+                is_new = true;
+                Arc::new(RefCellWrapper {
+                    ref_cell: RefCell::new(TrackedStream {
+                        name: name.to_vec(),
+                        consumers_data: Vec::new(),
+                        stream_trimmer: Arc::clone(&self.stream_trimmer),
+                        streams_to_trim: Arc::clone(&self.streams_to_trim),
+                        trim_pending: false,
+                        acks_since_trim: 0,
+                        active: true,
+                    }),
+                })
+            });
+        (Arc::clone(res), is_new)
     }
 
     pub(crate) fn update_stream_for_consumer(
@@ -547,11 +883,10 @@ where
     ) {
         let mut c_d = consumer_data.ref_cell.borrow_mut();
         let (stream_info, is_new) = c_d.get_or_create_consumed_stream(stream_name);
-        if is_new {
-            let mut t_s = self
-                .get_or_create_tracked_stream(stream_name)
-                .ref_cell
-                .borrow_mut();
+        let (tracked_stream, is_new_tracked_stream) =
+            self.get_or_create_tracked_stream(stream_name);
+        if is_new || is_new_tracked_stream {
+            let mut t_s = tracked_stream.ref_cell.borrow_mut();
             t_s.consumers_data.push(Arc::downgrade(&stream_info));
         }
         stream_info.ref_cell.borrow_mut().last_read_id = Some(RedisModuleStreamID { ms, seq });
@@ -561,83 +896,146 @@ where
         self.tracked_streams.clear();
     }
 
+    /// Trim the streams that were acknowledged since the last call, so that
+    /// a stream is trimmed once per call regardless of the amount of acknowledged
+    /// records. Expected to be called periodically.
+    pub(crate) fn trim_pending_streams(&mut self, ctx: &Context) {
+        let streams_to_trim = std::mem::take(&mut *self.streams_to_trim.ref_cell.borrow_mut());
+        streams_to_trim.into_iter().for_each(|name| {
+            // the stream might have been deleted (or deleted and recreated) since.
+            if let Some(tracked_stream) = self.tracked_streams.get(&name) {
+                let mut t_s = tracked_stream.ref_cell.borrow_mut();
+                if t_s.trim_pending {
+                    t_s.trim(ctx);
+                }
+            }
+        });
+    }
+
+    /// Deliver partial batches that are waiting for more then their
+    /// consumer `max_batch_delay`. Expected to be called periodically.
+    pub(crate) fn flush_expired_batches(&mut self, ctx: &Context) {
+        let now = now_ms();
+        let mut consumers = Vec::new();
+        self.consumers
+            .for_each(&mut |c| consumers.extend(c.upgrade()));
+        let expired = consumers
+            .into_iter()
+            .flat_map(|consumer| {
+                let c = consumer.ref_cell.borrow();
+                let batch = match c.batch_config() {
+                    Some(b) if b.max_batch_delay > 0 => b,
+                    _ => return Vec::new(),
+                };
+                c.consumed_streams
+                    .iter()
+                    .filter(|(_, consumer_info)| {
+                        let c_i = consumer_info.ref_cell.borrow();
+                        !c.is_window_full(&c_i)
+                            && c_i.batch_pending_since.map_or(false, |since| {
+                                now.saturating_sub(since) >= batch.max_batch_delay as u128
+                            })
+                    })
+                    .map(|(name, consumer_info)| {
+                        (
+                            Arc::downgrade(&consumer),
+                            name.clone(),
+                            Arc::clone(consumer_info),
+                            batch,
+                        )
+                    })
+                    .collect::<Vec<_>>()
+            })
+            .collect::<Vec<_>>();
+
+        for (consumer_weak, name, consumer_info, batch) in expired {
+            let tracked_stream = match self.tracked_streams.get(&name) {
+                Some(t_s) => Arc::clone(t_s),
+                // the stream was deleted since.
+                None => continue,
+            };
+            let last_read_id = consumer_info.ref_cell.borrow().last_read_id;
+            let records = read_next_batch(
+                ctx,
+                &name,
+                last_read_id,
+                &consumer_info,
+                &self.stream_reader,
+                Some(&batch),
+                true,
+            );
+            send_new_data(
+                ctx,
+                tracked_stream,
+                consumer_weak,
+                records,
+                consumer_info,
+                Arc::clone(&self.stream_reader),
+            );
+        }
+    }
+
     pub(crate) fn on_stream_touched(&mut self, ctx: &Context, _event: &str, key: &[u8]) {
-        let mut ids_to_remove = Vec::new();
+        let consumers = self.matched_consumers(key);
+        if consumers.is_empty() {
+            // do not track streams that no consumer reads
+            return;
+        }
 
-        let tracked_stream = Arc::clone(self.get_or_create_tracked_stream(key));
+        let (tracked_stream, is_new_tracked_stream) = self.get_or_create_tracked_stream(key);
+        tracked_stream.ref_cell.borrow_mut().active = true;
 
-        let _ = self
-            .consumers
-            .iter()
-            .enumerate()
-            .filter(|(i, v)| {
-                let v = v.upgrade();
-                if v.is_none() {
-                    ids_to_remove.push(*i);
-                    return false;
-                }
-                let v = v.unwrap();
-                let v = v.ref_cell.borrow();
-                key.starts_with(&v.prefix)
-            })
-            .map(|(_, v)| {
-                let consumer = v.upgrade().unwrap();
+        let _ = consumers
+            .into_iter()
+            .filter_map(|consumer| {
                 let (record, consumer_info) = {
                     let mut c = consumer.ref_cell.borrow_mut();
                     let (consumer_info, is_new) = c.get_or_create_consumed_stream(key);
-                    if is_new {
+                    if is_new || is_new_tracked_stream {
                         let mut t_s = tracked_stream.ref_cell.borrow_mut();
                         t_s.consumers_data.push(Arc::downgrade(&consumer_info));
                     }
                     let last_read_id = {
                         let c_i = consumer_info.ref_cell.borrow();
-                        if c_i.pending_ids.len() >= c.window {
+                        if c.is_window_full(&c_i) {
                             return None;
                         }
                         c_i.last_read_id
                     };
 
                     (
-                        read_next_data(
+                        read_next_batch(
                             ctx,
                             key,
                             last_read_id,
-                            false,
                             &consumer_info,
                             &self.stream_reader,
+                            c.batch_config().as_ref(),
+                            false,
                         ),
                         Arc::clone(&consumer_info),
                     )
                 };
-                let res = (Weak::clone(v), record, consumer_info);
-                Some(res)
+                Some((Arc::downgrade(&consumer), record, consumer_info))
             })
-            .collect::<Vec<
-                Option<(
-                    Weak<RefCellWrapper<ConsumerData<T, C>>>,
-                    Result<Option<T>, String>,
-                    Arc<RefCellWrapper<ConsumerInfo>>,
-                )>,
-            >>()
+            .collect::<Vec<(
+                Weak<RefCellWrapper<ConsumerData<T, C>>>,
+                Result<Vec<T>, String>,
+                Arc<RefCellWrapper<ConsumerInfo>>,
+            )>>()
             .into_iter()
-            .map(|res| {
-                if let Some((consumer_weak, record, consumer_info)) = res {
-                    let stream_reader = Arc::clone(&self.stream_reader);
-                    let tracked_stream = Arc::clone(&tracked_stream);
-                    send_new_data(
-                        ctx,
-                        tracked_stream,
-                        consumer_weak,
-                        record,
-                        consumer_info,
-                        stream_reader,
-                    );
-                }
+            .map(|(consumer_weak, record, consumer_info)| {
+                let stream_reader = Arc::clone(&self.stream_reader);
+                let tracked_stream = Arc::clone(&tracked_stream);
+                send_new_data(
+                    ctx,
+                    tracked_stream,
+                    consumer_weak,
+                    record,
+                    consumer_info,
+                    stream_reader,
+                );
             })
             .collect::<Vec<()>>();
-
-        for id in ids_to_remove.iter().rev() {
-            self.consumers.swap_remove(*id);
-        }
     }
 }
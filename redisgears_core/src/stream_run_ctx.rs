@@ -6,7 +6,8 @@
 
 use redisgears_plugin_api::redisgears_plugin_api::{
     load_library_ctx::FunctionFlags, run_function_ctx::BackgroundRunFunctionCtxInterface,
-    run_function_ctx::RedisClientCtxInterface, stream_ctx::StreamCtxInterface,
+    run_function_ctx::RedisClientCtxInterface, stream_ctx::StreamAdaptiveWindowConfig,
+    stream_ctx::StreamBatchConfig, stream_ctx::StreamCtxInterface,
     stream_ctx::StreamProcessCtxInterface, stream_ctx::StreamRecordAck,
     stream_ctx::StreamRecordInterface,
 };
@@ -22,7 +23,7 @@ use crate::{
     GearsLibraryMetaData,
 };
 
-use crate::stream_reader::{StreamConsumer, StreamReaderAck};
+use crate::stream_reader::{AcknowledgeCallback, StreamConsumer, StreamReaderAck};
 
 use crate::get_notification_blocker;
 
@@ -89,13 +90,12 @@ impl StreamRecordInterface for GearsStreamRecord {
     }
 
     fn fields<'a>(&'a self) -> Box<dyn Iterator<Item = (&'a [u8], &'a [u8])> + 'a> {
-        let res = self
-            .record
-            .fields
-            .iter()
-            .map(|(k, v)| (k.as_slice(), v.as_slice()))
-            .collect::<Vec<(&'a [u8], &'a [u8])>>();
-        Box::new(res.into_iter())
+        Box::new(
+            self.record
+                .fields
+                .iter()
+                .map(|(k, v)| (k.as_slice(), v.as_slice())),
+        )
     }
 }
 
@@ -133,23 +133,49 @@ impl std::fmt::Debug for GearsStreamConsumer {
     }
 }
 
+impl GearsStreamConsumer {
+    fn verify_permissions(&self, ctx: &Context, stream_name: &[u8]) -> Result<(), GearsApiError> {
+        let user = &self.lib_meta_data.user;
+        let key_redis_str = RedisString::create_from_slice(std::ptr::null_mut(), stream_name);
+        ctx.acl_check_key_permission(user, &key_redis_str, &self.permissions)
+            .map_err(|e| {
+                GearsApiError::new(format!(
+                    "User '{}' has no permissions on key '{}', {}.",
+                    user,
+                    std::str::from_utf8(stream_name).unwrap_or("[binary data]"),
+                    e
+                ))
+            })
+    }
+
+    fn wrap_ack_callback(
+        ack_callback: Box<AcknowledgeCallback>,
+    ) -> Box<dyn FnOnce(StreamRecordAck) + Send> {
+        Box::new(|ack| {
+            // here we must take the redis lock
+            let ctx = ThreadSafeContext::new();
+            let gaurd = ctx.lock();
+            ack_callback(
+                &gaurd,
+                match ack {
+                    StreamRecordAck::Ack => StreamReaderAck::Ack,
+                    StreamRecordAck::Nack(msg) => StreamReaderAck::Nack(msg),
+                },
+            )
+        })
+    }
+}
+
 impl StreamConsumer<GearsStreamRecord> for GearsStreamConsumer {
     fn new_data(
         &self,
         ctx: &Context,
         stream_name: &[u8],
         record: GearsStreamRecord,
-        ack_callback: Box<dyn FnOnce(&Context, StreamReaderAck) + Send>,
+        ack_callback: Box<AcknowledgeCallback>,
     ) -> Option<StreamReaderAck> {
-        let user = &self.lib_meta_data.user;
-        let key_redis_str = RedisString::create_from_slice(std::ptr::null_mut(), stream_name);
-        if let Err(e) = ctx.acl_check_key_permission(user, &key_redis_str, &self.permissions) {
-            return Some(StreamReaderAck::Nack(GearsApiError::new(format!(
-                "User '{}' has no permissions on key '{}', {}.",
-                user,
-                std::str::from_utf8(stream_name).unwrap_or("[binary data]"),
-                e
-            ))));
+        if let Err(e) = self.verify_permissions(ctx, stream_name) {
+            return Some(StreamReaderAck::Nack(e));
         }
 
         let res = {
@@ -158,18 +184,37 @@ impl StreamConsumer<GearsStreamRecord> for GearsStreamConsumer {
                 stream_name,
                 Box::new(record),
                 &StreamRunCtx::new(ctx, &self.lib_meta_data, self.flags),
-                Box::new(|ack| {
-                    // here we must take the redis lock
-                    let ctx = ThreadSafeContext::new();
-                    let gaurd = ctx.lock();
-                    ack_callback(
-                        &gaurd,
-                        match ack {
-                            StreamRecordAck::Ack => StreamReaderAck::Ack,
-                            StreamRecordAck::Nack(msg) => StreamReaderAck::Nack(msg),
-                        },
-                    )
-                }),
+                Self::wrap_ack_callback(ack_callback),
+            )
+        };
+        res.map(|r| match r {
+            StreamRecordAck::Ack => StreamReaderAck::Ack,
+            StreamRecordAck::Nack(msg) => StreamReaderAck::Nack(msg),
+        })
+    }
+
+    fn new_data_batch(
+        &self,
+        ctx: &Context,
+        stream_name: &[u8],
+        records: Vec<GearsStreamRecord>,
+        ack_callback: Box<AcknowledgeCallback>,
+    ) -> Option<StreamReaderAck> {
+        if let Err(e) = self.verify_permissions(ctx, stream_name) {
+            return Some(StreamReaderAck::Nack(e));
+        }
+
+        let records = records
+            .into_iter()
+            .map(|r| Box::new(r) as Box<dyn StreamRecordInterface + Send>)
+            .collect();
+        let res = {
+            let _notification_blocker = get_notification_blocker();
+            self.ctx.process_records(
+                stream_name,
+                records,
+                &StreamRunCtx::new(ctx, &self.lib_meta_data, self.flags),
+                Self::wrap_ack_callback(ack_callback),
             )
         };
         res.map(|r| match r {
@@ -177,4 +222,12 @@ impl StreamConsumer<GearsStreamRecord> for GearsStreamConsumer {
             StreamRecordAck::Nack(msg) => StreamReaderAck::Nack(msg),
         })
     }
+
+    fn batch_config(&self) -> Option<StreamBatchConfig> {
+        self.ctx.batch_config()
+    }
+
+    fn adaptive_window_config(&self) -> Option<StreamAdaptiveWindowConfig> {
+        self.ctx.adaptive_window_config()
+    }
 }
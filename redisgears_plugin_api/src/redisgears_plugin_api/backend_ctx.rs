@@ -18,6 +18,19 @@ use super::load_library_ctx::ModuleInfo;
 use super::prologue::ApiVersion;
 use super::GearsApiResult;
 
+/// The priority of a background job. High priority jobs are preferred
+/// by the executor over low priority jobs, low priority jobs are still
+/// guaranteed to make progress.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum JobPriority {
+    /// Latency sensitive jobs, for example, a function invocation
+    /// which a client is waiting for.
+    High,
+    /// Bulk jobs, for example, processing stream records or key space
+    /// notifications in the background.
+    Low,
+}
+
 pub trait CompiledLibraryInterface {
     fn log_debug(&self, msg: &str);
     fn log_info(&self, msg: &str);
@@ -25,7 +38,16 @@ pub trait CompiledLibraryInterface {
     fn log_warning(&self, msg: &str);
     fn log_error(&self, msg: &str);
     fn log_script_message(&self, msg: &str);
+    /// Runs the job in the background with [`JobPriority::High`].
     fn run_on_background(&self, job: Box<dyn FnOnce() + Send>);
+    /// Runs the job in the background with the given priority. Jobs of
+    /// a single queue run in the order they were added regardless of
+    /// their priority.
+    fn run_on_background_with_priority(&self, job: Box<dyn FnOnce() + Send>, priority: JobPriority);
+    /// Returns another API object of the same library with its own
+    /// background jobs queue. Jobs of a single queue run one after the
+    /// other while jobs of different queues might run in parallel.
+    fn new_background_queue(&self) -> Box<dyn CompiledLibraryInterface + Send + Sync>;
     fn redisai_create_tensor(
         &self,
         data_type: &str,
@@ -105,8 +127,12 @@ pub trait BackendCtxInterfaceInitialised {
     /// Returns the name of the backend.
     fn get_name(&self) -> &'static str;
     fn get_version(&self) -> String;
+    /// Compiles the given library code. Each library is compiled
+    /// independently of the others, so this might be called from
+    /// multiple threads at the same time (while the main thread
+    /// is blocked waiting for all of them to finish).
     fn compile_library(
-        &mut self,
+        &self,
         debug: bool,
         module_name: &str,
         code: &str,
@@ -30,6 +30,48 @@ impl<T> NotificationCtxInterface for T where
 {
 }
 
+/// Conditions a key space notification must meet in order to fire a key
+/// space trigger. The conditions are checked before the trigger is invoked
+/// so notifications that are not relevant to the trigger cost no more than
+/// a few comparisons.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct KeySpaceTriggerFilter {
+    /// The events that fire the trigger, any event if `None`.
+    pub events: Option<Vec<String>>,
+    pub key_suffix: Option<Vec<u8>>,
+    pub min_key_length: Option<usize>,
+    pub max_key_length: Option<usize>,
+}
+
+impl KeySpaceTriggerFilter {
+    pub fn matches(&self, event: &str, key: &[u8]) -> bool {
+        if self.min_key_length.map_or(false, |v| key.len() < v)
+            || self.max_key_length.map_or(false, |v| key.len() > v)
+        {
+            return false;
+        }
+        if let Some(suffix) = self.key_suffix.as_ref() {
+            if !key.ends_with(suffix) {
+                return false;
+            }
+        }
+        self.events
+            .as_ref()
+            .map_or(true, |events| events.iter().any(|e| e == event))
+    }
+}
+
+/// Coalesces the notifications of each key, the trigger is fired once per
+/// key and window with the last event of the key.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct KeySpaceTriggerDebounceConfig {
+    /// The time to coalesce the notifications of a key, in milliseconds.
+    pub window: usize,
+    /// Fire the trigger before the window expires once a key
+    /// got this amount of notifications.
+    pub max_events: Option<usize>,
+}
+
 pub trait KeysNotificationsConsumerCtxInterface {
     fn on_notification_fired(
         &self,
@@ -38,4 +80,47 @@ pub trait KeysNotificationsConsumerCtxInterface {
         notification_ctx: &dyn NotificationCtxInterface,
         ack_callback: Box<dyn FnOnce(Result<(), GearsApiError>) + Send + Sync>,
     );
+
+    /// Return the filter of the notifications that should fire the trigger,
+    /// the trigger is fired on every notification of its keys if `None`.
+    fn filter(&self) -> Option<KeySpaceTriggerFilter> {
+        None
+    }
+
+    /// Return the debounce configuration of the trigger, the trigger is
+    /// fired on every notification if `None`.
+    fn debounce_config(&self) -> Option<KeySpaceTriggerDebounceConfig> {
+        None
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::KeySpaceTriggerFilter;
+
+    #[test]
+    fn test_filter() {
+        let filter = KeySpaceTriggerFilter::default();
+        assert!(filter.matches("set", b"key"));
+
+        let filter = KeySpaceTriggerFilter {
+            events: Some(vec!["hset".to_owned(), "hdel".to_owned()]),
+            ..Default::default()
+        };
+        assert!(filter.matches("hset", b"key"));
+        assert!(filter.matches("hdel", b"key"));
+        assert!(!filter.matches("del", b"key"));
+
+        let filter = KeySpaceTriggerFilter {
+            key_suffix: Some(b":meta".to_vec()),
+            min_key_length: Some(8),
+            max_key_length: Some(10),
+            ..Default::default()
+        };
+        assert!(filter.matches("set", b"foo:meta"));
+        assert!(filter.matches("set", b"fooba:meta"));
+        assert!(!filter.matches("set", b"foobar:meta"));
+        assert!(!filter.matches("set", b"fo:meta"));
+        assert!(!filter.matches("set", b"foo:metadata"));
+    }
 }
@@ -18,6 +18,10 @@ const ENGINE_PREFIX: &str = "#!";
 const PROLOGUE_API_VERSION_KEY: &str = "api_version";
 /// The key string for the library name within the prologue.
 const PROLOGUE_LIBRARY_NAME_KEY: &str = "name";
+/// The key string for the number of isolates within the prologue.
+const PROLOGUE_ISOLATES_KEY: &str = "isolates";
+/// The maximum number of isolates a library can ask for.
+pub const MAX_ISOLATES: usize = 32;
 
 /// The RedisGears API version.
 #[derive(Debug, Copy, Clone, Eq, PartialEq, Ord, PartialOrd, Hash)]
@@ -80,6 +84,9 @@ pub struct Prologue<'a> {
     pub api_version: ApiVersion,
     /// The name of the user library.
     pub library_name: &'a str,
+    /// The number of isolates to create for the library, the extra
+    /// isolates are used to run async functions in parallel.
+    pub isolates: usize,
 }
 
 /// The errors which the validator may find.
@@ -121,6 +128,11 @@ pub enum Error {
     DuplicatedPrologueProperties {
         duplicated_properties: Vec<String>,
     },
+    /// Indicates that the number of isolates is not a number
+    /// between 1 and [MAX_ISOLATES].
+    InvalidIsolates {
+        current: String,
+    },
 }
 
 impl From<Error> for GearsApiError {
@@ -178,6 +190,11 @@ impl From<Error> for GearsApiError {
                     duplicated_properties.join(", ")
                 )
             }
+            Error::InvalidIsolates { current } => {
+                format!(
+                    "Invalid number of isolates: \"{current}\". The number of isolates must be between 1 and {MAX_ISOLATES}."
+                )
+            }
         };
 
         Self::new(string)
@@ -192,7 +209,11 @@ pub type Result<T> = std::result::Result<T, Error>;
 /// The full user library code is expected to be passed here, or at
 /// least the very first line of it.
 pub fn parse_prologue(code: &str) -> Result<Prologue> {
-    const KNOWN_PROPERTIES: [&str; 2] = [PROLOGUE_API_VERSION_KEY, PROLOGUE_LIBRARY_NAME_KEY];
+    const KNOWN_PROPERTIES: [&str; 3] = [
+        PROLOGUE_API_VERSION_KEY,
+        PROLOGUE_LIBRARY_NAME_KEY,
+        PROLOGUE_ISOLATES_KEY,
+    ];
 
     let first_line = code.lines().next().ok_or(Error::InvalidOrMissingPrologue)?;
 
@@ -247,6 +268,17 @@ pub fn parse_prologue(code: &str) -> Result<Prologue> {
         .remove(PROLOGUE_LIBRARY_NAME_KEY)
         .ok_or(Error::MissingLibraryName)?;
 
+    let isolates = properties
+        .remove(PROLOGUE_ISOLATES_KEY)
+        .map_or(Ok(1), |v| {
+            v.parse::<usize>()
+                .ok()
+                .filter(|v| (1..=MAX_ISOLATES).contains(v))
+                .ok_or_else(|| Error::InvalidIsolates {
+                    current: v.to_owned(),
+                })
+        })?;
+
     if !properties.is_empty() {
         let specified_properties = properties
             .keys()
@@ -262,6 +294,7 @@ pub fn parse_prologue(code: &str) -> Result<Prologue> {
         engine,
         api_version,
         library_name,
+        isolates,
     })
 }
 
@@ -276,6 +309,25 @@ mod tests {
         assert_eq!(prologue.engine, "js");
         assert_eq!(prologue.api_version, ApiVersion(1, 0));
         assert_eq!(prologue.library_name, "test_lib");
+        assert_eq!(prologue.isolates, 1);
+    }
+
+    #[test]
+    fn test_isolates() {
+        let s = "#!js api_version=1.0 name=test_lib isolates=4";
+        let prologue = parse_prologue(s).unwrap();
+        assert_eq!(prologue.isolates, 4);
+
+        for isolates in ["0", "33", "x"] {
+            let s = format!("#!js api_version=1.0 name=test_lib isolates={isolates}");
+            let err = parse_prologue(&s).unwrap_err();
+            assert_eq!(
+                err,
+                Error::InvalidIsolates {
+                    current: isolates.to_owned()
+                }
+            );
+        }
     }
 
     #[test]
@@ -321,7 +373,8 @@ mod tests {
                 specified_properties: vec!["\"unknown_key\"".to_owned()],
                 known_properties: vec![
                     PROLOGUE_API_VERSION_KEY.to_owned(),
-                    PROLOGUE_LIBRARY_NAME_KEY.to_owned()
+                    PROLOGUE_LIBRARY_NAME_KEY.to_owned(),
+                    PROLOGUE_ISOLATES_KEY.to_owned(),
                 ]
             }
         );
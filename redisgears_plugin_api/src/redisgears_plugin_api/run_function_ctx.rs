@@ -36,6 +36,11 @@ pub enum PromiseReply<'root, 'ctx> {
 
 pub trait RedisClientCtxInterface {
     fn call(&self, command: &str, args: &[&[u8]]) -> CallResult;
+    /// Runs the given commands, each given as the command name and its
+    /// arguments, one after the other while authenticating the user only
+    /// once. Returns the result of each command, an error of one command
+    /// does not stop the following commands.
+    fn call_batch(&self, commands: &[(&str, Vec<&[u8]>)]) -> Vec<CallResult>;
     fn call_async(&self, command: &str, args: &[&[u8]]) -> PromiseReply<'static, '_>;
     fn get_background_redis_client(&self) -> Box<dyn BackgroundRunFunctionCtxInterface>;
     fn open_ai_model(&self, name: &str) -> Result<Box<dyn AIModelInterface>, GearsApiError>;
@@ -52,6 +57,18 @@ pub trait ReplyCtxInterface: Send + Sync {
 pub enum RemoteFunctionData {
     Binary(Vec<u8>),
     String(String),
+    /// A value encoded by the backend in its own binary format.
+    Serialized(Vec<u8>),
+}
+
+impl RemoteFunctionData {
+    /// Returns the raw bytes of the data.
+    pub fn as_bytes(&self) -> &[u8] {
+        match self {
+            RemoteFunctionData::Binary(b) | RemoteFunctionData::Serialized(b) => b,
+            RemoteFunctionData::String(s) => s.as_bytes(),
+        }
+    }
 }
 
 pub trait BackgroundRunFunctionCtxInterface: Send + Sync {
@@ -69,6 +86,31 @@ pub trait BackgroundRunFunctionCtxInterface: Send + Sync {
         inputs: Vec<RemoteFunctionData>,
         on_done: Box<dyn FnOnce(Vec<RemoteFunctionData>, Vec<GearsApiError>)>,
     );
+    /// Runs the remote function on all the shards, like [`Self::run_on_all_shards`],
+    /// but gives the result (or the error) of each shard to `on_result` as soon
+    /// as it arrives, instead of collecting the results of all the shards. A shard
+    /// which did not reply within `timeout_ms` (the remote task default timeout
+    /// if not given) is given as an error. `on_done` is called after the last shard.
+    fn run_on_each_shard(
+        &self,
+        job_name: &str,
+        inputs: Vec<RemoteFunctionData>,
+        timeout_ms: Option<usize>,
+        on_result: Box<dyn FnMut(Result<RemoteFunctionData, GearsApiError>)>,
+        on_done: Box<dyn FnOnce()>,
+    );
+    /// Runs the remote function once for each of the given keys, on the
+    /// shard holding the key. Each key comes with the data of its key
+    /// argument, which is given to the remote function before the inputs.
+    /// Keys which are sent to the same shard share a single remote task.
+    /// `on_done` gets the results in the order of the keys.
+    fn run_on_keys(
+        &self,
+        keys: Vec<(Vec<u8>, RemoteFunctionData)>,
+        job_name: &str,
+        inputs: Vec<RemoteFunctionData>,
+        on_done: Box<dyn FnOnce(Vec<Result<RemoteFunctionData, GearsApiError>>)>,
+    );
 }
 
 pub trait RunFunctionCtxInterface: ReplyCtxInterface {
@@ -17,6 +17,11 @@ pub trait StreamProcessCtxInterface {
 pub trait StreamRecordInterface {
     fn get_id(&self) -> (u64, u64);
     fn fields<'a>(&'a self) -> Box<dyn Iterator<Item = (&'a [u8], &'a [u8])> + 'a>;
+
+    /// Return the value of the first field with the given name.
+    fn get_field<'a>(&'a self, name: &[u8]) -> Option<&'a [u8]> {
+        self.fields().find(|(f, _)| *f == name).map(|(_, v)| v)
+    }
 }
 
 pub enum StreamRecordAck {
@@ -24,6 +29,27 @@ pub enum StreamRecordAck {
     Nack(GearsApiError),
 }
 
+/// Batching configuration of a stream consumer.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StreamBatchConfig {
+    /// The max amount of records to deliver on a single invocation.
+    pub batch_size: usize,
+    /// The max time (in ms) to wait for a batch to fill up before
+    /// delivering a partial batch, 0 means do not wait.
+    pub max_batch_delay: usize,
+}
+
+/// Adaptive window configuration of a stream consumer, the consumer
+/// window is used as the lower bound.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StreamAdaptiveWindowConfig {
+    /// The upper bound of the window.
+    pub max_window: usize,
+    /// The max processing time (in ms) of a delivery before the
+    /// window is decreased.
+    pub target_latency: usize,
+}
+
 pub trait StreamCtxInterface {
     fn process_record(
         &self,
@@ -32,4 +58,26 @@ pub trait StreamCtxInterface {
         run_ctx: &dyn StreamProcessCtxInterface,
         ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
     ) -> Option<StreamRecordAck>;
+
+    /// Process a batch of records, the batch is acknowledged as a unit.
+    /// Only called if [`StreamCtxInterface::batch_config`] returns a value.
+    fn process_records(
+        &self,
+        stream_name: &[u8],
+        records: Vec<Box<dyn StreamRecordInterface + Send>>,
+        run_ctx: &dyn StreamProcessCtxInterface,
+        ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
+    ) -> Option<StreamRecordAck>;
+
+    /// Return the batching configuration, `None` means that records
+    /// are delivered one by one using [`StreamCtxInterface::process_record`].
+    fn batch_config(&self) -> Option<StreamBatchConfig> {
+        None
+    }
+
+    /// Return the adaptive window configuration, `None` means that
+    /// the window is fixed.
+    fn adaptive_window_config(&self) -> Option<StreamAdaptiveWindowConfig> {
+        None
+    }
 }
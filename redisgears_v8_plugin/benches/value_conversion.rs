@@ -0,0 +1,144 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Micro benchmarks of the conversion of remote function arguments and
+//! results, of function results into RESP replies and of RESP replies into
+//! JS values, run with `cargo bench -p redisgears_v8_plugin --features bench`.
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use redisgears_v8_plugin::bench::{RespConversionBench, ValueConversionBench};
+
+fn values() -> Vec<(&'static str, String)> {
+    let array = (0..1000).map(|i| i.to_string()).collect::<Vec<_>>();
+    let objects = (0..100)
+        .map(|i| format!(r#"{{"id":{i},"name":"user:{i}","score":{i}.5,"active":true}}"#))
+        .collect::<Vec<_>>();
+    vec![
+        ("string", r#""foo""#.to_string()),
+        ("object", objects[0].clone()),
+        ("int_array_1000", format!("[{}]", array.join(","))),
+        ("object_array_100", format!("[{}]", objects.join(","))),
+    ]
+}
+
+fn value_conversion(c: &mut Criterion) {
+    let mut group = c.benchmark_group("remote_function_data");
+    for (name, json) in values() {
+        let bench = ValueConversionBench::new(&json);
+        for (serialization, binary) in [("json", false), ("binary", true)] {
+            group.bench_function(
+                BenchmarkId::new(format!("serialize_{serialization}"), name),
+                |b| b.iter(|| bench.serialize(binary)),
+            );
+            let data = bench.serialize(binary);
+            group.bench_function(
+                BenchmarkId::new(format!("deserialize_{serialization}"), name),
+                |b| b.iter(|| bench.deserialize(&data)),
+            );
+        }
+    }
+    group.finish();
+}
+
+fn to_resp(c: &mut Criterion) {
+    let mut group = c.benchmark_group("to_resp");
+    for (name, json) in values() {
+        let bench = ValueConversionBench::new(&json);
+        group.bench_function(name, |b| b.iter(|| bench.to_resp()));
+    }
+    let bench =
+        ValueConversionBench::from_script("Array.from({length: 10000}, (_, i) => 'value' + i)");
+    group.bench_function("string_array_10k", |b| b.iter(|| bench.to_resp()));
+    group.finish();
+}
+
+/// RESP3 encoded 10k elements replies, as returned by `LRANGE`, `HGETALL`
+/// and by a command with verbatim string elements.
+fn resp_replies() -> Vec<(&'static str, Vec<u8>)> {
+    let bulk = |s: String| format!("${}\r\n{}\r\n", s.len(), s);
+    let verbatim = |s: String| format!("={}\r\ntxt:{}\r\n", s.len() + 4, s);
+    let lrange = (0..10000)
+        .map(|i| bulk(format!("value{i}")))
+        .collect::<String>();
+    let hgetall = (0..10000)
+        .map(|i| bulk(format!("field{i}")) + &bulk(format!("value{i}")))
+        .collect::<String>();
+    let verbatims = (0..10000)
+        .map(|i| verbatim(format!("value{i}")))
+        .collect::<String>();
+    vec![
+        ("lrange_10k", format!("*10000\r\n{lrange}").into_bytes()),
+        ("hgetall_10k", format!("%10000\r\n{hgetall}").into_bytes()),
+        (
+            "verbatim_10k",
+            format!("*10000\r\n{verbatims}").into_bytes(),
+        ),
+    ]
+}
+
+fn resp_to_js(c: &mut Criterion) {
+    let mut group = c.benchmark_group("resp_to_js");
+    for (name, resp) in resp_replies() {
+        let bench = RespConversionBench::new(resp);
+        for (decoding, decode_responses) in [("decoded", true), ("raw", false)] {
+            group.bench_function(BenchmarkId::new(decoding, name), |b| {
+                b.iter(|| bench.to_js(decode_responses, true))
+            });
+        }
+    }
+    group.finish();
+}
+
+/// Compares sharing the reply type property names by all the elements of
+/// a 10k elements reply with creating them for each element, in both
+/// directions. Both runs convert the whole reply, only the creation of
+/// the names differs. Only status, verbatim and big number replies use
+/// the names, the `lrange_10k` and `hgetall_10k` runs are expected to
+/// take the same time.
+fn reply_type_keys(c: &mut Criterion) {
+    let mut group = c.benchmark_group("reply_type_keys");
+    let replies = [
+        (
+            "status_10k",
+            "Array.from({length: 10000}, () => { \
+                let s = new String('OK'); s.__reply_type = 'status'; return s; })",
+        ),
+        (
+            "verbatim_10k",
+            "Array.from({length: 10000}, (_, i) => { \
+                let s = new String('value' + i); \
+                s.__reply_type = 'verbatim'; s.__format = 'txt'; return s; })",
+        ),
+    ];
+    for (name, code) in replies {
+        let bench = ValueConversionBench::from_script(code);
+        group.bench_function(BenchmarkId::new("to_resp_shared", name), |b| {
+            b.iter(|| bench.to_resp())
+        });
+        group.bench_function(BenchmarkId::new("to_resp_per_element", name), |b| {
+            b.iter(|| bench.to_resp_per_element_keys())
+        });
+    }
+    for (name, resp) in resp_replies() {
+        let bench = RespConversionBench::new(resp);
+        group.bench_function(BenchmarkId::new("to_js_shared", name), |b| {
+            b.iter(|| bench.to_js(true, true))
+        });
+        group.bench_function(BenchmarkId::new("to_js_per_element", name), |b| {
+            b.iter(|| bench.to_js(true, false))
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(
+    benches,
+    value_conversion,
+    to_resp,
+    resp_to_js,
+    reply_type_keys
+);
+criterion_main!(benches);
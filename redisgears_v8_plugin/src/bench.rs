@@ -0,0 +1,313 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! Drivers for the JS value conversions, used by the criterion
+//! benchmarks under `benches/` to measure them on an embedded isolate,
+//! without a Redis server. Only compiled with the `bench` feature.
+//!
+//! Call replies can only be created by a running Redis server, so the
+//! conversion of replies into JS values is driven by [`RespConversionBench`],
+//! which parses a RESP3 encoded reply and converts it with the same
+//! functions as `call_result_to_js_object`. The `rg_fcall_*_10k` memtier
+//! benchmarks measure it on a real server.
+
+use redis_module::{RedisResult, RedisValue};
+use redisgears_plugin_api::redisgears_plugin_api::RemoteFunctionData;
+use v8_rs::v8::{
+    isolate::V8Isolate,
+    isolate_scope::V8IsolateScope,
+    v8_context::V8Context,
+    v8_context_scope::V8ContextScope,
+    v8_init_platform, v8_init_with_error_handlers,
+    v8_value::{V8LocalValue, V8PersistValue},
+};
+
+use crate::v8_function_ctx::v8_value_to_call_result;
+use crate::v8_native_functions::{
+    array_to_js_object, bulk_string_to_js_object, js_value_to_remote_function_data,
+    map_to_js_object, remote_function_data_to_js_value, verbatim_string_to_js_object,
+    ReplyTypeKeys,
+};
+
+use std::sync::Once;
+
+static V8_INIT: Once = Once::new();
+
+fn init_v8() {
+    V8_INIT.call_once(|| {
+        v8_init_platform(1, None).unwrap();
+        v8_init_with_error_handlers(
+            Box::new(|line, msg| panic!("v8 fatal error on {}, {}", line, msg)),
+            Box::new(|line, is_heap_oom| {
+                panic!("v8 oom error on {}, is_heap_oom:{}", line, is_heap_oom)
+            }),
+        )
+        .unwrap();
+    });
+}
+
+/// Converts a JS value to and from [`RemoteFunctionData`], the way
+/// remote function arguments and results are passed between shards,
+/// and into a RESP reply, the way function results are returned.
+pub struct ValueConversionBench {
+    // declared first so it will be freed before the isolate.
+    value: V8PersistValue,
+    ctx: V8Context,
+    isolate: V8Isolate,
+}
+
+impl ValueConversionBench {
+    /// Creates an isolate with the value described by the given JSON.
+    pub fn new(json: &str) -> ValueConversionBench {
+        Self::with_value(|ctx_scope, isolate_scope| {
+            let json = isolate_scope.new_string(json);
+            ctx_scope
+                .new_object_from_json(&json)
+                .expect("Failed parsing the benchmark value")
+                .persist()
+        })
+    }
+
+    /// Creates an isolate with the value returned by the given script,
+    /// for values that can not be described by JSON.
+    pub fn from_script(code: &str) -> ValueConversionBench {
+        Self::with_value(|ctx_scope, isolate_scope| {
+            let code = isolate_scope.new_string(code);
+            ctx_scope
+                .compile(&code)
+                .expect("Failed compiling the benchmark script")
+                .run(ctx_scope)
+                .expect("Failed running the benchmark script")
+                .persist()
+        })
+    }
+
+    fn with_value(
+        create_value: impl FnOnce(&V8ContextScope, &V8IsolateScope) -> V8PersistValue,
+    ) -> ValueConversionBench {
+        init_v8();
+        let isolate = V8Isolate::new();
+        let (ctx, value) = {
+            let isolate_scope = isolate.enter();
+            let ctx = isolate_scope.new_context(None);
+            let value = {
+                let ctx_scope = ctx.enter(&isolate_scope);
+                create_value(&ctx_scope, &isolate_scope)
+            };
+            (ctx, value)
+        };
+        ValueConversionBench {
+            value,
+            ctx,
+            isolate,
+        }
+    }
+
+    /// Serializes the value, as JSON or with the binary serialization.
+    pub fn serialize(&self, binary: bool) -> RemoteFunctionData {
+        let isolate_scope = self.isolate.enter();
+        let ctx_scope = self.ctx.enter(&isolate_scope);
+        let value = self.value.as_local(&isolate_scope);
+        js_value_to_remote_function_data(&isolate_scope, &ctx_scope, &value, binary).unwrap()
+    }
+
+    /// Deserializes the given data into a JS value.
+    pub fn deserialize(&self, data: &RemoteFunctionData) {
+        let isolate_scope = self.isolate.enter();
+        let ctx_scope = self.ctx.enter(&isolate_scope);
+        remote_function_data_to_js_value(&isolate_scope, &ctx_scope, data).unwrap();
+    }
+
+    /// Converts the value into a RESP reply.
+    pub fn to_resp(&self) {
+        let isolate_scope = self.isolate.enter();
+        let ctx_scope = self.ctx.enter(&isolate_scope);
+        let value = self.value.as_local(&isolate_scope);
+        let keys = ReplyTypeKeys::default();
+        v8_value_to_call_result(0, &isolate_scope, &ctx_scope, value, &keys).unwrap();
+    }
+
+    /// Converts the array value into a RESP reply like [`Self::to_resp`],
+    /// but with a [`ReplyTypeKeys`] for each element, creating the reply
+    /// type property names for every element like the conversion did
+    /// before they were shared by the whole reply.
+    pub fn to_resp_per_element_keys(&self) {
+        let isolate_scope = self.isolate.enter();
+        let ctx_scope = self.ctx.enter(&isolate_scope);
+        let value = self.value.as_local(&isolate_scope);
+        let res: RedisResult = value
+            .as_array()
+            .iter(&ctx_scope)
+            .map(|v| {
+                let keys = ReplyTypeKeys::default();
+                v8_value_to_call_result(1, &isolate_scope, &ctx_scope, v, &keys)
+            })
+            .collect::<Result<Vec<_>, _>>()
+            .map(RedisValue::Array);
+        res.unwrap();
+    }
+}
+
+/// Converts a RESP3 encoded reply into a JS value, the way the replies of
+/// `redis.call` are converted.
+pub struct RespConversionBench {
+    resp: Vec<u8>,
+    ctx: V8Context,
+    isolate: V8Isolate,
+}
+
+impl RespConversionBench {
+    /// Creates an isolate to convert the given RESP3 encoded reply.
+    pub fn new(resp: Vec<u8>) -> RespConversionBench {
+        init_v8();
+        let isolate = V8Isolate::new();
+        let ctx = {
+            let isolate_scope = isolate.enter();
+            isolate_scope.new_context(None)
+        };
+        RespConversionBench { resp, ctx, isolate }
+    }
+
+    /// Converts the reply into a JS value. With `shared_keys` the reply
+    /// type property names are shared by the whole reply, like
+    /// `call_result_to_js_object` does, otherwise they are created for
+    /// every element which uses them, like it did before.
+    pub fn to_js(&self, decode_responses: bool, shared_keys: bool) {
+        let isolate_scope = self.isolate.enter();
+        let ctx_scope = self.ctx.enter(&isolate_scope);
+        let keys = ReplyTypeKeys::default();
+        let mut reader = RespReader {
+            data: &self.resp,
+            pos: 0,
+        };
+        resp_to_js_object(
+            &isolate_scope,
+            &ctx_scope,
+            &mut reader,
+            decode_responses,
+            shared_keys.then_some(&keys),
+        )
+        .unwrap();
+        assert_eq!(reader.pos, self.resp.len());
+    }
+}
+
+struct RespReader<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> RespReader<'a> {
+    fn read_slice(&mut self, len: usize) -> Result<&'a [u8], String> {
+        let res = self
+            .data
+            .get(self.pos..self.pos + len)
+            .ok_or("Unexpected end of reply")?;
+        self.pos += len;
+        Ok(res)
+    }
+
+    fn read_line(&mut self) -> Result<&'a [u8], String> {
+        let len = self.data[self.pos..]
+            .windows(2)
+            .position(|w| w == b"\r\n")
+            .ok_or("Unexpected end of reply")?;
+        let res = self.read_slice(len)?;
+        self.pos += 2;
+        Ok(res)
+    }
+
+    fn read_integer(&mut self) -> Result<i64, String> {
+        std::str::from_utf8(self.read_line()?)
+            .ok()
+            .and_then(|l| l.parse().ok())
+            .ok_or_else(|| "Malformed integer".to_string())
+    }
+
+    fn read_len(&mut self) -> Result<usize, String> {
+        usize::try_from(self.read_integer()?).map_err(|_| "Malformed length".to_string())
+    }
+
+    fn read_bulk(&mut self) -> Result<&'a [u8], String> {
+        let len = self.read_len()?;
+        let res = self.read_slice(len)?;
+        self.pos += 2;
+        Ok(res)
+    }
+}
+
+fn resp_to_js_object<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope,
+    reader: &mut RespReader,
+    decode_responses: bool,
+    keys: Option<&ReplyTypeKeys<'isolate_scope, 'isolate>>,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    let reply_type = reader.read_slice(1)?[0];
+    Ok(match reply_type {
+        b'$' => bulk_string_to_js_object(isolate_scope, reader.read_bulk()?, decode_responses)?,
+        b':' => isolate_scope.new_long(reader.read_integer()?),
+        b'_' => {
+            reader.read_line()?;
+            isolate_scope.new_null()
+        }
+        b'=' => {
+            let data = reader.read_bulk()?;
+            let format = data
+                .get(..3)
+                .and_then(|f| std::str::from_utf8(f).ok())
+                .ok_or("Could not decode format as string")?;
+            let data = &data[4..];
+            match keys {
+                Some(keys) => verbatim_string_to_js_object(
+                    isolate_scope,
+                    ctx_scope,
+                    format,
+                    data,
+                    decode_responses,
+                    keys,
+                )?,
+                None => verbatim_string_to_js_object(
+                    isolate_scope,
+                    ctx_scope,
+                    format,
+                    data,
+                    decode_responses,
+                    &ReplyTypeKeys::default(),
+                )?,
+            }
+        }
+        b'*' => {
+            let len = reader.read_len()?;
+            array_to_js_object(
+                isolate_scope,
+                (0..len).map(|_| {
+                    resp_to_js_object(isolate_scope, ctx_scope, reader, decode_responses, keys)
+                }),
+            )?
+        }
+        b'%' => {
+            let len = reader.read_len()?;
+            map_to_js_object(
+                isolate_scope,
+                ctx_scope,
+                (0..len).map(|_| {
+                    // map keys are always decoded.
+                    let key = resp_to_js_object(isolate_scope, ctx_scope, reader, true, keys)?;
+                    let val = resp_to_js_object(
+                        isolate_scope,
+                        ctx_scope,
+                        reader,
+                        decode_responses,
+                        keys,
+                    )?;
+                    Ok::<_, String>((key, val))
+                }),
+            )?
+        }
+        t => return Err(format!("Unsupported reply type '{}'", t as char)),
+    })
+}
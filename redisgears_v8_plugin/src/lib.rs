@@ -20,12 +20,16 @@ use redisgears_plugin_api::redisgears_plugin_api::{
     GearsApiError,
 };
 
+#[cfg(feature = "bench")]
+#[doc(hidden)]
+pub mod bench;
 mod v8_backend;
 mod v8_function_ctx;
 mod v8_native_functions;
 mod v8_notifications_ctx;
 mod v8_redisai;
 mod v8_script_ctx;
+mod v8_serializer;
 mod v8_stream_ctx;
 
 use crate::v8_backend::V8Backend;
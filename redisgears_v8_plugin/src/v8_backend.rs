@@ -13,7 +13,7 @@ use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::{
     BackendCtxInterfaceInitialised, DebuggerBackend, DebuggerBackendPayload,
 };
 use redisgears_plugin_api::redisgears_plugin_api::load_library_ctx::{InfoSectionData, ModuleInfo};
-use redisgears_plugin_api::redisgears_plugin_api::prologue::ApiVersion;
+use redisgears_plugin_api::redisgears_plugin_api::prologue::{self, ApiVersion};
 use redisgears_plugin_api::redisgears_plugin_api::GearsApiResult;
 use redisgears_plugin_api::redisgears_plugin_api::{
     backend_ctx::BackendCtx, backend_ctx::BackendCtxInterfaceUninitialised,
@@ -26,7 +26,7 @@ use v8_rs::v8::isolate_scope::GarbageCollectionJobType;
 use v8_rs::v8::{v8_init_platform, v8_version};
 
 use crate::v8_native_functions::{initialize_globals_for_version, ApiVersionSupported};
-use crate::v8_script_ctx::V8ScriptCtx;
+use crate::v8_script_ctx::{IsolateRole, V8ScriptCtx};
 
 use v8_rs::v8::{isolate::V8Isolate, v8_init_with_error_handlers};
 
@@ -636,7 +636,7 @@ fn check_isolates_memory_limit(
 }
 
 impl V8Backend {
-    fn isolates_gc(&mut self) {
+    fn isolates_gc(&self) {
         let mut l = self.script_ctx_vec.lock().unwrap();
         let indexes = l
             .iter()
@@ -689,88 +689,19 @@ impl V8Backend {
             .map_err(|e| GearsApiError::new(e.to_string()))?;
         Ok(())
     }
-}
-
-impl BackendCtxInterfaceUninitialised for V8Backend {
-    fn get_name(&self) -> &'static str {
-        Self::NAME
-    }
-
-    fn on_load(&self, backend_ctx: BackendCtx) -> Result<(), GearsApiError> {
-        unsafe {
-            GLOBAL.backend_ctx = Some(backend_ctx);
-            GLOBAL.bypassed_memory_limit = Some(AtomicBool::new(false));
-            GLOBAL.script_ctx_vec = Some(Arc::clone(&self.script_ctx_vec));
-        }
-
-        std::panic::set_hook(Box::new(|panic_info| {
-            log_error(&format!("Application panicked, {}", panic_info));
-            let (file, line) = match panic_info.location() {
-                Some(l) => (l.file(), l.line()),
-                None => ("", 0),
-            };
-            let file = std::ffi::CString::new(file).unwrap();
-            unsafe {
-                redis_module::raw::RedisModule__Assert.unwrap()(
-                    "Crashed on panic\0".as_ptr() as *const std::os::raw::c_char,
-                    file.as_ptr(),
-                    line as i32,
-                );
-            }
-        }));
-
-        let flags = get_v8_flags();
-        let flags = if flags.starts_with('\'') && flags.len() > 1 {
-            &flags[1..flags.len() - 1]
-        } else {
-            &flags
-        };
 
-        v8_init_platform(1, Some(flags)).map_err(GearsApiError::new)
-    }
-
-    fn initialize(
-        self: Box<Self>,
-        logger: &'static dyn log::Log,
-    ) -> Result<Box<dyn BackendCtxInterfaceInitialised>, GearsApiError> {
-        unsafe {
-            LOGGER.0 = logger;
-
-            log::set_logger(&LOGGER)
-                .map(|()| log::set_max_level(log::LevelFilter::Trace))
-                .expect("Couldn't set the logger");
-        }
-
-        self.initialize_v8_engine()?;
-        self.spawn_background_maintenance_thread()?;
-
-        Ok(self)
-    }
-}
-
-impl BackendCtxInterfaceInitialised for V8Backend {
-    fn get_name(&self) -> &'static str {
-        Self::NAME
-    }
-
-    fn get_version(&self) -> String {
-        format!(
-            "Version: {}, v8-rs: {}, profile:{}",
-            v8_version(),
-            v8_rs::GIT_SEMVER,
-            v8_rs::PROFILE
-        )
-    }
-
-    fn compile_library(
-        &mut self,
+    /// Creates a new isolate and compiles the library code on it.
+    #[allow(clippy::too_many_arguments)]
+    fn create_script_ctx(
+        &self,
         debug: bool,
         module_name: &str,
         code: &str,
         api_version: ApiVersion,
         config: Option<&String>,
         compiled_library_api: Box<dyn CompiledLibraryInterface + Send + Sync>,
-    ) -> Result<Box<dyn LibraryCtxInterface>, GearsApiError> {
+        role: IsolateRole,
+    ) -> Result<Arc<V8ScriptCtx>, GearsApiError> {
         if calc_isolates_used_memory() >= max_memory_limit() {
             return Err(GearsApiError::new(
                 "JS engine reached OOM state and can not run any more code",
@@ -831,6 +762,7 @@ impl BackendCtxInterfaceInitialised for V8Backend {
                 inspector.map(Arc::new),
                 tensor_obj_template,
                 compiled_library_api,
+                role,
             ));
 
             let len = {
@@ -920,6 +852,121 @@ impl BackendCtxInterfaceInitialised for V8Backend {
             script_ctx
         };
 
+        Ok(script_ctx)
+    }
+}
+
+impl BackendCtxInterfaceUninitialised for V8Backend {
+    fn get_name(&self) -> &'static str {
+        Self::NAME
+    }
+
+    fn on_load(&self, backend_ctx: BackendCtx) -> Result<(), GearsApiError> {
+        unsafe {
+            GLOBAL.backend_ctx = Some(backend_ctx);
+            GLOBAL.bypassed_memory_limit = Some(AtomicBool::new(false));
+            GLOBAL.script_ctx_vec = Some(Arc::clone(&self.script_ctx_vec));
+        }
+
+        std::panic::set_hook(Box::new(|panic_info| {
+            log_error(&format!("Application panicked, {}", panic_info));
+            let (file, line) = match panic_info.location() {
+                Some(l) => (l.file(), l.line()),
+                None => ("", 0),
+            };
+            let file = std::ffi::CString::new(file).unwrap();
+            unsafe {
+                redis_module::raw::RedisModule__Assert.unwrap()(
+                    "Crashed on panic\0".as_ptr() as *const std::os::raw::c_char,
+                    file.as_ptr(),
+                    line as i32,
+                );
+            }
+        }));
+
+        let flags = get_v8_flags();
+        let flags = if flags.starts_with('\'') && flags.len() > 1 {
+            &flags[1..flags.len() - 1]
+        } else {
+            &flags
+        };
+
+        v8_init_platform(1, Some(flags)).map_err(GearsApiError::new)
+    }
+
+    fn initialize(
+        self: Box<Self>,
+        logger: &'static dyn log::Log,
+    ) -> Result<Box<dyn BackendCtxInterfaceInitialised>, GearsApiError> {
+        unsafe {
+            LOGGER.0 = logger;
+
+            log::set_logger(&LOGGER)
+                .map(|()| log::set_max_level(log::LevelFilter::Trace))
+                .expect("Couldn't set the logger");
+        }
+
+        self.initialize_v8_engine()?;
+        self.spawn_background_maintenance_thread()?;
+
+        Ok(self)
+    }
+}
+
+impl BackendCtxInterfaceInitialised for V8Backend {
+    fn get_name(&self) -> &'static str {
+        Self::NAME
+    }
+
+    fn get_version(&self) -> String {
+        format!(
+            "Version: {}, v8-rs: {}, profile:{}",
+            v8_version(),
+            v8_rs::GIT_SEMVER,
+            v8_rs::PROFILE
+        )
+    }
+
+    fn compile_library(
+        &self,
+        debug: bool,
+        module_name: &str,
+        code: &str,
+        api_version: ApiVersion,
+        config: Option<&String>,
+        compiled_library_api: Box<dyn CompiledLibraryInterface + Send + Sync>,
+    ) -> Result<Box<dyn LibraryCtxInterface>, GearsApiError> {
+        let isolates = prologue::parse_prologue(code)
+            .map_err(GearsApiError::from)?
+            .isolates;
+        // The additional isolates are only used to run async functions in
+        // parallel, they are not created when debugging the library.
+        let async_pool = if debug {
+            Vec::new()
+        } else {
+            (1..isolates)
+                .map(|_| {
+                    self.create_script_ctx(
+                        false,
+                        module_name,
+                        code,
+                        api_version,
+                        config,
+                        compiled_library_api.new_background_queue(),
+                        IsolateRole::AsyncPoolMember,
+                    )
+                })
+                .collect::<Result<Vec<_>, _>>()?
+        };
+        let script_ctx = self.create_script_ctx(
+            debug,
+            module_name,
+            code,
+            api_version,
+            config,
+            compiled_library_api,
+            IsolateRole::Main(async_pool),
+        )?;
         Ok(Box::new(V8LibraryCtx { script_ctx }))
     }
 
@@ -19,12 +19,13 @@ use v8_rs::v8::{
     v8_value::V8PersistValue,
 };
 
-use crate::v8_native_functions::{get_backgrounnd_client, RedisClient};
+use crate::v8_native_functions::{get_backgrounnd_client, RedisClient, ReplyTypeKeys};
 use crate::v8_script_ctx::{GilStatus, V8ScriptCtx};
 use crate::{get_exception_msg, v8_backend::bypass_memory_limit};
 
 use std::cell::RefCell;
 use std::collections::{HashMap, HashSet};
+use std::sync::atomic::{AtomicUsize, Ordering};
 use std::sync::Arc;
 
 use std::str;
@@ -55,28 +56,27 @@ fn v8_value_to_redis_value_key(val: V8LocalValue) -> Result<RedisValueKey, Redis
     })
 }
 
-fn v8_value_to_call_result(
+pub(crate) fn v8_value_to_call_result<'isolate_scope, 'isolate>(
     nesting_level: usize,
-    isolate_scope: &V8IsolateScope,
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
     ctx_scope: &V8ContextScope,
     val: V8LocalValue,
+    keys: &ReplyTypeKeys<'isolate_scope, 'isolate>,
 ) -> RedisResult {
     if nesting_level > 100 {
         return Err(RedisError::Str("nesting level reached"));
     }
-    Ok(if val.is_long() {
+    // strings are checked first as they are the most common elements of large replies.
+    Ok(if val.is_string() {
+        RedisValue::BulkString(val.to_utf8().unwrap().as_str().to_string())
+    } else if val.is_long() {
         RedisValue::Integer(val.get_long())
     } else if val.is_number() {
         RedisValue::Float(val.get_number())
-    } else if val.is_string() {
-        RedisValue::BulkString(val.to_utf8().unwrap().as_str().to_string())
     } else if val.is_string_object() {
         // check the type of the reply
         let obj_reply = val.as_object();
-        let reply_type = obj_reply.get(
-            ctx_scope,
-            &isolate_scope.new_string("__reply_type").to_value(),
-        );
+        let reply_type = obj_reply.get(ctx_scope, keys.reply_type(isolate_scope));
         if let Some(t) = reply_type {
             if let Some(reply_type_v8_str) = t.to_utf8() {
                 if reply_type_v8_str.as_str() == "status" {
@@ -85,7 +85,7 @@ fn v8_value_to_call_result(
                     ));
                 } else if reply_type_v8_str.as_str() == "verbatim" {
                     let format = obj_reply
-                        .get_str_field(ctx_scope, "__format")
+                        .get(ctx_scope, keys.format(isolate_scope))
                         .and_then(|v| v.to_utf8());
                     return Ok(RedisValue::VerbatimString((
                         format
@@ -99,6 +99,13 @@ fn v8_value_to_call_result(
             }
         }
         RedisValue::BulkString(val.to_utf8().unwrap().as_str().to_string())
+    } else if val.is_array() {
+        let arr = val.as_array();
+        let res: Result<Vec<RedisValue>, RedisError> = arr
+            .iter(ctx_scope)
+            .map(|v| v8_value_to_call_result(nesting_level + 1, isolate_scope, ctx_scope, v, keys))
+            .collect();
+        RedisValue::Array(res?)
     } else if val.is_array_buffer() {
         let val = val.as_array_buffer();
         RedisValue::StringBuffer(val.data().to_vec())
@@ -114,23 +121,22 @@ fn v8_value_to_call_result(
             .map(v8_value_to_redis_value_key)
             .collect();
         RedisValue::Set(res?)
-    } else if val.is_array() {
-        let arr = val.as_array();
-        let res: Result<Vec<RedisValue>, RedisError> = arr
-            .iter(ctx_scope)
-            .map(|v| v8_value_to_call_result(nesting_level + 1, isolate_scope, ctx_scope, v))
-            .collect();
-        RedisValue::Array(res?)
     } else if val.is_object() {
         let res = val.as_object();
-        let keys = res.get_property_names(ctx_scope);
-        let result: Result<HashMap<RedisValueKey, RedisValue>, RedisError> = keys
+        let keys_arr = res.get_property_names(ctx_scope);
+        let result: Result<HashMap<RedisValueKey, RedisValue>, RedisError> = keys_arr
             .iter(ctx_scope)
             .map(|key| {
                 let obj = res.get(ctx_scope, &key).unwrap();
                 Ok((
                     v8_value_to_redis_value_key(key)?,
-                    v8_value_to_call_result(nesting_level + 1, isolate_scope, ctx_scope, obj)?,
+                    v8_value_to_call_result(
+                        nesting_level + 1,
+                        isolate_scope,
+                        ctx_scope,
+                        obj,
+                        keys,
+                    )?,
                 ))
             })
             .collect();
@@ -146,7 +152,8 @@ fn send_reply(
     client: &dyn ReplyCtxInterface,
     val: V8LocalValue,
 ) {
-    let reply = v8_value_to_call_result(0, isolate_scope, ctx_scope, val);
+    let keys = ReplyTypeKeys::default();
+    let reply = v8_value_to_call_result(0, isolate_scope, ctx_scope, val, &keys);
     client.send_reply(reply);
 }
 
@@ -355,6 +362,10 @@ impl V8InternalFunction {
 
 pub struct V8Function {
     inner_function: Arc<V8InternalFunction>,
+    /// The same function on the library additional isolates, async
+    /// invocations are dispatched between all the isolates.
+    async_pool: Vec<Arc<V8InternalFunction>>,
+    next_isolate: AtomicUsize,
     client: Arc<RefCell<RedisClient>>,
     is_async: bool,
     decode_arguments: bool,
@@ -377,11 +388,38 @@ impl V8Function {
                 persisted_function,
                 persisted_client,
             }),
+            async_pool: Vec::new(),
+            next_isolate: AtomicUsize::new(0),
             client: Arc::clone(client),
             is_async,
             decode_arguments,
         }
     }
+
+    pub(crate) fn is_async(&self) -> bool {
+        self.is_async
+    }
+
+    pub(crate) fn inner_function(&self) -> &Arc<V8InternalFunction> {
+        &self.inner_function
+    }
+
+    /// Set the same function on the library additional isolates.
+    pub(crate) fn set_async_pool(&mut self, async_pool: Vec<Arc<V8InternalFunction>>) {
+        self.async_pool = async_pool;
+    }
+
+    /// Returns the function on which the next async invocation should run,
+    /// the isolates are picked in a round robin manner.
+    fn next_async_function(&self) -> &Arc<V8InternalFunction> {
+        if self.async_pool.is_empty() {
+            return &self.inner_function;
+        }
+        let index = self.next_isolate.fetch_add(1, Ordering::Relaxed) % (self.async_pool.len() + 1);
+        index
+            .checked_sub(1)
+            .map_or(&self.inner_function, |i| &self.async_pool[i])
+    }
 }
 
 impl FunctionCtxInterface for V8Function {
@@ -404,7 +442,7 @@ impl FunctionCtxInterface for V8Function {
                     return FunctionCallResult::Done;
                 }
             };
-            let inner_function = Arc::clone(&self.inner_function);
+            let inner_function = Arc::clone(self.next_async_function());
             // if we are going to the background we must consume all the arguments
             let args = run_ctx
                 .get_args_iter()
@@ -412,8 +450,10 @@ impl FunctionCtxInterface for V8Function {
                 .collect::<Vec<_>>();
             let bg_redis_client = run_ctx.get_redis_client().get_background_redis_client();
             let decode_arguments = self.decode_arguments;
-            self.inner_function
-                .script_ctx
+            // each isolate has its own background queue, so invocations
+            // on different isolates run in parallel.
+            let script_ctx = Arc::clone(&inner_function.script_ctx);
+            script_ctx
                 .compiled_library_api
                 .run_on_background(Box::new(move || {
                     inner_function.call_async(args, bg_client, bg_redis_client, decode_arguments);
@@ -9,16 +9,20 @@ use redisgears_plugin_api::redisgears_plugin_api::load_library_ctx::FunctionFlag
 use redisgears_plugin_api::redisgears_plugin_api::prologue::{self, ApiVersion};
 use redisgears_plugin_api::redisgears_plugin_api::run_function_ctx::PromiseReply;
 use redisgears_plugin_api::redisgears_plugin_api::{
+    keys_notifications_consumer_ctx::KeySpaceTriggerDebounceConfig,
+    keys_notifications_consumer_ctx::KeySpaceTriggerFilter,
     load_library_ctx::LoadLibraryCtxInterface, load_library_ctx::RegisteredKeys,
     run_function_ctx::BackgroundRunFunctionCtxInterface, run_function_ctx::RedisClientCtxInterface,
-    run_function_ctx::RemoteFunctionData, GearsApiError, RefCellWrapper,
+    run_function_ctx::RemoteFunctionData, stream_ctx::StreamAdaptiveWindowConfig,
+    stream_ctx::StreamBatchConfig, GearsApiError, RefCellWrapper,
 };
 
 use v8_rs::v8::v8_array::V8LocalArray;
 use v8_rs::v8::{
     isolate_scope::V8IsolateScope, v8_array_buffer::V8LocalArrayBuffer,
     v8_context_scope::V8ContextScope, v8_native_function_template::V8LocalNativeFunctionArgsIter,
-    v8_object::V8LocalObject, v8_utf8::V8LocalUtf8, v8_value::V8LocalValue, v8_version,
+    v8_object::V8LocalObject, v8_utf8::V8LocalUtf8, v8_value::V8LocalValue,
+    v8_value::V8PersistValue, v8_version,
 };
 
 use v8_derive::{new_native_function, NativeFunctionArgument};
@@ -28,16 +32,17 @@ use crate::v8_redisai::{get_redisai_api, get_redisai_client};
 use crate::v8_backend::log_warning;
 use crate::v8_function_ctx::V8Function;
 use crate::v8_notifications_ctx::V8NotificationsCtx;
-use crate::v8_script_ctx::{GilStatus, V8ScriptCtx};
+use crate::v8_script_ctx::{GilStatus, IsolateRole, V8ScriptCtx};
+use crate::v8_serializer;
 use crate::v8_stream_ctx::V8StreamCtx;
 use crate::{
     get_exception_msg, get_exception_v8_value, get_function_flags_from_strings,
     get_function_flags_globals,
 };
 
-use std::cell::RefCell;
+use std::cell::{OnceCell, RefCell};
 use std::ptr::NonNull;
-use std::sync::{Arc, Weak};
+use std::sync::{Arc, Mutex, Weak};
 
 const REGISTER_NOTIFICATIONS_CONSUMER: &str = "registerKeySpaceTrigger";
 const FUNCTION_FLAGS_GLOBAL_NAME: &str = "functionFlags";
@@ -52,18 +57,166 @@ const REDIS_GLOBAL_NAME: &str = "redis";
 const BLOCK_GLOBAL_NAME: &str = "block";
 const RUN_ON_KEY_GLOBAL_NAME: &str = "runOnKey";
 const RUN_ON_SHARDS_GLOBAL_NAME: &str = "runOnShards";
+const RUN_ON_KEYS_GLOBAL_NAME: &str = "runOnKeys";
+const RUN_ON_SHARDS_REDUCE_GLOBAL_NAME: &str = "runOnShardsReduce";
 const CALL_GLOBAL_NAME: &str = "call";
 const CALL_RAW_GLOBAL_NAME: &str = "callRaw";
 const CALL_ASYNC_GLOBAL_NAME: &str = "callAsync";
 const CALL_ASYNC_RAW_GLOBAL_NAME: &str = "callAsyncRaw";
+const CALL_BATCH_GLOBAL_NAME: &str = "callBatch";
+const CALL_BATCH_RAW_GLOBAL_NAME: &str = "callBatchRaw";
 const IS_BLOCK_ALLOW_GLOBAL_NAME: &str = "isBlockAllowed";
 const EXECUTE_ASYNC_GLOBAL_NAME: &str = "executeAsync";
+const SERIALIZATION_JSON: &str = "json";
+const SERIALIZATION_BINARY: &str = "binary";
+/// Default `targetLatency` (in ms) of stream triggers with an adaptive window.
+const DEFAULT_STREAM_TARGET_LATENCY: i64 = 1000;
+
+/// Property names used to tag special replies (verbatim strings, big numbers
+/// and status replies). The names are created lazily and at most once per
+/// converted reply, instead of once for every element of a large reply.
+#[derive(Default)]
+pub(crate) struct ReplyTypeKeys<'isolate_scope, 'isolate> {
+    reply_type: OnceCell<V8LocalValue<'isolate_scope, 'isolate>>,
+    format: OnceCell<V8LocalValue<'isolate_scope, 'isolate>>,
+}
+
+impl<'isolate_scope, 'isolate> ReplyTypeKeys<'isolate_scope, 'isolate> {
+    pub(crate) fn reply_type(
+        &self,
+        isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ) -> &V8LocalValue<'isolate_scope, 'isolate> {
+        self.reply_type
+            .get_or_init(|| isolate_scope.new_string("__reply_type").to_value())
+    }
+
+    pub(crate) fn format(
+        &self,
+        isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ) -> &V8LocalValue<'isolate_scope, 'isolate> {
+        self.format
+            .get_or_init(|| isolate_scope.new_string("__format").to_value())
+    }
+}
 
 pub(crate) fn call_result_to_js_object<'isolate_scope, 'isolate>(
     isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
     ctx_scope: &V8ContextScope,
     res: CallResult,
     decode_responses: bool,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    let keys = ReplyTypeKeys::default();
+    call_reply_to_js_object(isolate_scope, ctx_scope, res, decode_responses, &keys)
+}
+
+/// Converts a bulk string reply into a JS string, or into an `ArrayBuffer`
+/// if `decode_responses` is not set.
+pub(crate) fn bulk_string_to_js_object<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    data: &[u8],
+    decode_responses: bool,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    Ok(if decode_responses {
+        // decode the reply buffer in place, avoid copying it into an intermediate String.
+        let s = std::str::from_utf8(data).map_err(|_| "Could not decode value as string")?;
+        isolate_scope.new_string(s).to_value()
+    } else {
+        isolate_scope.new_array_buffer(data).to_value()
+    })
+}
+
+/// Converts a verbatim string reply into a string object (or an `ArrayBuffer`
+/// if `decode_responses` is not set) tagged with its reply type and format.
+pub(crate) fn verbatim_string_to_js_object<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope,
+    format: &str,
+    data: &[u8],
+    decode_responses: bool,
+    keys: &ReplyTypeKeys<'isolate_scope, 'isolate>,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    let val = if decode_responses {
+        isolate_scope
+            .new_string(std::str::from_utf8(data).map_err(|e| e.to_string())?)
+            .to_string_object()
+            .to_value()
+    } else {
+        isolate_scope.new_array_buffer(data).to_value()
+    };
+    let obj = val.as_object();
+    obj.set(
+        ctx_scope,
+        keys.reply_type(isolate_scope),
+        &isolate_scope.new_string("verbatim").to_value(),
+    );
+    obj.set(
+        ctx_scope,
+        keys.format(isolate_scope),
+        &isolate_scope.new_string(format).to_value(),
+    );
+    Ok(obj.to_value())
+}
+
+/// Creates a JS array from the converted elements of an array reply,
+/// stopping on the first element which failed converting.
+pub(crate) fn array_to_js_object<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    elements: impl Iterator<Item = Result<V8LocalValue<'isolate_scope, 'isolate>, String>>,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    // convert all the elements first and create the array at once.
+    let res = elements.collect::<Result<Vec<V8LocalValue>, String>>()?;
+    Ok(isolate_scope
+        .new_array(&res.iter().collect::<Vec<&V8LocalValue>>())
+        .to_value())
+}
+
+/// Creates a JS object from the converted entries of a map reply,
+/// stopping on the first entry which failed converting.
+pub(crate) fn map_to_js_object<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope,
+    mut entries: impl Iterator<
+        Item = Result<
+            (
+                V8LocalValue<'isolate_scope, 'isolate>,
+                V8LocalValue<'isolate_scope, 'isolate>,
+            ),
+            String,
+        >,
+    >,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    let obj = isolate_scope.new_object();
+    entries.try_for_each(|entry| {
+        let (key, val) = entry?;
+        obj.set(ctx_scope, &key, &val);
+        Ok::<_, String>(())
+    })?;
+    Ok(obj.to_value())
+}
+
+/// Converts a map reply key into a JS value, only string and integer keys
+/// are supported.
+fn map_key_to_js_object<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    key: CallReply,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    Ok(match key {
+        CallReply::String(k) => {
+            let key = std::str::from_utf8(k.as_bytes())
+                .map_err(|_| "Binary map key is not supported".to_string())?;
+            isolate_scope.new_string(key).to_value()
+        }
+        CallReply::I64(i) => isolate_scope.new_long(i.to_i64()),
+        _ => return Err("Given object can not be a object key".to_string()),
+    })
+}
+
+fn call_reply_to_js_object<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope,
+    res: CallResult,
+    decode_responses: bool,
+    keys: &ReplyTypeKeys<'isolate_scope, 'isolate>,
 ) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
     let res = res.map_err(|err| {
         err.to_utf8_string()
@@ -71,15 +224,14 @@ pub(crate) fn call_result_to_js_object<'isolate_scope, 'isolate>(
     })?;
     Ok(match res {
         CallReply::String(s) => {
-            if decode_responses {
-                let s = s
-                    .to_string()
-                    .ok_or("Could not decode value as string".to_string())?;
-                isolate_scope.new_string(&s).to_value()
-            } else {
-                isolate_scope.new_array_buffer(s.as_bytes()).to_value()
-            }
+            bulk_string_to_js_object(isolate_scope, s.as_bytes(), decode_responses)?
         }
+        CallReply::Array(a) => array_to_js_object(
+            isolate_scope,
+            a.iter().map(|v| {
+                call_reply_to_js_object(isolate_scope, ctx_scope, v, decode_responses, keys)
+            }),
+        )?,
         CallReply::I64(l) => isolate_scope.new_long(l.to_i64()),
         CallReply::Double(d) => isolate_scope.new_double(d.to_double()),
         CallReply::Bool(b) => isolate_scope.new_bool(b.to_bool()),
@@ -89,26 +241,14 @@ pub(crate) fn call_result_to_js_object<'isolate_scope, 'isolate>(
             let (format, data) = s
                 .as_parts()
                 .ok_or("Could not decode format as string".to_string())?;
-            let val = if decode_responses {
-                isolate_scope
-                    .new_string(std::str::from_utf8(data).map_err(|e| e.to_string())?)
-                    .to_string_object()
-                    .to_value()
-            } else {
-                isolate_scope.new_array_buffer(data).to_value()
-            };
-            let obj = val.as_object();
-            obj.set(
-                ctx_scope,
-                &isolate_scope.new_string("__reply_type").to_value(),
-                &isolate_scope.new_string("verbatim").to_value(),
-            );
-            obj.set(
+            verbatim_string_to_js_object(
+                isolate_scope,
                 ctx_scope,
-                &isolate_scope.new_string("__format").to_value(),
-                &isolate_scope.new_string(format).to_value(),
-            );
-            obj.to_value()
+                format,
+                data,
+                decode_responses,
+                keys,
+            )?
         }
         CallReply::BigNumber(b) => {
             let s = b
@@ -117,80 +257,35 @@ pub(crate) fn call_result_to_js_object<'isolate_scope, 'isolate>(
             let s = isolate_scope.new_string(&s).to_string_object();
             s.set(
                 ctx_scope,
-                &isolate_scope.new_string("__reply_type").to_value(),
+                keys.reply_type(isolate_scope),
                 &isolate_scope.new_string("big_number").to_value(),
             );
             s.to_value()
         }
-        CallReply::Array(a) => {
-            let res: Vec<V8LocalValue> = a.iter().fold(Ok::<_, String>(Vec::new()), |agg, v| {
-                let mut agg = agg?;
-                agg.push(call_result_to_js_object(
-                    isolate_scope,
-                    ctx_scope,
-                    v,
-                    decode_responses,
-                )?);
-                Ok(agg)
-            })?;
-            isolate_scope
-                .new_array(&res.iter().collect::<Vec<&V8LocalValue>>())
-                .to_value()
-        }
         CallReply::Set(s) => s
             .iter()
-            .fold(Ok::<_, String>(isolate_scope.new_set()), |agg, v| {
-                let agg = agg?;
+            .try_fold(isolate_scope.new_set(), |agg, v| {
                 agg.add(
                     ctx_scope,
-                    &call_result_to_js_object(isolate_scope, ctx_scope, v, decode_responses)?,
+                    &call_reply_to_js_object(isolate_scope, ctx_scope, v, decode_responses, keys)?,
                 );
-                Ok(agg)
+                Ok::<_, String>(agg)
             })?
             .to_value(),
-        CallReply::Map(m) => m
-            .iter()
-            .fold(Ok(isolate_scope.new_object()), |agg, (k, v)| {
+        CallReply::Map(m) => map_to_js_object(
+            isolate_scope,
+            ctx_scope,
+            m.iter().map(|(k, v)| {
                 let key = k.map_err(|e| {
                     e.to_utf8_string()
                         .unwrap_or("Failed converting error to utf8".to_string())
                 })?;
-                match key {
-                    CallReply::String(k) => {
-                        let key = k
-                            .to_string()
-                            .ok_or("Binary map key is not supported".to_string())?;
-                        let agg = agg?;
-                        agg.set(
-                            ctx_scope,
-                            &isolate_scope.new_string(&key).to_value(),
-                            &call_result_to_js_object(
-                                isolate_scope,
-                                ctx_scope,
-                                v,
-                                decode_responses,
-                            )?,
-                        );
-                        Ok(agg)
-                    }
-                    CallReply::I64(i) => {
-                        let agg = agg?;
-                        agg.set(
-                            ctx_scope,
-                            &isolate_scope.new_long(i.to_i64()),
-                            &call_result_to_js_object(
-                                isolate_scope,
-                                ctx_scope,
-                                v,
-                                decode_responses,
-                            )?,
-                        );
-                        Ok(agg)
-                    }
-                    _ => Err("Given object can not be a object key".to_string()),
-                }
-            })?
-            .to_value(),
+                Ok::<_, String>((
+                    map_key_to_js_object(isolate_scope, key)?,
+                    call_reply_to_js_object(isolate_scope, ctx_scope, v, decode_responses, keys)?,
+                ))
+            }),
+        )?,
     })
 }
 
@@ -233,27 +328,220 @@ impl RedisClient {
     }
 }
 
-fn js_value_to_remote_function_data(
-    ctx_scope: &V8ContextScope,
-    val: V8LocalValue,
-) -> Option<RemoteFunctionData> {
+/// Converts a value passed to or returned from a remote function into
+/// [`RemoteFunctionData`]. Values other than `ArrayBuffer` are encoded as
+/// JSON, or with [`v8_serializer`] if `binary` is set.
+pub(crate) fn js_value_to_remote_function_data<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    val: &V8LocalValue<'isolate_scope, 'isolate>,
+    binary: bool,
+) -> Result<RemoteFunctionData, String> {
     if val.is_array_buffer() {
         let array_buff = val.as_array_buffer();
         let data = array_buff.data();
-        Some(RemoteFunctionData::Binary(data.to_vec()))
+        Ok(RemoteFunctionData::Binary(data.to_vec()))
+    } else if binary {
+        v8_serializer::serialize(isolate_scope, ctx_scope, val).map(RemoteFunctionData::Serialized)
     } else {
-        let arg_str = ctx_scope.json_stringify(&val);
+        let arg_str = ctx_scope
+            .json_stringify(val)
+            .ok_or("Failed serializing value to JSON")?;
 
-        // if None return None
-        arg_str.as_ref()?;
-
-        let arg_str_utf8 = arg_str.unwrap().to_value().to_utf8().unwrap();
-        Some(RemoteFunctionData::String(
+        let arg_str_utf8 = arg_str.to_value().to_utf8().unwrap();
+        Ok(RemoteFunctionData::String(
             arg_str_utf8.as_str().to_string(),
         ))
     }
 }
 
+/// Converts the [`RemoteFunctionData`] back into a JS value.
+pub(crate) fn remote_function_data_to_js_value<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    data: &RemoteFunctionData,
+) -> Option<V8LocalValue<'isolate_scope, 'isolate>> {
+    match data {
+        RemoteFunctionData::Binary(b) => Some(isolate_scope.new_array_buffer(b).to_value()),
+        RemoteFunctionData::String(s) => {
+            let v8_str = isolate_scope.new_string(s);
+            ctx_scope.new_object_from_json(&v8_str)
+        }
+        RemoteFunctionData::Serialized(b) => {
+            match v8_serializer::deserialize(isolate_scope, ctx_scope, b) {
+                Ok(v) => Some(v),
+                Err(e) => {
+                    log_warning(&format!("Failed deserializing remote function data, {}", e));
+                    None
+                }
+            }
+        }
+    }
+}
+
+/// Returns [`true`] if the given remote function was registered with
+/// the binary serialization.
+fn is_binary_remote_function(script_ctx: &V8ScriptCtx, name: &str) -> bool {
+    script_ctx
+        .binary_remote_functions
+        .ref_cell
+        .borrow()
+        .contains(name)
+}
+
+#[derive(NativeFunctionArgument)]
+struct ShardsReduceArgs<'isolate_scope, 'isolate> {
+    reducer: Option<V8LocalValue<'isolate_scope, 'isolate>>,
+    initialValue: Option<V8LocalValue<'isolate_scope, 'isolate>>,
+    deadline: Option<i64>,
+}
+
+/// The state of an `async_client.runOnShardsReduce` invocation. The result
+/// of each shard is reduced into the accumulated value as soon as it
+/// arrives, by a job of the library jobs queue, which runs the jobs in order.
+struct ShardsReduceState {
+    reducer: V8PersistValue,
+    accumulator: Option<V8PersistValue>,
+    resolver: V8PersistValue,
+    errors: Vec<GearsApiError>,
+}
+
+/// The state is taken once the promise is settled.
+type SharedShardsReduceState = Arc<Mutex<Option<ShardsReduceState>>>;
+
+impl ShardsReduceState {
+    fn forget(mut self) {
+        self.reducer.forget();
+        self.resolver.forget();
+        if let Some(v) = self.accumulator.as_mut() {
+            v.forget();
+        }
+    }
+
+    /// Reduces the result of a shard into the accumulated value. Returns
+    /// [`false`] if the reducer raised an error, in which case the promise
+    /// was rejected with it.
+    fn reduce<'isolate_scope, 'isolate>(
+        &mut self,
+        script_ctx: &V8ScriptCtx,
+        isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+        ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+        result: Result<RemoteFunctionData, GearsApiError>,
+    ) -> bool {
+        let result = match result {
+            Ok(r) => r,
+            Err(e) => {
+                self.errors.push(e);
+                return true;
+            }
+        };
+        let v = match remote_function_data_to_js_value(isolate_scope, ctx_scope, &result) {
+            Some(v) => v,
+            None => {
+                self.errors.push(GearsApiError::new(
+                    "Failed deserializing remote function result".to_string(),
+                ));
+                return true;
+            }
+        };
+        let accumulator = match self.accumulator.as_ref() {
+            Some(accumulator) => accumulator.as_local(isolate_scope),
+            None => {
+                // like Array.prototype.reduce, the first result is the
+                // initial value if none was given.
+                self.accumulator = Some(v.persist());
+                return true;
+            }
+        };
+        let trycatch = isolate_scope.new_try_catch();
+        let reducer = self.reducer.as_local(isolate_scope);
+        match script_ctx.call(
+            &reducer,
+            ctx_scope,
+            Some(&[&accumulator, &v]),
+            GilStatus::Unlocked,
+        ) {
+            Some(r) => {
+                self.accumulator = Some(r.persist());
+                true
+            }
+            None => {
+                let error = get_exception_v8_value(&script_ctx.isolate, isolate_scope, trycatch);
+                let resolver = self.resolver.take_local(isolate_scope).as_resolver();
+                script_ctx.reject(&resolver, ctx_scope, &error);
+                false
+            }
+        }
+    }
+
+    /// Resolves the promise with the accumulated value and the errors.
+    fn resolve<'isolate_scope, 'isolate>(
+        mut self,
+        script_ctx: &V8ScriptCtx,
+        isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+        ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    ) {
+        let resolver = self.resolver.take_local(isolate_scope).as_resolver();
+        let accumulator = match self.accumulator.as_mut() {
+            Some(v) => v.take_local(isolate_scope),
+            None => isolate_scope.new_null(),
+        };
+        let errors: Vec<V8LocalValue> = self
+            .errors
+            .iter()
+            .map(|e| isolate_scope.new_string(e.get_msg()).to_value())
+            .collect();
+        let errors_array = isolate_scope
+            .new_array(&errors.iter().collect::<Vec<&V8LocalValue>>())
+            .to_value();
+        script_ctx.resolve(
+            &resolver,
+            ctx_scope,
+            &isolate_scope
+                .new_array(&[&accumulator, &errors_array])
+                .to_value(),
+        );
+    }
+}
+
+fn forget_shards_reduce_state(state: &SharedShardsReduceState) {
+    if let Some(s) = state.lock().unwrap().take() {
+        s.forget();
+    }
+    log_warning("Library was delete while not all the remote jobs were done");
+}
+
+/// Runs the given job on the state of a `runOnShardsReduce` invocation,
+/// from the library jobs queue. The state is forgotten if the library
+/// was deleted.
+fn run_shards_reduce_job(
+    script_ctx_weak_ref: &Weak<V8ScriptCtx>,
+    state: &SharedShardsReduceState,
+    job: impl FnOnce(&V8ScriptCtx, &mut Option<ShardsReduceState>) + Send + 'static,
+) {
+    let state = Arc::clone(state);
+    let script_ctx_weak_ref = Weak::clone(script_ctx_weak_ref);
+    let script_ctx = match script_ctx_weak_ref.upgrade() {
+        Some(s) => s,
+        None => {
+            forget_shards_reduce_state(&state);
+            return;
+        }
+    };
+    script_ctx
+        .compiled_library_api
+        .run_on_background(Box::new(move || {
+            let script_ctx = match script_ctx_weak_ref.upgrade() {
+                Some(s) => s,
+                None => {
+                    forget_shards_reduce_state(&state);
+                    return;
+                }
+            };
+            job(&script_ctx, &mut state.lock().unwrap());
+        }));
+}
+
 pub(crate) fn get_backgrounnd_client<'isolate_scope, 'isolate>(
     script_ctx: &Arc<V8ScriptCtx>,
     isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
@@ -314,15 +602,15 @@ pub(crate) fn get_backgrounnd_client<'isolate_scope, 'isolate>(
     let redis_background_client_ref = Arc::clone(&redis_background_client);
     let script_ctx_weak_ref = Arc::downgrade(script_ctx);
     bg_client.set_native_function(ctx_scope, RUN_ON_KEY_GLOBAL_NAME, new_native_function!(move |
-        _isolate,
+        isolate_scope,
         ctx_scope,
         key: V8RedisCallArgs,
         remote_function_name: V8LocalUtf8,
         args: Vec<V8LocalValue>,
     | {
-        let args_vec:Vec<RemoteFunctionData> = args.into_iter().map(|v| js_value_to_remote_function_data(ctx_scope, v).ok_or("Failed serializing arguments")).collect::<Result<_,_>>()?;
-
-        let _ = script_ctx_weak_ref.upgrade().ok_or("Function were unregistered")?;
+        let script_ctx = script_ctx_weak_ref.upgrade().ok_or("Function were unregistered")?;
+        let binary = is_binary_remote_function(&script_ctx, remote_function_name.as_str());
+        let args_vec:Vec<RemoteFunctionData> = args.into_iter().map(|v| js_value_to_remote_function_data(isolate_scope, ctx_scope, &v, binary).map_err(|e| format!("Failed serializing arguments, {e}"))).collect::<Result<_,_>>()?;
 
         let resolver = ctx_scope.new_resolver();
         let promise = resolver.get_promise();
@@ -354,16 +642,11 @@ pub(crate) fn get_backgrounnd_client<'isolate_scope, 'isolate>(
                 let resolver = resolver.take_local(&isolate_scope).as_resolver();
                 match result {
                     Ok(r) => {
-                        let v = match &r {
-                            RemoteFunctionData::Binary(b) => isolate_scope.new_array_buffer(b).to_value(),
-                            RemoteFunctionData::String(s) => {
-                                let v8_str = isolate_scope.new_string(s);
-                                let v8_obj = ctx_scope.new_object_from_json(&v8_str);
-                                if v8_obj.is_none() {
-                                    script_ctx.reject(&resolver, &ctx_scope, &isolate_scope.new_string("Failed deserializing remote function result").to_value());
-                                    return;
-                                }
-                                v8_obj.unwrap()
+                        let v = match remote_function_data_to_js_value(&isolate_scope, &ctx_scope, &r) {
+                            Some(v) => v,
+                            None => {
+                                script_ctx.reject(&resolver, &ctx_scope, &isolate_scope.new_string("Failed deserializing remote function result").to_value());
+                                return;
                             }
                         };
                         script_ctx.resolve(&resolver, &ctx_scope, &v);
@@ -374,25 +657,25 @@ pub(crate) fn get_backgrounnd_client<'isolate_scope, 'isolate>(
                 }
             }));
         }));
-        Ok::<_, &'static str>(Some(promise.to_value()))
+        Ok::<_, String>(Some(promise.to_value()))
     }));
 
     let redis_background_client_ref = Arc::clone(&redis_background_client);
     let script_ctx_weak_ref = Arc::downgrade(script_ctx);
     bg_client.set_native_function(ctx_scope, RUN_ON_SHARDS_GLOBAL_NAME, new_native_function!(move |
-        _isolate,
+        isolate_scope,
         ctx_scope,
         remote_function_name: V8LocalUtf8,
         args: Vec<V8LocalValue>,
     | {
-        let args_vec:Vec<RemoteFunctionData> = args.into_iter().map(|v| js_value_to_remote_function_data(ctx_scope, v).ok_or("Failed serializing arguments")).collect::<Result<_,_>>()?;
-
-        let _ = match script_ctx_weak_ref.upgrade() {
+        let script_ctx = match script_ctx_weak_ref.upgrade() {
             Some(s) => s,
             None => {
-                return Err("Function were unregistered");
+                return Err("Function were unregistered".to_string());
             }
         };
+        let binary = is_binary_remote_function(&script_ctx, remote_function_name.as_str());
+        let args_vec:Vec<RemoteFunctionData> = args.into_iter().map(|v| js_value_to_remote_function_data(isolate_scope, ctx_scope, &v, binary).map_err(|e| format!("Failed serializing arguments, {e}"))).collect::<Result<_,_>>()?;
 
         let resolver = ctx_scope.new_resolver();
         let promise = resolver.get_promise();
@@ -422,18 +705,12 @@ pub(crate) fn get_backgrounnd_client<'isolate_scope, 'isolate>(
                 let ctx_scope = script_ctx.context.enter(&isolate_scope);
 
                 let resolver = resolver.take_local(&isolate_scope).as_resolver();
-                let results: Vec<V8LocalValue> = results.into_iter().map(|v| {
-                    match v {
-                        RemoteFunctionData::Binary(b) => isolate_scope.new_array_buffer(&b).to_value(),
-                        RemoteFunctionData::String(s) => {
-                            let v8_str = isolate_scope.new_string(&s);
-                            let v8_obj = ctx_scope.new_object_from_json(&v8_str);
-                            if v8_obj.is_none() {
-                                errors.push(GearsApiError::new(format!("Failed deserializing remote function result '{}'", s)));
-                            }
-                            v8_obj.unwrap()
-                        }
+                let results: Vec<V8LocalValue> = results.into_iter().filter_map(|v| {
+                    let v8_val = remote_function_data_to_js_value(&isolate_scope, &ctx_scope, &v);
+                    if v8_val.is_none() {
+                        errors.push(GearsApiError::new("Failed deserializing remote function result".to_string()));
                     }
+                    v8_val
                 }).collect();
                 let errors: Vec<V8LocalValue> = errors.into_iter().map(|e| isolate_scope.new_string(e.get_msg()).to_value()).collect();
                 let results_array = isolate_scope.new_array(&results.iter().collect::<Vec<&V8LocalValue>>()).to_value();
@@ -445,16 +722,162 @@ pub(crate) fn get_backgrounnd_client<'isolate_scope, 'isolate>(
         Ok(Some(promise.to_value()))
     }));
 
+    let redis_background_client_ref = Arc::clone(&redis_background_client);
+    let script_ctx_weak_ref = Arc::downgrade(script_ctx);
+    bg_client.set_native_function(
+        ctx_scope,
+        RUN_ON_SHARDS_REDUCE_GLOBAL_NAME,
+        new_native_function!(move |isolate_scope,
+                                   ctx_scope,
+                                   remote_function_name: V8LocalUtf8,
+                                   reduce_args: ShardsReduceArgs,
+                                   args: Vec<V8LocalValue>| {
+            let script_ctx = script_ctx_weak_ref
+                .upgrade()
+                .ok_or("Function were unregistered")?;
+            let reducer = reduce_args.reducer.ok_or("'reducer' must be given")?;
+            if !reducer.is_function() || reducer.is_async_function() {
+                return Err("'reducer' must be a synchronous function".to_string());
+            }
+            let timeout_ms = match reduce_args.deadline {
+                Some(deadline) if deadline <= 0 => {
+                    return Err("'deadline' must be positive".to_string())
+                }
+                deadline => deadline.map(|v| v as usize),
+            };
+            let binary = is_binary_remote_function(&script_ctx, remote_function_name.as_str());
+            let args_vec: Vec<RemoteFunctionData> = args
+                .into_iter()
+                .map(|v| {
+                    js_value_to_remote_function_data(isolate_scope, ctx_scope, &v, binary)
+                        .map_err(|e| format!("Failed serializing arguments, {e}"))
+                })
+                .collect::<Result<_, _>>()?;
+
+            let resolver = ctx_scope.new_resolver();
+            let promise = resolver.get_promise();
+            let state: SharedShardsReduceState = Arc::new(Mutex::new(Some(ShardsReduceState {
+                reducer: reducer.persist(),
+                accumulator: reduce_args.initialValue.map(|v| v.persist()),
+                resolver: resolver.to_value().persist(),
+                errors: Vec::new(),
+            })));
+            let on_result_state = Arc::clone(&state);
+            let on_result_script_ctx_weak_ref = Weak::clone(&script_ctx_weak_ref);
+            let script_ctx_weak_ref = Weak::clone(&script_ctx_weak_ref);
+            redis_background_client_ref.run_on_each_shard(
+                remote_function_name.as_str(),
+                args_vec,
+                timeout_ms,
+                Box::new(move |result| {
+                    run_shards_reduce_job(
+                        &on_result_script_ctx_weak_ref,
+                        &on_result_state,
+                        move |script_ctx, state| {
+                            // the promise was already rejected if there is no state.
+                            if let Some(s) = state.as_mut() {
+                                let isolate_scope = script_ctx.isolate.enter();
+                                let ctx_scope = script_ctx.context.enter(&isolate_scope);
+                                if !s.reduce(script_ctx, &isolate_scope, &ctx_scope, result) {
+                                    *state = None;
+                                }
+                            }
+                        },
+                    );
+                }),
+                Box::new(move || {
+                    run_shards_reduce_job(&script_ctx_weak_ref, &state, |script_ctx, state| {
+                        if let Some(s) = state.take() {
+                            let isolate_scope = script_ctx.isolate.enter();
+                            let ctx_scope = script_ctx.context.enter(&isolate_scope);
+                            s.resolve(script_ctx, &isolate_scope, &ctx_scope);
+                        }
+                    });
+                }),
+            );
+            Ok::<_, String>(Some(promise.to_value()))
+        }),
+    );
+
+    let redis_background_client_ref = Arc::clone(&redis_background_client);
+    let script_ctx_weak_ref = Arc::downgrade(script_ctx);
+    bg_client.set_native_function(ctx_scope, RUN_ON_KEYS_GLOBAL_NAME, new_native_function!(move |
+        isolate_scope,
+        ctx_scope,
+        keys: V8LocalArray,
+        remote_function_name: V8LocalUtf8,
+        args: Vec<V8LocalValue>,
+    | {
+        let script_ctx = script_ctx_weak_ref.upgrade().ok_or("Function were unregistered")?;
+        let binary = is_binary_remote_function(&script_ctx, remote_function_name.as_str());
+        // each key is given to the remote function as its first argument.
+        let keys_vec = keys.iter(ctx_scope).map(|k| {
+            let key_data = js_value_to_remote_function_data(isolate_scope, ctx_scope, &k, binary).map_err(|e| format!("Failed serializing key, {e}"))?;
+            let key = V8RedisCallArgs::try_from(k).map_err(|e| e.to_string())?;
+            Ok((key.as_bytes().to_vec(), key_data))
+        }).collect::<Result<Vec<_>, String>>()?;
+        let args_vec:Vec<RemoteFunctionData> = args.into_iter().map(|v| js_value_to_remote_function_data(isolate_scope, ctx_scope, &v, binary).map_err(|e| format!("Failed serializing arguments, {e}"))).collect::<Result<_,_>>()?;
+
+        let resolver = ctx_scope.new_resolver();
+        let promise = resolver.get_promise();
+        let mut resolver = resolver.to_value().persist();
+        let script_ctx_weak_ref = Weak::clone(&script_ctx_weak_ref);
+        redis_background_client_ref.run_on_keys(keys_vec, remote_function_name.as_str(), args_vec, Box::new(move |results|{
+            let script_ctx = match script_ctx_weak_ref.upgrade() {
+                Some(s) => s,
+                None => {
+                    resolver.forget();
+                    log_warning("Library was delete while not all the remote jobs were done");
+                    return;
+                }
+            };
+
+            script_ctx.compiled_library_api.run_on_background(Box::new(move||{
+                let script_ctx = match script_ctx_weak_ref.upgrade() {
+                    Some(s) => s,
+                    None => {
+                        resolver.forget();
+                        log_warning("Library was delete while not all the remote jobs were done");
+                        return;
+                    }
+                };
+
+                let isolate_scope = script_ctx.isolate.enter();
+                let ctx_scope = script_ctx.context.enter(&isolate_scope);
+
+                let resolver = resolver.take_local(&isolate_scope).as_resolver();
+                // like Promise.all, reject with the first error.
+                let mut values = Vec::with_capacity(results.len());
+                for result in results {
+                    let error = match result {
+                        Ok(r) => match remote_function_data_to_js_value(&isolate_scope, &ctx_scope, &r) {
+                            Some(v) => {
+                                values.push(v);
+                                continue;
+                            }
+                            None => "Failed deserializing remote function result".to_string(),
+                        },
+                        Err(e) => e.get_msg().to_string(),
+                    };
+                    script_ctx.reject(&resolver, &ctx_scope, &isolate_scope.new_string(&error).to_value());
+                    return;
+                }
+                script_ctx.resolve(&resolver, &ctx_scope, &isolate_scope.new_array(&values.iter().collect::<Vec<&V8LocalValue>>()).to_value());
+            }));
+        }));
+        Ok::<_, String>(Some(promise.to_value()))
+    }));
+
     bg_client
 }
 
-enum V8RedisCallArgs<'isolate_scope, 'isolate> {
+pub(crate) enum V8RedisCallArgs<'isolate_scope, 'isolate> {
     Utf8(V8LocalUtf8<'isolate_scope, 'isolate>),
     ArrBuff(V8LocalArrayBuffer<'isolate_scope, 'isolate>),
 }
 
 impl<'isolate_scope, 'isolate> V8RedisCallArgs<'isolate_scope, 'isolate> {
-    fn as_bytes(&self) -> &[u8] {
+    pub(crate) fn as_bytes(&self) -> &[u8] {
         match self {
             V8RedisCallArgs::Utf8(val) => val.as_str().as_bytes(),
             V8RedisCallArgs::ArrBuff(val) => val.data(),
@@ -623,6 +1046,95 @@ fn add_call_function(
     );
 }
 
+/// Adds a function which gets an array of commands, each given as an
+/// array of the command name and arguments, runs them one after the other
+/// and returns an array with the result of each command. A failed command
+/// does not stop the following commands, its error is returned as a
+/// string object with `__reply_type` set to `error`.
+fn add_call_batch_function(
+    ctx_scope: &V8ContextScope,
+    redis_client: &Arc<RefCell<RedisClient>>,
+    client: &V8LocalObject,
+    function_name: &str,
+    decode_response: bool,
+) {
+    let redis_client_ref = Arc::clone(redis_client);
+    client.set_native_function(
+        ctx_scope,
+        function_name,
+        new_native_function!(move |isolate_scope, ctx_scope, commands: V8LocalArray| {
+            let is_already_blocked = ctx_scope.get_private_data::<bool, _>(0);
+            if is_already_blocked.is_none() || !*is_already_blocked.unwrap() {
+                return Err("Main thread is not locked".to_string());
+            }
+
+            let commands = commands
+                .iter(ctx_scope)
+                .map(|command| {
+                    if !command.is_array() {
+                        return Err("Each command must be given as an array".to_string());
+                    }
+                    command
+                        .as_array()
+                        .iter(ctx_scope)
+                        .map(|v| V8RedisCallArgs::try_from(v).map_err(|e| e.to_string()))
+                        .collect::<Result<Vec<_>, String>>()
+                })
+                .collect::<Result<Vec<_>, String>>()?;
+
+            let commands = commands
+                .iter()
+                .map(|command| {
+                    let (name, args) = command
+                        .split_first()
+                        .ok_or_else(|| "A command can not be empty".to_string())?;
+                    let name = std::str::from_utf8(name.as_bytes())
+                        .map_err(|_| "Command name must be a valid utf8 string".to_string())?;
+                    Ok((name, args.iter().map(|v| v.as_bytes()).collect()))
+                })
+                .collect::<Result<Vec<(&str, Vec<&[u8]>)>, String>>()?;
+
+            let borrow_client = redis_client_ref.borrow();
+            let c = borrow_client
+                .get()
+                .ok_or_else(|| "Used on invalid client".to_owned())?;
+
+            let keys = ReplyTypeKeys::default();
+            let res = c
+                .call_batch(&commands)
+                .into_iter()
+                .map(|res| match res {
+                    Err(err) => {
+                        let msg = err
+                            .to_utf8_string()
+                            .unwrap_or("Failed converting error to utf8".into());
+                        let err = isolate_scope.new_string(&msg).to_string_object();
+                        err.set(
+                            ctx_scope,
+                            keys.reply_type(isolate_scope),
+                            &isolate_scope.new_string("error").to_value(),
+                        );
+                        Ok(err.to_value())
+                    }
+                    res => call_reply_to_js_object(
+                        isolate_scope,
+                        ctx_scope,
+                        res,
+                        decode_response,
+                        &keys,
+                    ),
+                })
+                .collect::<Result<Vec<_>, String>>()?;
+
+            Ok(Some(
+                isolate_scope
+                    .new_array(&res.iter().collect::<Vec<&V8LocalValue>>())
+                    .to_value(),
+            ))
+        }),
+    );
+}
+
 pub(crate) fn get_redis_client<'isolate_scope, 'isolate>(
     script_ctx: &Arc<V8ScriptCtx>,
     isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
@@ -667,6 +1179,20 @@ pub(crate) fn get_redis_client<'isolate_scope, 'isolate>(
         false,
         BackgroundExecution::Allow,
     );
+    add_call_batch_function(
+        ctx_scope,
+        redis_client,
+        &client,
+        CALL_BATCH_GLOBAL_NAME,
+        true,
+    );
+    add_call_batch_function(
+        ctx_scope,
+        redis_client,
+        &client,
+        CALL_BATCH_RAW_GLOBAL_NAME,
+        false,
+    );
 
     let redis_client_ref = Arc::clone(redis_client);
     client.set_native_function(
@@ -764,6 +1290,70 @@ pub(crate) fn get_redis_client<'isolate_scope, 'isolate>(
     client
 }
 
+/// A JS client object which is created once on registration and reused by all
+/// the invocations of a trigger. The underlying [`RedisClient`] is only valid
+/// for the duration of an invocation, see [`PersistedRedisClient::set_client`].
+pub(crate) struct PersistedRedisClient {
+    persisted_client: V8PersistValue,
+    client: Arc<RefCell<RedisClient>>,
+}
+
+// The client is only used by invocations that hold the Redis GIL.
+unsafe impl Sync for PersistedRedisClient {}
+unsafe impl Send for PersistedRedisClient {}
+
+/// Restores the previous [`RedisClient`] of a [`PersistedRedisClient`] when dropped.
+pub(crate) struct RedisClientGuard<'a> {
+    client: &'a Arc<RefCell<RedisClient>>,
+    prev_client: Option<RedisClient>,
+}
+
+impl<'a> Drop for RedisClientGuard<'a> {
+    fn drop(&mut self) {
+        // invalidate the client or, on nested invocations, restore the outer invocation client.
+        *self.client.borrow_mut() = self.prev_client.take().unwrap();
+    }
+}
+
+impl PersistedRedisClient {
+    pub(crate) fn new(
+        script_ctx: &Arc<V8ScriptCtx>,
+        isolate_scope: &V8IsolateScope,
+        ctx_scope: &V8ContextScope,
+    ) -> Self {
+        let client = Arc::new(RefCell::new(RedisClient::new()));
+        client.borrow_mut().make_invalid();
+        let mut persisted_client = get_redis_client(script_ctx, isolate_scope, ctx_scope, &client)
+            .to_value()
+            .persist();
+        persisted_client.forget();
+        Self {
+            persisted_client,
+            client,
+        }
+    }
+
+    /// Set the client to use and return the JS client object. The client is
+    /// valid until the returned guard is dropped.
+    pub(crate) fn set_client<'a, 'isolate_scope, 'isolate>(
+        &'a self,
+        isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+        client: &'a dyn RedisClientCtxInterface,
+    ) -> (V8LocalValue<'isolate_scope, 'isolate>, RedisClientGuard<'a>) {
+        let prev_client = std::mem::replace(
+            &mut *self.client.borrow_mut(),
+            RedisClient::with_client(client),
+        );
+        (
+            self.persisted_client.as_local(isolate_scope),
+            RedisClientGuard {
+                client: &self.client,
+                prev_client: Some(prev_client),
+            },
+        )
+    }
+}
+
 /// A type defining an API version implementation.
 pub(crate) type ApiVersionImplementation = fn(
     api_version: ApiVersionSupported,
@@ -1034,6 +1624,11 @@ pub(crate) fn initialize_globals_1_1(
     Ok(())
 }
 
+#[derive(NativeFunctionArgument)]
+struct ClusterFunctionOptionalArgs {
+    serialization: Option<String>,
+}
+
 #[derive(NativeFunctionArgument)]
 struct NativeFunctionOptionalArgs<'isolate_scope, 'isolate> {
     description: Option<String>,
@@ -1104,7 +1699,7 @@ fn add_register_function_api(
                 let redis_client =
                     get_redis_client(&script_ctx_ref, isolate_scope, curr_ctx_scope, &c);
 
-                let f = V8Function::new(
+                let mut f = V8Function::new(
                     &script_ctx_ref,
                     persisted_function,
                     redis_client.to_value().persist(),
@@ -1113,6 +1708,35 @@ fn add_register_function_api(
                     !function_flags.contains(FunctionFlags::RAW_ARGUMENTS),
                 );
 
+                if is_async && f.is_async() {
+                    match &script_ctx_ref.role {
+                        IsolateRole::AsyncPoolMember => {
+                            // Only keep the function so the main isolate will be able
+                            // to dispatch invocations to it.
+                            script_ctx_ref
+                                .pooled_async_functions
+                                .ref_cell
+                                .borrow_mut()
+                                .insert(
+                                    function_name_utf8.as_str().to_owned(),
+                                    Arc::clone(f.inner_function()),
+                                );
+                            return Ok(None);
+                        }
+                        IsolateRole::Main(async_pool) => f.set_async_pool(
+                            async_pool
+                                .iter()
+                                .filter_map(|v| {
+                                    v.pooled_async_functions
+                                        .ref_cell
+                                        .borrow_mut()
+                                        .remove(function_name_utf8.as_str())
+                                })
+                                .collect(),
+                        ),
+                    }
+                }
+
                 let res = if is_async {
                     load_ctx.register_async_function(
                         function_name_utf8.as_str(),
@@ -1143,6 +1767,11 @@ struct StreamTriggerOptionalArgs {
     description: Option<String>,
     window: Option<i64>,
     isStreamTrimmed: Option<bool>,
+    batchSize: Option<i64>,
+    maxBatchDelay: Option<i64>,
+    lazyRecords: Option<bool>,
+    maxWindow: Option<i64>,
+    targetLatency: Option<i64>,
 }
 
 fn add_stream_trigger_api(
@@ -1152,7 +1781,7 @@ fn add_stream_trigger_api(
 ) {
     let script_ctx_ref = Arc::downgrade(script_ctx);
     redis.set_native_function(ctx_scope, REGISTER_STREAM_TRIGGER_GLOBAL_NAME, new_native_function!(move|
-        _isolate_scope,
+        isolate_scope,
         curr_ctx_scope,
         registration_name_utf8: V8LocalUtf8,
         prefix: V8LocalValue,
@@ -1173,9 +1802,35 @@ fn add_stream_trigger_api(
             return Err("window argument must be a positive number".into());
         }
         let trim = optional_args.as_ref().map_or(false, |v| v.isStreamTrimmed.as_ref().map_or(false, |v| *v));
+        let batch_size = optional_args.as_ref().and_then(|v| v.batchSize);
+        let max_batch_delay = optional_args.as_ref().and_then(|v| v.maxBatchDelay);
+        let batch = match (batch_size, max_batch_delay) {
+            (None, None) => None,
+            (None, Some(_)) => return Err("maxBatchDelay argument can only be used together with batchSize".into()),
+            (Some(batch_size), _) if batch_size < 1 => return Err("batchSize argument must be a positive number".into()),
+            (Some(_), Some(max_batch_delay)) if max_batch_delay < 0 => return Err("maxBatchDelay argument must be a non negative number".into()),
+            (Some(batch_size), max_batch_delay) => Some(StreamBatchConfig {
+                batch_size: batch_size as usize,
+                max_batch_delay: max_batch_delay.unwrap_or(0) as usize,
+            }),
+        };
+        let max_window = optional_args.as_ref().and_then(|v| v.maxWindow);
+        let target_latency = optional_args.as_ref().and_then(|v| v.targetLatency);
+        let adaptive_window = match (max_window, target_latency) {
+            (None, None) => None,
+            (None, Some(_)) => return Err("targetLatency argument can only be used together with maxWindow".into()),
+            (Some(max_window), _) if max_window < window => return Err("maxWindow argument must be greater or equal to window".into()),
+            (Some(_), Some(target_latency)) if target_latency < 1 => return Err("targetLatency argument must be a positive number".into()),
+            (Some(max_window), target_latency) => Some(StreamAdaptiveWindowConfig {
+                max_window: max_window as usize,
+                target_latency: target_latency.unwrap_or(DEFAULT_STREAM_TARGET_LATENCY) as usize,
+            }),
+        };
+        let lazy_records = optional_args.as_ref().map_or(false, |v| v.lazyRecords.unwrap_or(false));
         let description = optional_args.and_then(|v| v.description);
 
-        let v8_stream_ctx = V8StreamCtx::new(persisted_function, &script_ctx_ref, function_callback.is_async_function());
+        let persisted_client = PersistedRedisClient::new(&script_ctx_ref, isolate_scope, curr_ctx_scope);
+        let v8_stream_ctx = V8StreamCtx::new(isolate_scope, persisted_function, persisted_client, &script_ctx_ref, function_callback.is_async_function(), batch, adaptive_window, lazy_records);
         let res = if prefix.is_string() {
             let prefix = prefix.to_utf8().unwrap();
             load_ctx.register_stream_consumer(registration_name_utf8.as_str(), prefix.as_str().as_bytes(), Box::new(v8_stream_ctx), window as usize, trim, description)
@@ -1197,6 +1852,12 @@ fn add_stream_trigger_api(
 struct NoficationConsumerOptionalArgs<'isolate_scope, 'isolate> {
     onTriggerFired: Option<V8LocalValue<'isolate_scope, 'isolate>>,
     description: Option<String>,
+    events: Option<V8LocalArray<'isolate_scope, 'isolate>>,
+    keySuffix: Option<String>,
+    minKeyLength: Option<i64>,
+    maxKeyLength: Option<i64>,
+    debounceWindow: Option<i64>,
+    debounceMaxEvents: Option<i64>,
 }
 
 fn add_register_notification_consumer_api(
@@ -1206,7 +1867,7 @@ fn add_register_notification_consumer_api(
 ) {
     let script_ctx_ref = Arc::downgrade(script_ctx);
     redis.set_native_function(ctx_scope, REGISTER_NOTIFICATIONS_CONSUMER, new_native_function!(move|
-        _isolate_scope,
+        isolate_scope,
         curr_ctx_scope,
         registration_name_utf8: V8LocalUtf8,
         prefix: V8LocalValue,
@@ -1227,13 +1888,57 @@ fn add_register_notification_consumer_api(
             })
         })?;
 
+        let events = optional_args.as_ref().and_then(|v| v.events.as_ref()).map(|events| {
+            if events.len() == 0 {
+                return Err("events argument must not be empty".to_owned());
+            }
+            (0..events.len()).map(|i| {
+                let event = events.get(curr_ctx_scope, i);
+                if !event.is_string() {
+                    return Err("events argument must be an array of strings".to_owned());
+                }
+                Ok(event.to_utf8().unwrap().as_str().to_owned())
+            }).collect::<Result<Vec<_>, _>>()
+        }).transpose()?;
+        let key_suffix = optional_args.as_ref().and_then(|v| v.keySuffix.as_ref()).map(|v| v.as_bytes().to_vec());
+        let min_key_length = optional_args.as_ref().and_then(|v| v.minKeyLength);
+        let max_key_length = optional_args.as_ref().and_then(|v| v.maxKeyLength);
+        if min_key_length.map_or(false, |v| v < 0) {
+            return Err("minKeyLength argument must be a non negative number".into());
+        }
+        if max_key_length.map_or(false, |v| v < min_key_length.unwrap_or(0)) {
+            return Err("maxKeyLength argument must be greater or equal to minKeyLength".into());
+        }
+        let filter = KeySpaceTriggerFilter {
+            events,
+            key_suffix,
+            min_key_length: min_key_length.map(|v| v as usize),
+            max_key_length: max_key_length.map(|v| v as usize),
+        };
+        let filter = (filter != KeySpaceTriggerFilter::default()).then_some(filter);
+
+        let debounce_window = optional_args.as_ref().and_then(|v| v.debounceWindow);
+        let debounce_max_events = optional_args.as_ref().and_then(|v| v.debounceMaxEvents);
+        let debounce_config = match (debounce_window, debounce_max_events) {
+            (None, None) => None,
+            (None, Some(_)) => return Err("debounceMaxEvents argument can only be used together with debounceWindow".into()),
+            (Some(debounce_window), _) if debounce_window < 1 => return Err("debounceWindow argument must be a positive number".into()),
+            (Some(_), Some(debounce_max_events)) if debounce_max_events < 1 => return Err("debounceMaxEvents argument must be a positive number".into()),
+            (Some(_), _) if on_trigger_fired.is_some() => return Err("onTriggerFired argument can not be used together with debounceWindow".into()),
+            (Some(debounce_window), debounce_max_events) => Some(KeySpaceTriggerDebounceConfig {
+                window: debounce_window as usize,
+                max_events: debounce_max_events.map(|v| v as usize),
+            }),
+        };
+
         let description = optional_args.and_then(|v| v.description);
 
         let load_ctx = curr_ctx_scope.get_private_data_mut::<&mut dyn LoadLibraryCtxInterface, _>(0).ok_or_else(|| format!("Called '{REGISTER_NOTIFICATIONS_CONSUMER}' out of context"))?;
 
         let script_ctx_ref = script_ctx_ref.upgrade().ok_or_else(|| "Use of uninitialized script context".to_owned())?;
 
-        let v8_notification_ctx = V8NotificationsCtx::new(persisted_function, on_trigger_fired, &script_ctx_ref, function_callback.is_async_function());
+        let persisted_client = PersistedRedisClient::new(&script_ctx_ref, isolate_scope, curr_ctx_scope);
+        let v8_notification_ctx = V8NotificationsCtx::new(persisted_function, on_trigger_fired, persisted_client, &script_ctx_ref, function_callback.is_async_function(), filter, debounce_config);
 
         let res = if prefix.is_string() {
             let prefix = prefix.to_utf8().unwrap();
@@ -1300,6 +2005,7 @@ pub(crate) fn initialize_globals_1_0(
         curr_ctx_scope,
         function_name_utf8: V8LocalUtf8,
         function_callback: V8LocalValue,
+        optional_args: Option<ClusterFunctionOptionalArgs>,
     | {
         if !function_callback.is_function() {
             return Err(format!("Second argument to '{REGISTER_CLUSTER_FUNCTION_GLOBAL_NAME}' must be a function"));
@@ -1309,6 +2015,12 @@ pub(crate) fn initialize_globals_1_0(
             return Err("Remote function must be async".into());
         }
 
+        let binary = match optional_args.as_ref().and_then(|v| v.serialization.as_deref()) {
+            None | Some(SERIALIZATION_JSON) => false,
+            Some(SERIALIZATION_BINARY) => true,
+            Some(v) => return Err(format!("Unknown serialization '{v}', expected '{SERIALIZATION_JSON}' or '{SERIALIZATION_BINARY}'")),
+        };
+
         let load_ctx = curr_ctx_scope.get_private_data_mut::<&mut dyn LoadLibraryCtxInterface, _>(0);
         if load_ctx.is_none() {
             return Err(format!("Called '{REGISTER_CLUSTER_FUNCTION_GLOBAL_NAME}' out of context"));
@@ -1318,6 +2030,11 @@ pub(crate) fn initialize_globals_1_0(
         persisted_function.forget();
         let persisted_function = Arc::new(persisted_function);
 
+        if binary {
+            let script_ctx = script_ctx_ref.upgrade().ok_or("Use of uninitialized script context")?;
+            script_ctx.binary_remote_functions.ref_cell.borrow_mut().insert(function_name_utf8.as_str().to_string());
+        }
+
         let load_ctx = load_ctx.unwrap();
         let new_script_ctx_ref = Weak::clone(&script_ctx_ref);
         let res = load_ctx.register_remote_task(function_name_utf8.as_str(), Box::new(move |inputs, background_ctx, on_done|{
@@ -1353,18 +2070,13 @@ pub(crate) fn initialize_globals_1_0(
                 let mut args = Vec::new();
                 args.push(get_backgrounnd_client(&script_ctx, &isolate_scope, &ctx_scope, Arc::new(background_ctx)).to_value());
                 for input in inputs {
-                    args.push(match input {
-                        RemoteFunctionData::Binary(b) => isolate_scope.new_array_buffer(&b).to_value(),
-                        RemoteFunctionData::String(s) => {
-                            let v8_str = isolate_scope.new_string(&s);
-                            let v8_obj = ctx_scope.new_object_from_json(&v8_str);
-                            if v8_obj.is_none() {
-                                on_done(Err(GearsApiError::new("Failed deserializing remote function argument".to_string())));
-                                return;
-                            }
-                            v8_obj.unwrap()
+                    match remote_function_data_to_js_value(&isolate_scope, &ctx_scope, &input) {
+                        Some(v) => args.push(v),
+                        None => {
+                            on_done(Err(GearsApiError::new("Failed deserializing remote function argument".to_string())));
+                            return;
                         }
-                    });
+                    }
                 }
                 let args_refs = args.iter().collect::<Vec<&V8LocalValue>>();
 
@@ -1377,23 +2089,22 @@ pub(crate) fn initialize_globals_1_0(
                                 match res {
                                     Ok(v) => {
                                         let trycatch = v.isolate_scope.new_try_catch();
-                                        let r = js_value_to_remote_function_data(v.ctx_scope, v.res);
-                                        if let Some(v) = r {
-                                            on_done(Ok(v));
-                                        } else {
-                                            let error_utf8 = trycatch.get_exception().to_utf8().unwrap();
-                                            on_done(Err(GearsApiError::new(format!("Failed serializing result, {}.", error_utf8.as_str()))));
+                                        match js_value_to_remote_function_data(v.isolate_scope, v.ctx_scope, &v.res, binary) {
+                                            Ok(v) => on_done(Ok(v)),
+                                            Err(e) if binary => on_done(Err(GearsApiError::new(format!("Failed serializing result, {}.", e)))),
+                                            Err(_) => {
+                                                let error_utf8 = trycatch.get_exception().to_utf8().unwrap();
+                                                on_done(Err(GearsApiError::new(format!("Failed serializing result, {}.", error_utf8.as_str()))));
+                                            }
                                         }
                                     }
                                     Err(e) => on_done(Err(e)),
                                 }
                             });
                         } else {
-                            let r = js_value_to_remote_function_data(&ctx_scope, r);
-                            if let Some(v) = r {
-                                on_done(Ok(v));
-                            } else {
-                                on_done(Err(GearsApiError::new("Failed serializing result".to_string())));
+                            match js_value_to_remote_function_data(&isolate_scope, &ctx_scope, &r, binary) {
+                                Ok(v) => on_done(Ok(v)),
+                                Err(e) => on_done(Err(GearsApiError::new(format!("Failed serializing result, {}.", e)))),
                             }
                         }
                     }
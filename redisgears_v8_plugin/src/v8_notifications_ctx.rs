@@ -4,6 +4,9 @@
  * the Server Side Public License v1 (SSPLv1).
  */
 
+use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::JobPriority;
+use redisgears_plugin_api::redisgears_plugin_api::keys_notifications_consumer_ctx::KeySpaceTriggerDebounceConfig;
+use redisgears_plugin_api::redisgears_plugin_api::keys_notifications_consumer_ctx::KeySpaceTriggerFilter;
 use redisgears_plugin_api::redisgears_plugin_api::keys_notifications_consumer_ctx::NotificationCtxInterface;
 use redisgears_plugin_api::redisgears_plugin_api::GearsApiError;
 use redisgears_plugin_api::redisgears_plugin_api::{
@@ -14,16 +17,16 @@ use redisgears_plugin_api::redisgears_plugin_api::{
 
 use v8_rs::v8::v8_value::V8PersistValue;
 
-use crate::v8_native_functions::{get_backgrounnd_client, get_redis_client, RedisClient};
+use crate::v8_native_functions::{get_backgrounnd_client, PersistedRedisClient};
 use crate::v8_script_ctx::{GilStatus, V8ScriptCtx};
 use crate::{get_exception_msg, v8_backend::bypass_memory_limit};
 
-use std::cell::RefCell;
 use std::sync::Arc;
 
 struct V8NotificationsCtxInternal {
     persisted_function: V8PersistValue,
     on_trigger_fired: Option<V8PersistValue>,
+    persisted_client: PersistedRedisClient,
     script_ctx: Arc<V8ScriptCtx>,
 }
 
@@ -42,20 +45,19 @@ impl V8NotificationsCtxInternal {
             let notification_data = data.take_local(&isolate_scope);
 
             let c = notification_ctx.get_redis_client();
-            let redis_client = Arc::new(RefCell::new(RedisClient::with_client(c.as_ref())));
-            let r_client =
-                get_redis_client(&self.script_ctx, &isolate_scope, &ctx_scope, &redis_client);
+            let res = {
+                let (r_client, _client_guard) =
+                    self.persisted_client.set_client(&isolate_scope, c.as_ref());
 
-            let _block_guard = ctx_scope.set_private_data(0, &true); // indicate we are blocked
-
-            let res = self.script_ctx.call(
-                &self.persisted_function.as_local(&isolate_scope),
-                &ctx_scope,
-                Some(&[&r_client.to_value(), &notification_data]),
-                GilStatus::Locked,
-            );
+                let _block_guard = ctx_scope.set_private_data(0, &true); // indicate we are blocked
 
-            redis_client.borrow_mut().make_invalid();
+                self.script_ctx.call(
+                    &self.persisted_function.as_local(&isolate_scope),
+                    &ctx_scope,
+                    Some(&[&r_client, &notification_data]),
+                    GilStatus::Locked,
+                )
+            };
 
             match res {
                 Some(res) => {
@@ -167,14 +169,19 @@ impl V8NotificationsCtxInternal {
 pub(crate) struct V8NotificationsCtx {
     internal: Arc<V8NotificationsCtxInternal>,
     is_async: bool,
+    filter: Option<KeySpaceTriggerFilter>,
+    debounce_config: Option<KeySpaceTriggerDebounceConfig>,
 }
 
 impl V8NotificationsCtx {
     pub(crate) fn new(
         mut persisted_function: V8PersistValue,
         on_trigger_fired: Option<V8PersistValue>,
+        persisted_client: PersistedRedisClient,
         script_ctx: &Arc<V8ScriptCtx>,
         is_async: bool,
+        filter: Option<KeySpaceTriggerFilter>,
+        debounce_config: Option<KeySpaceTriggerDebounceConfig>,
     ) -> Self {
         persisted_function.forget();
         let on_trigger_fired = on_trigger_fired.map(|mut v| {
@@ -185,9 +192,12 @@ impl V8NotificationsCtx {
             internal: Arc::new(V8NotificationsCtxInternal {
                 persisted_function,
                 on_trigger_fired,
+                persisted_client,
                 script_ctx: Arc::clone(script_ctx),
             }),
             is_async,
+            filter,
+            debounce_config,
         }
     }
 }
@@ -239,24 +249,21 @@ impl KeysNotificationsConsumerCtxInterface for V8NotificationsCtx {
                 let on_trigger_fired = v.as_local(&isolate_scope);
 
                 let c = notification_ctx.get_redis_client();
-                let redis_client = Arc::new(RefCell::new(RedisClient::with_client(c.as_ref())));
-                let r_client = get_redis_client(
-                    &self.internal.script_ctx,
-                    &isolate_scope,
-                    &ctx_scope,
-                    &redis_client,
-                );
-
-                let _block_guard = ctx_scope.set_private_data(0, &true); // indicate we are blocked
-
-                let res = self.internal.script_ctx.call(
-                    &on_trigger_fired,
-                    &ctx_scope,
-                    Some(&[&r_client.to_value(), &val]),
-                    GilStatus::Locked,
-                );
-
-                redis_client.borrow_mut().make_invalid();
+                let res = {
+                    let (r_client, _client_guard) = self
+                        .internal
+                        .persisted_client
+                        .set_client(&isolate_scope, c.as_ref());
+
+                    let _block_guard = ctx_scope.set_private_data(0, &true); // indicate we are blocked
+
+                    self.internal.script_ctx.call(
+                        &on_trigger_fired,
+                        &ctx_scope,
+                        Some(&[&r_client, &val]),
+                        GilStatus::Locked,
+                    )
+                };
 
                 res.map_or_else(
                     || {
@@ -287,12 +294,28 @@ impl KeysNotificationsConsumerCtxInterface for V8NotificationsCtx {
                 internal
                     .script_ctx
                     .compiled_library_api
-                    .run_on_background(Box::new(move || {
-                        new_internal.run_async(redis_background_client, locker, data, ack_callback);
-                    }));
+                    .run_on_background_with_priority(
+                        Box::new(move || {
+                            new_internal.run_async(
+                                redis_background_client,
+                                locker,
+                                data,
+                                ack_callback,
+                            );
+                        }),
+                        JobPriority::Low,
+                    );
             } else {
                 internal.run_sync(notification_run_ctx, data, ack_callback);
             }
         }));
     }
+
+    fn filter(&self) -> Option<KeySpaceTriggerFilter> {
+        self.filter.clone()
+    }
+
+    fn debounce_config(&self) -> Option<KeySpaceTriggerDebounceConfig> {
+        self.debounce_config.clone()
+    }
 }
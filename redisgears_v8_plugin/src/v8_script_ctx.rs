@@ -7,8 +7,11 @@
 use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::DebuggerBackendPayload;
 use redisgears_plugin_api::redisgears_plugin_api::load_library_ctx::{InfoSectionData, ModuleInfo};
 use redisgears_plugin_api::redisgears_plugin_api::{
-    backend_ctx::CompiledLibraryInterface, load_library_ctx::LibraryCtxInterface,
-    load_library_ctx::LoadLibraryCtxInterface, GearsApiError,
+    backend_ctx::CompiledLibraryInterface, function_ctx::FunctionCtxInterface,
+    keys_notifications_consumer_ctx::KeysNotificationsConsumerCtxInterface,
+    load_library_ctx::FunctionFlags, load_library_ctx::LibraryCtxInterface,
+    load_library_ctx::LoadLibraryCtxInterface, load_library_ctx::RegisteredKeys,
+    load_library_ctx::RemoteFunctionCtx, stream_ctx::StreamCtxInterface, GearsApiError,
 };
 
 use v8_derive::new_native_function;
@@ -26,12 +29,13 @@ use v8_rs::v8::{
 
 use redisgears_plugin_api::redisgears_plugin_api::{GearsApiResult, RefCellWrapper};
 use std::cell::RefCell;
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::sync::atomic::AtomicBool;
 use std::sync::atomic::Ordering;
 use std::sync::Arc;
 use std::time::SystemTime;
 
+use crate::v8_function_ctx::V8InternalFunction;
 use crate::{get_error_from_object, get_exception_msg};
 
 #[derive(Debug)]
@@ -121,6 +125,18 @@ impl<'a> Drop for RdbLoadingGuard<'a> {
     }
 }
 
+/// The role of an isolate within the isolates of a library.
+pub(crate) enum IsolateRole {
+    /// The main isolate of the library, on which all the registrations
+    /// are performed. Holds the additional isolates, created from the
+    /// same code, which are used to run the library async functions
+    /// in parallel.
+    Main(Vec<Arc<V8ScriptCtx>>),
+    /// An additional isolate which is only used to run async functions.
+    /// Anything else the library registers on it is ignored.
+    AsyncPoolMember,
+}
+
 pub(crate) struct V8ScriptCtx {
     /// The name of the library.
     pub(crate) name: String,
@@ -155,6 +171,18 @@ pub(crate) struct V8ScriptCtx {
     /// Signifies the present locking status of the running JavaScript code,
     /// enabling us to distinguish between background JS code execution and JS code that holds a lock on Redis.
     pub(crate) lock_state: RefCellWrapper<GilStateCtx>,
+
+    /// The role of the isolate within the library isolates.
+    pub(crate) role: IsolateRole,
+
+    /// The async functions registered on an [`IsolateRole::AsyncPoolMember`]
+    /// isolate while evaluating the library, taken by the main isolate when
+    /// registering the same function.
+    pub(crate) pooled_async_functions: RefCellWrapper<HashMap<String, Arc<V8InternalFunction>>>,
+
+    /// The remote functions registered with the binary serialization,
+    /// their inputs and outputs are encoded with [`crate::v8_serializer`].
+    pub(crate) binary_remote_functions: RefCellWrapper<HashSet<String>>,
 }
 
 impl std::fmt::Debug for V8ScriptCtx {
@@ -172,6 +200,7 @@ impl std::fmt::Debug for V8ScriptCtx {
             )
             .field("is_running", &self.is_running)
             .field("lock_state", &self.lock_state)
+            .field("async_pool_size", &self.async_pool().len())
             .finish()
     }
 }
@@ -183,6 +212,7 @@ pub(crate) struct OnDoneCtx<'isolate_scope, 'isolate, 'ctx_scope> {
 }
 
 impl V8ScriptCtx {
+    #[allow(clippy::too_many_arguments)]
     pub(crate) fn new(
         name: String,
         isolate: V8Isolate,
@@ -191,6 +221,7 @@ impl V8ScriptCtx {
         inspector: Option<Arc<Inspector>>,
         tensor_object_template: V8PersistedObjectTemplate,
         compiled_library_api: Box<dyn CompiledLibraryInterface + Send + Sync>,
+        role: IsolateRole,
     ) -> Self {
         Self {
             name,
@@ -205,6 +236,21 @@ impl V8ScriptCtx {
             lock_state: RefCellWrapper {
                 ref_cell: RefCell::new(GilStateCtx::new()),
             },
+            role,
+            pooled_async_functions: RefCellWrapper {
+                ref_cell: RefCell::new(HashMap::new()),
+            },
+            binary_remote_functions: RefCellWrapper {
+                ref_cell: RefCell::new(HashSet::new()),
+            },
+        }
+    }
+
+    /// Returns the additional isolates used to run the library async functions.
+    pub(crate) fn async_pool(&self) -> &[Arc<V8ScriptCtx>] {
+        match &self.role {
+            IsolateRole::Main(async_pool) => async_pool,
+            IsolateRole::AsyncPoolMember => &[],
         }
     }
 
@@ -489,17 +535,76 @@ pub(crate) struct V8LibraryCtx {
     pub(crate) script_ctx: Arc<V8ScriptCtx>,
 }
 
-impl LibraryCtxInterface for V8LibraryCtx {
-    fn load_library(
+/// A library loader for the [`IsolateRole::AsyncPoolMember`] isolates, the
+/// async functions are kept on [`V8ScriptCtx::pooled_async_functions`] and
+/// all the registrations are ignored.
+struct AsyncPoolLoadLibraryCtx;
+
+impl LoadLibraryCtxInterface for AsyncPoolLoadLibraryCtx {
+    fn register_function(
+        &mut self,
+        _name: &str,
+        _function_ctx: Box<dyn FunctionCtxInterface>,
+        _flags: FunctionFlags,
+        _description: Option<String>,
+    ) -> Result<(), GearsApiError> {
+        Ok(())
+    }
+
+    fn register_async_function(
+        &mut self,
+        _name: &str,
+        _function_ctx: Box<dyn FunctionCtxInterface>,
+        _flags: FunctionFlags,
+        _description: Option<String>,
+    ) -> Result<(), GearsApiError> {
+        Ok(())
+    }
+
+    fn register_remote_task(
+        &mut self,
+        _name: &str,
+        _remote_function_ctx: RemoteFunctionCtx,
+    ) -> Result<(), GearsApiError> {
+        Ok(())
+    }
+
+    fn register_stream_consumer(
+        &mut self,
+        _name: &str,
+        _prefix: &[u8],
+        _stream_ctx: Box<dyn StreamCtxInterface>,
+        _window: usize,
+        _trim: bool,
+        _description: Option<String>,
+    ) -> Result<(), GearsApiError> {
+        Ok(())
+    }
+
+    fn register_key_space_notification_consumer(
+        &mut self,
+        _name: &str,
+        _key: RegisteredKeys,
+        _keys_notifications_consumer_ctx: Box<dyn KeysNotificationsConsumerCtxInterface>,
+        _description: Option<String>,
+    ) -> Result<(), GearsApiError> {
+        Ok(())
+    }
+}
+
+impl V8ScriptCtx {
+    /// Evaluates the library code, the registrations are performed on the
+    /// given library loader.
+    fn evaluate(
         &self,
         load_library_ctx: &dyn LoadLibraryCtxInterface,
         is_being_loaded_from_rdb: bool,
     ) -> Result<(), GearsApiError> {
-        let isolate_scope = self.script_ctx.isolate.enter();
-        let ctx_scope = self.script_ctx.context.enter(&isolate_scope);
+        let isolate_scope = self.isolate.enter();
+        let ctx_scope = self.context.enter(&isolate_scope);
         let trycatch = isolate_scope.new_try_catch();
 
-        if let Some(inspector) = self.script_ctx.inspector.as_ref() {
+        if let Some(inspector) = self.inspector.as_ref() {
             inspector
                 .guard(&isolate_scope)
                 .and_then(|i| i.schedule_pause_on_next_statement("Pause on load."))
@@ -507,23 +612,18 @@ impl LibraryCtxInterface for V8LibraryCtx {
         }
 
         let script = self
-            .script_ctx
             .script
             .to_local(&isolate_scope)
             .map_err(GearsApiError::new)?;
 
-        let _rdb_loading_guard = self.script_ctx.mark_loading_rdb(is_being_loaded_from_rdb);
+        let _rdb_loading_guard = self.mark_loading_rdb(is_being_loaded_from_rdb);
 
         // set private content
-        let _load_library_guard = self
-            .script_ctx
-            .context
-            .set_private_data(0, &load_library_ctx);
+        let _load_library_guard = self.context.set_private_data(0, &load_library_ctx);
 
-        let res = self.script_ctx.run(&script, &ctx_scope, GilStatus::Locked);
+        let res = self.run(&script, &ctx_scope, GilStatus::Locked);
 
-        let res =
-            res.ok_or_else(|| get_exception_msg(&self.script_ctx.isolate, trycatch, &ctx_scope))?;
+        let res = res.ok_or_else(|| get_exception_msg(&self.isolate, trycatch, &ctx_scope))?;
 
         if res.is_promise() {
             let promise = res.as_promise();
@@ -539,6 +639,33 @@ impl LibraryCtxInterface for V8LibraryCtx {
 
         Ok(())
     }
+}
+
+impl LibraryCtxInterface for V8LibraryCtx {
+    fn load_library(
+        &self,
+        load_library_ctx: &dyn LoadLibraryCtxInterface,
+        is_being_loaded_from_rdb: bool,
+    ) -> Result<(), GearsApiError> {
+        // Evaluate the additional isolates first so the main isolate
+        // will find their async functions when registering its own.
+        let async_pool = self.script_ctx.async_pool();
+        let res = async_pool
+            .iter()
+            .try_for_each(|v| v.evaluate(&AsyncPoolLoadLibraryCtx, is_being_loaded_from_rdb))
+            .and_then(|_| {
+                self.script_ctx
+                    .evaluate(load_library_ctx, is_being_loaded_from_rdb)
+            });
+
+        // drop the functions which were not taken by the main isolate,
+        // they reference their isolate.
+        async_pool
+            .iter()
+            .for_each(|v| v.pooled_async_functions.ref_cell.borrow_mut().clear());
+
+        res
+    }
 
     fn get_info(&self) -> Option<ModuleInfo> {
         let sections = {
@@ -0,0 +1,574 @@
+/*
+ * Copyright Redis Ltd. 2018 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+//! A compact binary encoding of JS values, used to pass the inputs and
+//! outputs of remote functions as an alternative to JSON. Unlike JSON,
+//! it keeps `BigInt` values (in the 64 bit integer range) apart from
+//! numbers, and supports `ArrayBuffer`, typed arrays, `DataView`, `Set`
+//! and `Map` values at any nesting level. Numbers are always encoded as
+//! doubles, so integer numbers are decoded as numbers and not as `BigInt`
+//! values. `WeakMap` and `WeakSet` values can not be serialized.
+//!
+//! The encoded data starts with the format version, followed by the
+//! value. Each value is encoded as a one byte tag followed by its
+//! payload. Lengths are encoded as LEB128 varints, `BigInt` values are zigzag
+//! encoded and then encoded as varints, doubles are encoded as 8 bytes
+//! little endian. Typed arrays and `DataView` values are encoded as the
+//! name of their constructor followed by the bytes they view, maps are
+//! encoded as their number of entries followed by each key and value.
+//!
+//! v8_rs has no API for maps and typed arrays, they are read and created
+//! by the small JS functions of [`JS_HELPERS`].
+
+use v8_rs::v8::v8_array::V8LocalArray;
+use v8_rs::v8::{
+    isolate_scope::V8IsolateScope, v8_context_scope::V8ContextScope, v8_object::V8LocalObject,
+    v8_value::V8LocalValue,
+};
+
+const FORMAT_VERSION: u8 = 1;
+const MAX_NESTING_LEVEL: usize = 100;
+
+const TAG_NULL: u8 = 0;
+const TAG_FALSE: u8 = 1;
+const TAG_TRUE: u8 = 2;
+const TAG_BIG_INT: u8 = 3;
+const TAG_DOUBLE: u8 = 4;
+const TAG_STRING: u8 = 5;
+const TAG_ARRAY_BUFFER: u8 = 6;
+const TAG_ARRAY: u8 = 7;
+const TAG_SET: u8 = 8;
+const TAG_OBJECT: u8 = 9;
+const TAG_MAP: u8 = 10;
+const TAG_ARRAY_BUFFER_VIEW: u8 = 11;
+
+/// The constructors of the `ArrayBuffer` views which are serialized
+/// as [`TAG_ARRAY_BUFFER_VIEW`].
+const ARRAY_BUFFER_VIEWS: &[&str] = &[
+    "Uint8Array",
+    "Int8Array",
+    "Uint16Array",
+    "Int16Array",
+    "Uint32Array",
+    "Int32Array",
+    "Float32Array",
+    "Float64Array",
+    "Uint8ClampedArray",
+    "BigUint64Array",
+    "BigInt64Array",
+    "DataView",
+];
+
+/// Reads the entries of a map as a flat array of keys and values, and
+/// copies the bytes viewed by a typed array or a `DataView` into a new
+/// `ArrayBuffer`, and the other way around. The builtins are taken when
+/// the helpers are compiled, so the library can not change the encoding
+/// by overriding them later.
+const JS_HELPERS: &str = r#"(() => {
+    const mapForEach = Map.prototype.forEach;
+    const mapSet = Map.prototype.set;
+    return {
+        mapEntries: (m) => {
+            const res = [];
+            mapForEach.call(m, (v, k) => { res.push(k, v); });
+            return res;
+        },
+        viewBytes: (v) => v.buffer.slice(v.byteOffset, v.byteOffset + v.byteLength),
+        newMap: (entries) => {
+            const m = new Map();
+            for (let i = 0; i < entries.length; i += 2) {
+                mapSet.call(m, entries[i], entries[i + 1]);
+            }
+            return m;
+        },
+        newView: (name, buffer) => new globalThis[name](buffer),
+    };
+})()"#;
+
+/// The [`JS_HELPERS`] of a single [`serialize`] or [`deserialize`] call,
+/// compiled when they are first needed. V8 caches the compilation of the
+/// same source, so compiling them again on the next call is cheap.
+struct Helpers<'isolate_scope, 'isolate> {
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    funcs: Option<V8LocalObject<'isolate_scope, 'isolate>>,
+}
+
+impl<'isolate_scope, 'isolate> Helpers<'isolate_scope, 'isolate> {
+    fn new(isolate_scope: &'isolate_scope V8IsolateScope<'isolate>) -> Self {
+        Helpers {
+            isolate_scope,
+            funcs: None,
+        }
+    }
+
+    fn call(
+        &mut self,
+        ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+        name: &str,
+        args: &[&V8LocalValue<'isolate_scope, 'isolate>],
+    ) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+        if self.funcs.is_none() {
+            let code = self.isolate_scope.new_string(JS_HELPERS);
+            let funcs = ctx_scope
+                .compile(&code)
+                .and_then(|script| script.run(ctx_scope))
+                .ok_or("Failed compiling the serialization helpers")?;
+            self.funcs = Some(funcs.as_object());
+        }
+        self.funcs
+            .as_ref()
+            .and_then(|funcs| funcs.get_str_field(ctx_scope, name))
+            .and_then(|f| f.call(ctx_scope, Some(args)))
+            .ok_or_else(|| format!("Failed calling the serialization helper '{}'", name))
+    }
+}
+
+fn write_varint(buff: &mut Vec<u8>, mut val: u64) {
+    while val >= 0x80 {
+        buff.push((val as u8) | 0x80);
+        val >>= 7;
+    }
+    buff.push(val as u8);
+}
+
+fn write_integer(buff: &mut Vec<u8>, val: i64) {
+    write_varint(buff, ((val << 1) ^ (val >> 63)) as u64);
+}
+
+fn write_bytes(buff: &mut Vec<u8>, data: &[u8]) {
+    write_varint(buff, data.len() as u64);
+    buff.extend_from_slice(data);
+}
+
+struct Reader<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn new(data: &'a [u8]) -> Reader<'a> {
+        Reader { data, pos: 0 }
+    }
+
+    fn is_done(&self) -> bool {
+        self.pos == self.data.len()
+    }
+
+    fn read_slice(&mut self, len: usize) -> Result<&'a [u8], String> {
+        let end = self
+            .pos
+            .checked_add(len)
+            .filter(|end| *end <= self.data.len())
+            .ok_or("Unexpected end of data")?;
+        let res = &self.data[self.pos..end];
+        self.pos = end;
+        Ok(res)
+    }
+
+    fn read_u8(&mut self) -> Result<u8, String> {
+        Ok(self.read_slice(1)?[0])
+    }
+
+    fn read_varint(&mut self) -> Result<u64, String> {
+        let mut res = 0_u64;
+        for shift in (0..64).step_by(7) {
+            let byte = self.read_u8()?;
+            res |= ((byte & 0x7f) as u64) << shift;
+            if byte & 0x80 == 0 {
+                return Ok(res);
+            }
+        }
+        Err("Malformed varint".into())
+    }
+
+    fn read_integer(&mut self) -> Result<i64, String> {
+        let val = self.read_varint()?;
+        Ok(((val >> 1) as i64) ^ -((val & 1) as i64))
+    }
+
+    fn read_double(&mut self) -> Result<f64, String> {
+        let bytes = self.read_slice(8)?;
+        Ok(f64::from_le_bytes(bytes.try_into().unwrap()))
+    }
+
+    fn read_len(&mut self) -> Result<usize, String> {
+        let len = self.read_varint()?;
+        // Every element takes at least one byte, do not trust lengths
+        // larger than the remaining data.
+        if len > (self.data.len() - self.pos) as u64 {
+            return Err("Unexpected end of data".into());
+        }
+        Ok(len as usize)
+    }
+
+    fn read_bytes(&mut self) -> Result<&'a [u8], String> {
+        let len = self.read_len()?;
+        self.read_slice(len)
+    }
+
+    fn read_str(&mut self) -> Result<&'a str, String> {
+        std::str::from_utf8(self.read_bytes()?).map_err(|_| "Malformed utf8 string".into())
+    }
+}
+
+fn serialize_items<'isolate_scope, 'isolate>(
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    helpers: &mut Helpers<'isolate_scope, 'isolate>,
+    tag: u8,
+    items: &[V8LocalValue<'isolate_scope, 'isolate>],
+    len: usize,
+    nesting_level: usize,
+    buff: &mut Vec<u8>,
+) -> Result<(), String> {
+    buff.push(tag);
+    write_varint(buff, len as u64);
+    items
+        .iter()
+        .try_for_each(|v| serialize_value(ctx_scope, helpers, v, nesting_level + 1, buff))
+}
+
+fn serialize_array<'isolate_scope, 'isolate>(
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    helpers: &mut Helpers<'isolate_scope, 'isolate>,
+    tag: u8,
+    arr: V8LocalArray<'isolate_scope, 'isolate>,
+    nesting_level: usize,
+    buff: &mut Vec<u8>,
+) -> Result<(), String> {
+    let items = arr.iter(ctx_scope).collect::<Vec<_>>();
+    serialize_items(
+        ctx_scope,
+        helpers,
+        tag,
+        &items,
+        items.len(),
+        nesting_level,
+        buff,
+    )
+}
+
+/// Returns the name of the constructor which created the object, maps and
+/// typed arrays have no API of their own and are recognized by it. Values
+/// created by a class which extends them are serialized as plain objects.
+fn constructor_name(ctx_scope: &V8ContextScope, val: &V8LocalValue) -> Option<String> {
+    val.as_object()
+        .get_str_field(ctx_scope, "constructor")
+        .filter(|v| v.is_function())
+        .and_then(|v| v.as_object().get_str_field(ctx_scope, "name"))
+        .and_then(|v| v.to_utf8())
+        .map(|v| v.as_str().to_string())
+}
+
+fn serialize_value<'isolate_scope, 'isolate>(
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    helpers: &mut Helpers<'isolate_scope, 'isolate>,
+    val: &V8LocalValue<'isolate_scope, 'isolate>,
+    nesting_level: usize,
+    buff: &mut Vec<u8>,
+) -> Result<(), String> {
+    if nesting_level > MAX_NESTING_LEVEL {
+        return Err("nesting level reached".into());
+    }
+    if val.is_string() || val.is_string_object() {
+        let s = val.to_utf8().ok_or("Failed converting string to utf8")?;
+        buff.push(TAG_STRING);
+        write_bytes(buff, s.as_str().as_bytes());
+    } else if val.is_long() {
+        // `is_long` is only true for `BigInt` values, `get_long` wraps
+        // values outside of the 64 bit integer range.
+        let v = val.get_long();
+        let s = val.to_utf8().ok_or("Failed converting BigInt to utf8")?;
+        if s.as_str() != v.to_string() {
+            return Err(
+                "BigInt values outside of the 64 bit integer range can not be serialized".into(),
+            );
+        }
+        buff.push(TAG_BIG_INT);
+        write_integer(buff, v);
+    } else if val.is_number() {
+        buff.push(TAG_DOUBLE);
+        buff.extend_from_slice(&val.get_number().to_le_bytes());
+    } else if val.is_boolean() {
+        buff.push(if val.get_boolean() {
+            TAG_TRUE
+        } else {
+            TAG_FALSE
+        });
+    } else if val.is_null() {
+        buff.push(TAG_NULL);
+    } else if val.is_array_buffer() {
+        buff.push(TAG_ARRAY_BUFFER);
+        write_bytes(buff, val.as_array_buffer().data());
+    } else if val.is_array() {
+        serialize_array(
+            ctx_scope,
+            helpers,
+            TAG_ARRAY,
+            val.as_array(),
+            nesting_level,
+            buff,
+        )?;
+    } else if val.is_set() {
+        serialize_array(
+            ctx_scope,
+            helpers,
+            TAG_SET,
+            val.as_set().into(),
+            nesting_level,
+            buff,
+        )?;
+    } else if val.is_function() {
+        return Err("Functions can not be serialized".into());
+    } else if val.is_object() {
+        // checked before reading the object keys, a typed array has a key
+        // for each of its elements.
+        match constructor_name(ctx_scope, val).as_deref() {
+            Some("Map") => {
+                let entries = helpers.call(ctx_scope, "mapEntries", &[val])?;
+                let entries = entries.as_array().iter(ctx_scope).collect::<Vec<_>>();
+                return serialize_items(
+                    ctx_scope,
+                    helpers,
+                    TAG_MAP,
+                    &entries,
+                    entries.len() / 2,
+                    nesting_level,
+                    buff,
+                );
+            }
+            Some(name) if ARRAY_BUFFER_VIEWS.contains(&name) => {
+                let bytes = helpers.call(ctx_scope, "viewBytes", &[val])?;
+                if !bytes.is_array_buffer() {
+                    return Err(format!("Failed reading the bytes of {}", name));
+                }
+                buff.push(TAG_ARRAY_BUFFER_VIEW);
+                write_bytes(buff, name.as_bytes());
+                write_bytes(buff, bytes.as_array_buffer().data());
+                return Ok(());
+            }
+            Some(name @ ("WeakMap" | "WeakSet")) => {
+                return Err(format!("{} values can not be serialized", name));
+            }
+            _ => (),
+        }
+        let obj = val.as_object();
+        let keys = obj
+            .get_property_names(ctx_scope)
+            .iter(ctx_scope)
+            .collect::<Vec<_>>();
+        buff.push(TAG_OBJECT);
+        write_varint(buff, keys.len() as u64);
+        for key in keys {
+            let key_utf8 = key
+                .to_utf8()
+                .ok_or("Failed converting object key to utf8")?;
+            write_bytes(buff, key_utf8.as_str().as_bytes());
+            let v = obj
+                .get(ctx_scope, &key)
+                .ok_or("Failed getting object property")?;
+            serialize_value(ctx_scope, helpers, &v, nesting_level + 1, buff)?;
+        }
+    } else {
+        // undefined, and any other value which has no representation.
+        buff.push(TAG_NULL);
+    }
+    Ok(())
+}
+
+fn deserialize_items<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    helpers: &mut Helpers<'isolate_scope, 'isolate>,
+    reader: &mut Reader,
+    len: usize,
+    nesting_level: usize,
+) -> Result<Vec<V8LocalValue<'isolate_scope, 'isolate>>, String> {
+    (0..len)
+        .map(|_| deserialize_value(isolate_scope, ctx_scope, helpers, reader, nesting_level + 1))
+        .collect()
+}
+
+fn deserialize_value<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    helpers: &mut Helpers<'isolate_scope, 'isolate>,
+    reader: &mut Reader,
+    nesting_level: usize,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    if nesting_level > MAX_NESTING_LEVEL {
+        return Err("nesting level reached".into());
+    }
+    Ok(match reader.read_u8()? {
+        TAG_NULL => isolate_scope.new_null(),
+        TAG_FALSE => isolate_scope.new_bool(false),
+        TAG_TRUE => isolate_scope.new_bool(true),
+        TAG_BIG_INT => isolate_scope.new_long(reader.read_integer()?),
+        TAG_DOUBLE => isolate_scope.new_double(reader.read_double()?),
+        TAG_STRING => isolate_scope.new_string(reader.read_str()?).to_value(),
+        TAG_ARRAY_BUFFER => isolate_scope
+            .new_array_buffer(reader.read_bytes()?)
+            .to_value(),
+        TAG_ARRAY => {
+            let len = reader.read_len()?;
+            let items = deserialize_items(
+                isolate_scope,
+                ctx_scope,
+                helpers,
+                reader,
+                len,
+                nesting_level,
+            )?;
+            isolate_scope
+                .new_array(&items.iter().collect::<Vec<&V8LocalValue>>())
+                .to_value()
+        }
+        TAG_SET => {
+            let len = reader.read_len()?;
+            let set = isolate_scope.new_set();
+            for _ in 0..len {
+                let v = deserialize_value(
+                    isolate_scope,
+                    ctx_scope,
+                    helpers,
+                    reader,
+                    nesting_level + 1,
+                )?;
+                set.add(ctx_scope, &v);
+            }
+            set.to_value()
+        }
+        TAG_OBJECT => {
+            let len = reader.read_len()?;
+            let obj = isolate_scope.new_object();
+            for _ in 0..len {
+                let key = isolate_scope.new_string(reader.read_str()?).to_value();
+                let v = deserialize_value(
+                    isolate_scope,
+                    ctx_scope,
+                    helpers,
+                    reader,
+                    nesting_level + 1,
+                )?;
+                obj.set(ctx_scope, &key, &v);
+            }
+            obj.to_value()
+        }
+        TAG_MAP => {
+            let len = reader.read_len()?;
+            let entries = deserialize_items(
+                isolate_scope,
+                ctx_scope,
+                helpers,
+                reader,
+                len * 2,
+                nesting_level,
+            )?;
+            let entries = isolate_scope
+                .new_array(&entries.iter().collect::<Vec<&V8LocalValue>>())
+                .to_value();
+            helpers.call(ctx_scope, "newMap", &[&entries])?
+        }
+        TAG_ARRAY_BUFFER_VIEW => {
+            let name = reader.read_str()?;
+            if !ARRAY_BUFFER_VIEWS.contains(&name) {
+                return Err(format!("Unknown ArrayBuffer view {}", name));
+            }
+            let name = isolate_scope.new_string(name).to_value();
+            let buffer = isolate_scope
+                .new_array_buffer(reader.read_bytes()?)
+                .to_value();
+            helpers.call(ctx_scope, "newView", &[&name, &buffer])?
+        }
+        tag => return Err(format!("Unknown value tag {}", tag)),
+    })
+}
+
+/// Encodes the given value, fails if the value (or any of its nested
+/// values) is a function, a `WeakMap`, a `WeakSet` or a `BigInt` outside
+/// of the 64 bit integer range, or if the nesting level is too deep.
+pub(crate) fn serialize<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    val: &V8LocalValue<'isolate_scope, 'isolate>,
+) -> Result<Vec<u8>, String> {
+    let mut buff = vec![FORMAT_VERSION];
+    let mut helpers = Helpers::new(isolate_scope);
+    serialize_value(ctx_scope, &mut helpers, val, 0, &mut buff)?;
+    Ok(buff)
+}
+
+/// Decodes a value encoded with [`serialize`].
+pub(crate) fn deserialize<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+    data: &[u8],
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    let mut reader = Reader::new(data);
+    let version = reader.read_u8()?;
+    if version != FORMAT_VERSION {
+        return Err(format!(
+            "Unsupported serialization format version {}",
+            version
+        ));
+    }
+    let mut helpers = Helpers::new(isolate_scope);
+    let res = deserialize_value(isolate_scope, ctx_scope, &mut helpers, &mut reader, 0)?;
+    if !reader.is_done() {
+        return Err("Unexpected data after the serialized value".into());
+    }
+    Ok(res)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_integers_round_trip() {
+        let values = [0, 1, -1, 63, -64, 64, 300, -300, i64::MAX, i64::MIN];
+        let mut buff = Vec::new();
+        values.iter().for_each(|v| write_integer(&mut buff, *v));
+        let mut reader = Reader::new(&buff);
+        values
+            .iter()
+            .for_each(|v| assert_eq!(reader.read_integer().unwrap(), *v));
+        assert!(reader.is_done());
+        // small integers takes a single byte
+        let mut buff = Vec::new();
+        write_integer(&mut buff, -64);
+        assert_eq!(buff.len(), 1);
+    }
+
+    #[test]
+    fn test_bytes_round_trip() {
+        let mut buff = Vec::new();
+        write_bytes(&mut buff, b"foo");
+        write_bytes(&mut buff, &[0; 200]);
+        let mut reader = Reader::new(&buff);
+        assert_eq!(reader.read_str().unwrap(), "foo");
+        assert_eq!(reader.read_bytes().unwrap(), &[0; 200]);
+        assert!(reader.is_done());
+    }
+
+    #[test]
+    fn test_malformed_data() {
+        // truncated varint
+        assert!(Reader::new(&[0x80]).read_varint().is_err());
+        // too long varint
+        assert!(Reader::new(&[0xff; 11]).read_varint().is_err());
+        // length larger than the data
+        let mut buff = Vec::new();
+        write_varint(&mut buff, 100);
+        buff.push(b'a');
+        assert!(Reader::new(&buff).read_bytes().is_err());
+        // invalid utf8
+        let mut buff = Vec::new();
+        write_bytes(&mut buff, &[0xff, 0xfe]);
+        assert!(Reader::new(&buff).read_str().is_err());
+        // truncated double
+        assert!(Reader::new(&[0; 7]).read_double().is_err());
+    }
+}
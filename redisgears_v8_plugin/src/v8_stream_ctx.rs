@@ -4,65 +4,153 @@
  * the Server Side Public License v1 (SSPLv1).
  */
 
+use redisgears_plugin_api::redisgears_plugin_api::backend_ctx::JobPriority;
 use redisgears_plugin_api::redisgears_plugin_api::GearsApiError;
-use v8_rs::v8::{v8_value::V8LocalValue, v8_value::V8PersistValue};
+use v8_rs::v8::{
+    isolate_scope::V8IsolateScope, v8_context_scope::V8ContextScope, v8_object::V8LocalObject,
+    v8_object_template::V8PersistedObjectTemplate, v8_value::V8LocalValue,
+    v8_value::V8PersistValue,
+};
 
 use redisgears_plugin_api::redisgears_plugin_api::stream_ctx::{
-    StreamCtxInterface, StreamProcessCtxInterface, StreamRecordAck, StreamRecordInterface,
+    StreamAdaptiveWindowConfig, StreamBatchConfig, StreamCtxInterface, StreamProcessCtxInterface,
+    StreamRecordAck, StreamRecordInterface,
 };
 
 use redisgears_plugin_api::redisgears_plugin_api::run_function_ctx::BackgroundRunFunctionCtxInterface;
 
 use crate::v8_backend::bypass_memory_limit;
-use crate::v8_native_functions::{get_backgrounnd_client, get_redis_client, RedisClient};
+use crate::v8_native_functions::{get_backgrounnd_client, PersistedRedisClient, V8RedisCallArgs};
 use crate::v8_script_ctx::{GilStatus, V8ScriptCtx};
 
-use std::cell::RefCell;
 use std::sync::Arc;
 
 use std::str;
 
 use crate::get_exception_msg;
 
+type StreamRecord = Box<dyn StreamRecordInterface + Send>;
+type StreamRecords = Vec<StreamRecord>;
+
 struct V8StreamCtxInternals {
     persisted_function: V8PersistValue,
+    persisted_client: PersistedRedisClient,
+    record_object_template: V8PersistedObjectTemplate,
     script_ctx: Arc<V8ScriptCtx>,
+    is_batched: bool,
+    lazy_records: bool,
 }
 
 pub struct V8StreamCtx {
     internals: Arc<V8StreamCtxInternals>,
     is_async: bool,
+    batch: Option<StreamBatchConfig>,
+    adaptive_window: Option<StreamAdaptiveWindowConfig>,
 }
 
 impl V8StreamCtx {
     pub(crate) fn new(
+        isolate_scope: &V8IsolateScope,
         mut persisted_function: V8PersistValue,
+        persisted_client: PersistedRedisClient,
         script_ctx: &Arc<V8ScriptCtx>,
         is_async: bool,
+        batch: Option<StreamBatchConfig>,
+        adaptive_window: Option<StreamAdaptiveWindowConfig>,
+        lazy_records: bool,
     ) -> Self {
         persisted_function.forget();
+        let record_object_template = get_record_object_template(isolate_scope);
         Self {
             internals: Arc::new(V8StreamCtxInternals {
                 persisted_function,
+                persisted_client,
+                record_object_template,
                 script_ctx: Arc::clone(script_ctx),
+                is_batched: batch.is_some(),
+                lazy_records,
             }),
             is_async,
+            batch,
+            adaptive_window,
         }
     }
 }
 
+// Silenced for the same reason as in `get_tensor_from_js_tensor`,
+// the external data holds a boxed trait object.
+#[allow(clippy::borrowed_box)]
+fn get_record_from_js_record<'isolate_scope>(
+    js_record: &'isolate_scope V8LocalObject<'isolate_scope, '_>,
+) -> Result<&'isolate_scope StreamRecord, String> {
+    if js_record.get_internal_field_count() != 1 {
+        return Err("Data is not a stream record".into());
+    }
+    let external_data = js_record.get_internal_field(0);
+    if !external_data.is_external() {
+        return Err("Data is not a stream record".into());
+    }
+    let external_data = external_data.as_external_data();
+    Ok(external_data.get_data::<StreamRecord>())
+}
+
+/// Return the value of the requested field of the stream record held by
+/// `js_record`, decoded to utf8 (or null if failed to decode) or as ArrayBuffer.
+/// Return null if the field does not exist.
+fn get_record_field<'isolate_scope, 'isolate>(
+    isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+    js_record: &V8LocalObject,
+    field: Option<V8LocalValue>,
+    decode: bool,
+) -> Result<V8LocalValue<'isolate_scope, 'isolate>, String> {
+    let field: V8RedisCallArgs = field
+        .ok_or("Wrong number of arguments.")?
+        .try_into()
+        .map_err(|e: &str| format!("Bad field name, {e}."))?;
+    let record = get_record_from_js_record(js_record)?;
+    Ok(match record.get_field(field.as_bytes()) {
+        Some(v) if decode => str::from_utf8(v).map_or(isolate_scope.new_null(), |v| {
+            isolate_scope.new_string(v).to_value()
+        }),
+        Some(v) => isolate_scope.new_array_buffer(v).to_value(),
+        None => isolate_scope.new_null(),
+    })
+}
+
+/// The template of the JS objects representing stream records, the record
+/// is kept on the object so fields can be looked up only when requested.
+fn get_record_object_template(isolate_scope: &V8IsolateScope) -> V8PersistedObjectTemplate {
+    let mut obj_template = isolate_scope.new_object_template();
+
+    obj_template.add_native_function("get", move |args, isolate_scope, _ctx_scope| {
+        let curr_self = args.get_self();
+        let field = (args.len() == 1).then(|| args.get(0));
+        get_record_field(isolate_scope, &curr_self, field, true)
+            .map_err(|e| isolate_scope.raise_exception_str(&e))
+            .ok()
+    });
+
+    obj_template.add_native_function("getRaw", move |args, isolate_scope, _ctx_scope| {
+        let curr_self = args.get_self();
+        let field = (args.len() == 1).then(|| args.get(0));
+        get_record_field(isolate_scope, &curr_self, field, false)
+            .map_err(|e| isolate_scope.raise_exception_str(&e))
+            .ok()
+    });
+
+    obj_template.set_internal_field_count(1);
+    obj_template.persist()
+}
+
 impl V8StreamCtxInternals {
-    fn process_record_internal_sync(
+    /// Create the JS object representing a single stream record.
+    fn get_record_object<'isolate_scope, 'isolate>(
         &self,
+        isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+        ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
         stream_name: &[u8],
-        record: Box<dyn StreamRecordInterface>,
-        run_ctx: &dyn StreamProcessCtxInterface,
-        ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
-    ) -> Option<StreamRecordAck> {
-        let isolate_scope = self.script_ctx.isolate.enter();
-        let ctx_scope = self.script_ctx.context.enter(&isolate_scope);
-        let trycatch = isolate_scope.new_try_catch();
-
+        record: StreamRecord,
+    ) -> V8LocalValue<'isolate_scope, 'isolate> {
         let id = record.get_id();
         let id_v8_arr = isolate_scope.new_array(&[
             &isolate_scope.new_long(id.0 as i64),
@@ -73,80 +161,117 @@ impl V8StreamCtxInternals {
             Err(_) => isolate_scope.new_null(),
         };
 
-        let vals = record
-            .fields()
-            .map(|(f, v)| {
-                let f = match str::from_utf8(f) {
-                    Ok(s) => isolate_scope.new_string(s).to_value(),
-                    Err(_) => isolate_scope.new_null(),
-                };
-                let v = match str::from_utf8(v) {
-                    Ok(s) => isolate_scope.new_string(s).to_value(),
-                    Err(_) => isolate_scope.new_null(),
-                };
-                isolate_scope.new_array(&[&f, &v]).to_value()
-            })
-            .collect::<Vec<V8LocalValue>>();
-
-        let raw_vals = record
-            .fields()
-            .map(|(f, v)| {
-                isolate_scope
-                    .new_array(&[
-                        &isolate_scope.new_array_buffer(f).to_value(),
-                        &isolate_scope.new_array_buffer(v).to_value(),
-                    ])
-                    .to_value()
-            })
-            .collect::<Vec<V8LocalValue>>();
-
-        let val_v8_arr = isolate_scope.new_array(&vals.iter().collect::<Vec<&V8LocalValue>>());
-
-        let raw_val_v8_arr =
-            isolate_scope.new_array(&raw_vals.iter().collect::<Vec<&V8LocalValue>>());
-
-        let stream_data = isolate_scope.new_object();
+        let stream_data = self
+            .record_object_template
+            .to_local(isolate_scope)
+            .new_instance(ctx_scope);
         stream_data.set(
-            &ctx_scope,
+            ctx_scope,
             &isolate_scope.new_string("id").to_value(),
             &id_v8_arr.to_value(),
         );
         stream_data.set(
-            &ctx_scope,
+            ctx_scope,
             &isolate_scope.new_string("stream_name").to_value(),
             &stream_name_v8_str,
         );
         stream_data.set(
-            &ctx_scope,
+            ctx_scope,
             &isolate_scope.new_string("stream_name_raw").to_value(),
             &isolate_scope.new_array_buffer(stream_name).to_value(),
         );
-        stream_data.set(
-            &ctx_scope,
-            &isolate_scope.new_string("record").to_value(),
-            &val_v8_arr.to_value(),
-        );
-        stream_data.set(
-            &ctx_scope,
-            &isolate_scope.new_string("record_raw").to_value(),
-            &raw_val_v8_arr.to_value(),
-        );
 
-        let c = run_ctx.get_redis_client();
-        let redis_client = Arc::new(RefCell::new(RedisClient::with_client(c.as_ref())));
-        let r_client =
-            get_redis_client(&self.script_ctx, &isolate_scope, &ctx_scope, &redis_client);
+        if !self.lazy_records {
+            let (vals, raw_vals): (Vec<V8LocalValue>, Vec<V8LocalValue>) = record
+                .fields()
+                .map(|(f, v)| {
+                    let f_str = match str::from_utf8(f) {
+                        Ok(s) => isolate_scope.new_string(s).to_value(),
+                        Err(_) => isolate_scope.new_null(),
+                    };
+                    let v_str = match str::from_utf8(v) {
+                        Ok(s) => isolate_scope.new_string(s).to_value(),
+                        Err(_) => isolate_scope.new_null(),
+                    };
+                    let f_raw = isolate_scope.new_array_buffer(f).to_value();
+                    let v_raw = isolate_scope.new_array_buffer(v).to_value();
+                    (
+                        isolate_scope.new_array(&[&f_str, &v_str]).to_value(),
+                        isolate_scope.new_array(&[&f_raw, &v_raw]).to_value(),
+                    )
+                })
+                .unzip();
 
-        let _block_guard = ctx_scope.set_private_data(0, &true); // indicate we are blocked
+            let val_v8_arr = isolate_scope.new_array(&vals.iter().collect::<Vec<&V8LocalValue>>());
+            let raw_val_v8_arr =
+                isolate_scope.new_array(&raw_vals.iter().collect::<Vec<&V8LocalValue>>());
 
-        let res = self.script_ctx.call(
-            &self.persisted_function.as_local(&isolate_scope),
-            &ctx_scope,
-            Some(&[&r_client.to_value(), &stream_data.to_value()]),
-            GilStatus::Locked,
-        );
+            stream_data.set(
+                ctx_scope,
+                &isolate_scope.new_string("record").to_value(),
+                &val_v8_arr.to_value(),
+            );
+            stream_data.set(
+                ctx_scope,
+                &isolate_scope.new_string("record_raw").to_value(),
+                &raw_val_v8_arr.to_value(),
+            );
+        }
+
+        let record_external = isolate_scope.new_external_data(record);
+        stream_data.set_internal_field(0, &record_external.to_value());
+        stream_data.to_value()
+    }
+
+    /// Create the data argument passed to the JS callback, a single record object
+    /// or, for batched consumers, an array of record objects.
+    fn get_stream_data<'isolate_scope, 'isolate>(
+        &self,
+        isolate_scope: &'isolate_scope V8IsolateScope<'isolate>,
+        ctx_scope: &V8ContextScope<'isolate_scope, 'isolate>,
+        stream_name: &[u8],
+        mut records: StreamRecords,
+    ) -> V8LocalValue<'isolate_scope, 'isolate> {
+        if !self.is_batched {
+            let record = records.pop().unwrap();
+            return self.get_record_object(isolate_scope, ctx_scope, stream_name, record);
+        }
+        let records = records
+            .into_iter()
+            .map(|r| self.get_record_object(isolate_scope, ctx_scope, stream_name, r))
+            .collect::<Vec<V8LocalValue>>();
+        isolate_scope
+            .new_array(&records.iter().collect::<Vec<&V8LocalValue>>())
+            .to_value()
+    }
+
+    fn process_record_internal_sync(
+        &self,
+        stream_name: &[u8],
+        records: StreamRecords,
+        run_ctx: &dyn StreamProcessCtxInterface,
+        ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
+    ) -> Option<StreamRecordAck> {
+        let isolate_scope = self.script_ctx.isolate.enter();
+        let ctx_scope = self.script_ctx.context.enter(&isolate_scope);
+        let trycatch = isolate_scope.new_try_catch();
+
+        let stream_data = self.get_stream_data(&isolate_scope, &ctx_scope, stream_name, records);
+
+        let c = run_ctx.get_redis_client();
+        let res = {
+            let (r_client, _client_guard) =
+                self.persisted_client.set_client(&isolate_scope, c.as_ref());
 
-        redis_client.borrow_mut().make_invalid();
+            let _block_guard = ctx_scope.set_private_data(0, &true); // indicate we are blocked
+
+            self.script_ctx.call(
+                &self.persisted_function.as_local(&isolate_scope),
+                &ctx_scope,
+                Some(&[&r_client, &stream_data]),
+                GilStatus::Locked,
+            )
+        };
 
         Some(match res {
             Some(res) => {
@@ -192,7 +317,7 @@ impl V8StreamCtxInternals {
     fn process_record_internal_async(
         &self,
         stream_name: &[u8],
-        record: Box<dyn StreamRecordInterface>,
+        records: StreamRecords,
         redis_client: Box<dyn BackgroundRunFunctionCtxInterface>,
         ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
     ) {
@@ -201,74 +326,8 @@ impl V8StreamCtxInternals {
             let ctx_scope = self.script_ctx.context.enter(&isolate_scope);
             let trycatch = isolate_scope.new_try_catch();
 
-            let id = record.get_id();
-            let id_v8_arr = isolate_scope.new_array(&[
-                &isolate_scope.new_long(id.0 as i64),
-                &isolate_scope.new_long(id.1 as i64),
-            ]);
-            let stream_name_v8_str = match std::str::from_utf8(stream_name) {
-                Ok(s) => isolate_scope.new_string(s).to_value(),
-                Err(_) => isolate_scope.new_null(),
-            };
-
-            let vals = record
-                .fields()
-                .map(|(f, v)| {
-                    let f = match str::from_utf8(f) {
-                        Ok(s) => isolate_scope.new_string(s).to_value(),
-                        Err(_) => isolate_scope.new_null(),
-                    };
-                    let v = match str::from_utf8(v) {
-                        Ok(s) => isolate_scope.new_string(s).to_value(),
-                        Err(_) => isolate_scope.new_null(),
-                    };
-                    isolate_scope.new_array(&[&f, &v]).to_value()
-                })
-                .collect::<Vec<V8LocalValue>>();
-
-            let raw_vals = record
-                .fields()
-                .map(|(f, v)| {
-                    isolate_scope
-                        .new_array(&[
-                            &isolate_scope.new_array_buffer(f).to_value(),
-                            &isolate_scope.new_array_buffer(v).to_value(),
-                        ])
-                        .to_value()
-                })
-                .collect::<Vec<V8LocalValue>>();
-
-            let val_v8_arr = isolate_scope.new_array(&vals.iter().collect::<Vec<&V8LocalValue>>());
-
-            let raw_val_v8_arr =
-                isolate_scope.new_array(&raw_vals.iter().collect::<Vec<&V8LocalValue>>());
-
-            let stream_data = isolate_scope.new_object();
-            stream_data.set(
-                &ctx_scope,
-                &isolate_scope.new_string("id").to_value(),
-                &id_v8_arr.to_value(),
-            );
-            stream_data.set(
-                &ctx_scope,
-                &isolate_scope.new_string("stream_name").to_value(),
-                &stream_name_v8_str,
-            );
-            stream_data.set(
-                &ctx_scope,
-                &isolate_scope.new_string("stream_name_raw").to_value(),
-                &isolate_scope.new_array_buffer(stream_name).to_value(),
-            );
-            stream_data.set(
-                &ctx_scope,
-                &isolate_scope.new_string("record").to_value(),
-                &val_v8_arr.to_value(),
-            );
-            stream_data.set(
-                &ctx_scope,
-                &isolate_scope.new_string("record_raw").to_value(),
-                &raw_val_v8_arr.to_value(),
-            );
+            let stream_data =
+                self.get_stream_data(&isolate_scope, &ctx_scope, stream_name, records);
 
             let r_client = get_backgrounnd_client(
                 &self.script_ctx,
@@ -280,7 +339,7 @@ impl V8StreamCtxInternals {
             let res = self.script_ctx.call(
                 &self.persisted_function.as_local(&isolate_scope),
                 &ctx_scope,
-                Some(&[&r_client.to_value(), &stream_data.to_value()]),
+                Some(&[&r_client.to_value(), &stream_data]),
                 GilStatus::Unlocked,
             );
 
@@ -320,11 +379,11 @@ impl V8StreamCtxInternals {
     }
 }
 
-impl StreamCtxInterface for V8StreamCtx {
-    fn process_record(
+impl V8StreamCtx {
+    fn process_records_internal(
         &self,
         stream_name: &[u8],
-        record: Box<dyn StreamRecordInterface + Send>,
+        records: StreamRecords,
         run_ctx: &dyn StreamProcessCtxInterface,
         ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
     ) -> Option<StreamRecordAck> {
@@ -340,18 +399,51 @@ impl StreamCtxInterface for V8StreamCtx {
             self.internals
                 .script_ctx
                 .compiled_library_api
-                .run_on_background(Box::new(move || {
-                    internals.process_record_internal_async(
-                        &stream_name.clone(),
-                        record,
-                        bg_redis_client,
-                        ack_callback,
-                    );
-                }));
+                .run_on_background_with_priority(
+                    Box::new(move || {
+                        internals.process_record_internal_async(
+                            &stream_name,
+                            records,
+                            bg_redis_client,
+                            ack_callback,
+                        );
+                    }),
+                    JobPriority::Low,
+                );
             None
         } else {
             self.internals
-                .process_record_internal_sync(stream_name, record, run_ctx, ack_callback)
+                .process_record_internal_sync(stream_name, records, run_ctx, ack_callback)
         }
     }
 }
+
+impl StreamCtxInterface for V8StreamCtx {
+    fn process_record(
+        &self,
+        stream_name: &[u8],
+        record: Box<dyn StreamRecordInterface + Send>,
+        run_ctx: &dyn StreamProcessCtxInterface,
+        ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
+    ) -> Option<StreamRecordAck> {
+        self.process_records_internal(stream_name, vec![record], run_ctx, ack_callback)
+    }
+
+    fn process_records(
+        &self,
+        stream_name: &[u8],
+        records: StreamRecords,
+        run_ctx: &dyn StreamProcessCtxInterface,
+        ack_callback: Box<dyn FnOnce(StreamRecordAck) + Send>,
+    ) -> Option<StreamRecordAck> {
+        self.process_records_internal(stream_name, records, run_ctx, ack_callback)
+    }
+
+    fn batch_config(&self) -> Option<StreamBatchConfig> {
+        self.batch
+    }
+
+    fn adaptive_window_config(&self) -> Option<StreamAdaptiveWindowConfig> {
+        self.adaptive_window
+    }
+}